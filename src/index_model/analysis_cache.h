@@ -0,0 +1,235 @@
+#ifndef ANALYSIS_CACHE_H
+#define ANALYSIS_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "index_model/evaluation.h"
+#include "index_model/move.h"
+#include "index_model/transposition.h"
+#include "util/logger.h"
+
+const uint64_t ANALYSIS_CACHE_MAGIC = 0x3143414353534843ULL; // "CHSSCAC1"
+const int ANALYSIS_CACHE_BUCKET_SLOTS = 4;    // 64 bytes, one cache line per probe
+const int ANALYSIS_CACHE_MIN_DEPTH = 3;       // Shallower results are cheaper to search again than to keep
+const int ANALYSIS_CACHE_AGE_WEIGHT = 4;      // Plies of depth a result loses per session it was not touched
+const int DEFAULT_ANALYSIS_CACHE_MB = 64;
+
+// Search results that outlive the program. The table lives in a file mapped into memory, so storing a
+// result is a write to memory and the operating system writes the pages back in the background. It is
+// organized like the transposition table, with the key stored xor'ed with the data so the searchers of
+// a thread pool can share it without locks, but in buckets of four: a position keeps its deepest result,
+// other positions replace the slot with the least depth, lowered by the number of sessions since it was
+// last written. The file is created with the requested size and recreated when it has another one. Scores
+// depend on the evaluation weights, the table is cleared when it was filled with other weights than the
+// current ones
+class AnalysisCache {
+
+	struct Header {
+		uint64_t magic;
+		uint64_t nBuckets;
+		uint32_t generation; // Sessions that opened the file, the age of entries is counted in these
+		uint32_t evalHash;   // EvalParameters::getHash of the weights the results were searched with
+		uint32_t reserved[10];
+	};
+
+	struct Slot {
+		std::atomic<uint64_t> key;
+		std::atomic<uint64_t> data;
+	};
+
+	static_assert(sizeof(Header) == 64 && sizeof(Slot) == 16, "The file layout depends on these sizes");
+
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+	void* memory = nullptr;
+	size_t mappedSize = 0;
+	Slot* slots = nullptr;
+	uint64_t nBuckets = 0;
+	uint8_t generation = 0;
+	std::string path;
+
+	static uint64_t packData(Move move, int score, int depth, int bound, uint8_t generation) {
+		uint64_t packedMove = (uint64_t)((move.getFlags() << 12) | (move.getFrom() << 6) | move.getTo());
+		return packedMove | ((uint64_t)(uint16_t)(int16_t)score << 16) | ((uint64_t)(depth & 0xff) << 32) |
+			((uint64_t)bound << 40) | ((uint64_t)generation << 48);
+	}
+
+	static const int INFINITE_WORTH = 1 << 20;
+
+	static int getDepth(uint64_t data) { return (data >> 32) & 0xff; }
+
+	int getAge(uint64_t data) { return (uint8_t)(generation - (uint8_t)(data >> 48)); }
+
+	bool mapFile(size_t size, bool& created) {
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER existing;
+		created = !GetFileSizeEx(file, &existing) || (uint64_t)existing.QuadPart != size;
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, nullptr);
+		if (!mapping) return false;
+		memory = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+#else
+		fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+		if (fd == -1) return false;
+		struct stat status;
+		created = fstat(fd, &status) == -1 || (uint64_t)status.st_size != size;
+		if (created && (ftruncate(fd, 0) == -1 || ftruncate(fd, (off_t)size) == -1)) return false;
+		memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (memory == MAP_FAILED) memory = nullptr;
+#endif
+		mappedSize = memory ? size : 0;
+		return memory != nullptr;
+	}
+
+public:
+
+	~AnalysisCache() { close(); }
+
+	// Maps the file, creating it if it does not exist or has another size. False if that failed, the cache
+	// then stays closed and every probe misses
+	bool open(const std::string& filePath, int sizeMB = DEFAULT_ANALYSIS_CACHE_MB, uint32_t evalHash = getEvalParameters().getHash()) {
+		close();
+		path = filePath;
+		uint64_t buckets = 1;
+		while (buckets * 2 * ANALYSIS_CACHE_BUCKET_SLOTS * sizeof(Slot) <= (uint64_t)sizeMB * 1024 * 1024)
+			buckets *= 2;
+		size_t size = sizeof(Header) + buckets * ANALYSIS_CACHE_BUCKET_SLOTS * sizeof(Slot);
+		bool created = false;
+		if (!mapFile(size, created)) {
+			LOG_ERROR("Failed to map the analysis cache %s", path.c_str());
+			close();
+			return false;
+		}
+
+		Header* header = (Header*)memory;
+		if (created || header->magic != ANALYSIS_CACHE_MAGIC || header->nBuckets != buckets) {
+			if (!created) std::memset(memory, 0, size); // A new file is sparse and reads as zeros already
+			header->magic = ANALYSIS_CACHE_MAGIC;
+			header->nBuckets = buckets;
+			header->generation = 0;
+			header->evalHash = evalHash;
+		}
+		header->generation++;
+		generation = (uint8_t)header->generation;
+		nBuckets = buckets;
+		slots = (Slot*)((char*)memory + sizeof(Header));
+		setEvalHash(evalHash);
+		LOG_INFO("Analysis cache %s: %llu MB, session %u", path.c_str(), (unsigned long long)(size >> 20), header->generation);
+		return true;
+	}
+
+	// Writes the pages back and unmaps the file
+	void close() {
+		if (memory) {
+			flush(true);
+#ifdef _WIN32
+			UnmapViewOfFile(memory);
+#else
+			munmap(memory, mappedSize);
+#endif
+		}
+#ifdef _WIN32
+		if (mapping) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		mapping = nullptr;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (fd != -1) ::close(fd);
+		fd = -1;
+#endif
+		memory = nullptr;
+		mappedSize = 0;
+		slots = nullptr;
+		nBuckets = 0;
+	}
+
+	bool isOpen() { return slots != nullptr; }
+
+	// To be called when the evaluation weights change, the results of other weights are thrown away. Searches
+	// using the cache must not be running
+	void setEvalHash(uint32_t evalHash) {
+		Header* header = (Header*)memory;
+		if (!header || header->evalHash == evalHash) return;
+		LOG_INFO("Analysis cache %s was searched with other evaluation weights, clearing it", path.c_str());
+		std::memset((void*)slots, 0, (size_t)(nBuckets * ANALYSIS_CACHE_BUCKET_SLOTS * sizeof(Slot)));
+		header->evalHash = evalHash;
+	}
+
+	// Starts writing the changed pages back, waits for it to finish when asked to
+	void flush(bool wait = false) {
+		if (!memory) return;
+#ifdef _WIN32
+		FlushViewOfFile(memory, 0);
+		if (wait) FlushFileBuffers(file);
+#else
+		msync(memory, mappedSize, wait ? MS_SYNC : MS_ASYNC);
+#endif
+	}
+
+	bool probe(uint64_t key, TTEntry& entry) {
+		if (!slots) return false;
+		Slot* bucket = slots + (key & (nBuckets - 1)) * ANALYSIS_CACHE_BUCKET_SLOTS;
+		for (int i = 0; i < ANALYSIS_CACHE_BUCKET_SLOTS; i++) {
+			uint64_t data = bucket[i].data.load(std::memory_order_relaxed);
+			if ((bucket[i].key.load(std::memory_order_relaxed) ^ data) != key || data == 0)
+				continue;
+			entry.move = Move((data >> 6) & 0x3f, data & 0x3f, (data >> 12) & 0xf);
+			entry.score = (int16_t)((data >> 16) & 0xffff);
+			entry.depth = getDepth(data);
+			entry.bound = (data >> 40) & 0x3;
+			return true;
+		}
+		return false;
+	}
+
+	void store(uint64_t key, Move move, int score, int depth, int bound) {
+		if (!slots || depth < ANALYSIS_CACHE_MIN_DEPTH) return;
+		Slot* bucket = slots + (key & (nBuckets - 1)) * ANALYSIS_CACHE_BUCKET_SLOTS;
+		Slot* replaced = nullptr;
+		int replacedWorth = 0;
+		for (int i = 0; i < ANALYSIS_CACHE_BUCKET_SLOTS; i++) {
+			uint64_t data = bucket[i].data.load(std::memory_order_relaxed);
+			if (data == 0) { // Never written, taken before any result
+				if (!replaced || replacedWorth > -INFINITE_WORTH) replaced = &bucket[i];
+				replacedWorth = -INFINITE_WORTH;
+				continue;
+			}
+			if ((bucket[i].key.load(std::memory_order_relaxed) ^ data) == key) {
+				if (getDepth(data) > depth) return;
+				replaced = &bucket[i];
+				break;
+			}
+			int worth = getDepth(data) - ANALYSIS_CACHE_AGE_WEIGHT * getAge(data);
+			if (!replaced || worth < replacedWorth) {
+				replaced = &bucket[i];
+				replacedWorth = worth;
+			}
+		}
+
+		uint64_t data = packData(move, score, depth, bound, generation);
+		replaced->key.store(key ^ data, std::memory_order_relaxed);
+		replaced->data.store(data, std::memory_order_relaxed);
+	}
+};
+
+#endif
@@ -0,0 +1,197 @@
+#ifndef BATCH_EVALUATION_H
+#define BATCH_EVALUATION_H
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "index_model/board.h"
+#include "index_model/evaluation.h"
+#include "index_model/piece.h"
+#include "index_model/training_data.h"
+
+const int EVAL_BATCH_SIZE = 16; // One AVX-512 vector of 32 bit sums, or two of AVX2
+
+// Positions laid out for evaluating them together: the piece on every square across the positions of
+// the batch lies in 16 consecutive bytes, as its code type | color << 3, 0 for an empty square. The pawns,
+// kings and endgame state of each position are taken when it is added, the scalar part of the
+// evaluation only needs those
+struct EvalBatch {
+	alignas(64) uint8_t pieces[64][EVAL_BATCH_SIZE];
+	uint64_t pawns[EVAL_BATCH_SIZE][2];
+	uint8_t kingSquare[EVAL_BATCH_SIZE][2];
+	uint8_t endgame[EVAL_BATCH_SIZE];
+	uint8_t sideToMove[EVAL_BATCH_SIZE];
+	int nPositions = 0;
+
+	EvalBatch() { clear(); }
+
+	void clear() {
+		std::memset(pieces, 0, sizeof(pieces));
+		nPositions = 0;
+	}
+
+	bool isFull() { return nPositions == EVAL_BATCH_SIZE; }
+
+	// The batch must not be full
+	void add(ChessBoardIndex& board) {
+		int lane = nPositions++;
+		pawns[lane][BLACK] = pawns[lane][WHITE] = 0;
+		for (int square = 0; square < 64; square++) {
+			Piece piece = board.mailbox[square];
+			int type = piece.getType();
+			pieces[square][lane] = type == EMPTY ? 0 : (uint8_t)(type | (piece.getColor() << 3));
+			if (type == PAWN) pawns[lane][piece.getColor()] |= 1ULL << square;
+		}
+		kingSquare[lane][BLACK] = (uint8_t)board.pieceList.kingSquare[BLACK];
+		kingSquare[lane][WHITE] = (uint8_t)board.pieceList.kingSquare[WHITE];
+		endgame[lane] = Evaluator::isEndgame(board.pieceList.nSpecPieces);
+		sideToMove[lane] = (uint8_t)board.sideToMove;
+	}
+
+	// Straight from a training file, without setting up a board
+	void add(const PackedPosition& position) {
+		int lane = nPositions++;
+		int nSpecPieces[2][6] = { { 0 }, { 0 } };
+		int nPieces = 0;
+		pawns[lane][BLACK] = pawns[lane][WHITE] = 0;
+		kingSquare[lane][BLACK] = kingSquare[lane][WHITE] = 0;
+		for (int square = 0; square < 64; square++) {
+			if (!(position.occupancy & (1ULL << square))) {
+				pieces[square][lane] = 0;
+				continue;
+			}
+			int code = (position.pieces[nPieces / 2] >> (4 * (nPieces % 2))) & 0xf;
+			int type = code & 0x7, color = code >> 3;
+			nPieces++;
+			pieces[square][lane] = (uint8_t)code;
+			if (type < PAWN || type > KING) continue;
+			nSpecPieces[color][type - 1]++;
+			if (type == PAWN) pawns[lane][color] |= 1ULL << square;
+			if (type == KING) kingSquare[lane][color] = (uint8_t)square;
+		}
+		endgame[lane] = Evaluator::isEndgame(nSpecPieces);
+		sideToMove[lane] = (position.flags & 1) ? WHITE : BLACK;
+	}
+};
+
+// Evaluates a batch of positions to the same scores Evaluator::evaluate gives each of them. Material and
+// piece-square tables, which make up most of the work, are summed for all positions at once: the values
+// of the 16 piece codes on a square fit one register as 16 bit numbers, so looking up the piece of every
+// position is one permute with AVX-512, or two byte shuffles for the low and high bytes with AVX2. Other
+// builds fall back to a plain loop, which is also taken when a value does not fit 16 bits. Which one is
+// compiled in depends on the options the engine is built with (CHESS_ARCH). Pawn structure and king
+// shelter are scored per position from the pawn bitboards, without a pawn hash table in between since
+// the positions of a batch are rarely related
+class BatchEvaluator {
+
+	std::unique_ptr<Evaluator> evaluator;
+	int32_t pieceSquareValues[64][16];           // By square and piece code, from white, the king with its middlegame table
+	alignas(32) int16_t shortValues[64][16];     // The same as 16 bit numbers
+	alignas(16) uint8_t lowBytes[64][16];        // And split into bytes
+	alignas(16) uint8_t highBytes[64][16];
+	bool fitsShort = true;
+	int kingEndgameChange[2][64];                // What the endgame table changes for a king of each color, from white
+
+	void sumPieceSquaresScalar(const EvalBatch& batch, int32_t* sums) {
+		for (int lane = 0; lane < EVAL_BATCH_SIZE; lane++)
+			sums[lane] = 0;
+		for (int square = 0; square < 64; square++)
+			for (int lane = 0; lane < EVAL_BATCH_SIZE; lane++)
+				sums[lane] += pieceSquareValues[square][batch.pieces[square][lane] & 0xf];
+	}
+
+public:
+
+	BatchEvaluator(const EvalParameters& parameters = getEvalParameters()) : evaluator(new Evaluator()) {
+		setParameters(parameters);
+	}
+
+	void setParameters(const EvalParameters& parameters) {
+		evaluator->setParameters(parameters);
+		std::memset(pieceSquareValues, 0, sizeof(pieceSquareValues));
+		for (int square = 0; square < 64; square++)
+			for (int color = BLACK; color <= WHITE; color++) {
+				int tableSquare = color == WHITE ? square : square ^ 56;
+				int sign = color == WHITE ? 1 : -1;
+				for (int type = PAWN; type <= KING; type++)
+					pieceSquareValues[square][type | (color << 3)] =
+						sign * (parameters.pieceValue[type] + parameters.pieceSquareTable[type][tableSquare]);
+				kingEndgameChange[color][square] = sign * (parameters.kingEndgameTable[tableSquare] - parameters.pieceSquareTable[KING][tableSquare]);
+			}
+
+		fitsShort = true;
+		for (int square = 0; square < 64; square++)
+			for (int code = 0; code < 16; code++) {
+				int value = pieceSquareValues[square][code];
+				fitsShort &= value >= INT16_MIN && value <= INT16_MAX;
+				shortValues[square][code] = (int16_t)value;
+				lowBytes[square][code] = (uint8_t)((uint16_t)value & 0xff);
+				highBytes[square][code] = (uint8_t)((uint16_t)value >> 8);
+			}
+	}
+
+	// Material and piece-square tables of every position of the batch from white, the king with its middlegame table
+	void sumPieceSquares(const EvalBatch& batch, int32_t* sums) {
+		if (!fitsShort) {
+			sumPieceSquaresScalar(batch, sums);
+			return;
+		}
+#if defined(__AVX512BW__) && defined(__AVX512VL__)
+		__m512i sum = _mm512_setzero_si512();
+		for (int square = 0; square < 64; square++) {
+			__m256i codes = _mm256_cvtepu8_epi16(_mm_load_si128((const __m128i*)batch.pieces[square]));
+			__m256i values = _mm256_permutexvar_epi16(codes, _mm256_load_si256((const __m256i*)shortValues[square]));
+			sum = _mm512_add_epi32(sum, _mm512_cvtepi16_epi32(values));
+		}
+		_mm512_storeu_si512((void*)sums, sum);
+#elif defined(__AVX2__)
+		__m256i sumLow = _mm256_setzero_si256(), sumHigh = _mm256_setzero_si256();
+		for (int square = 0; square < 64; square++) {
+			__m128i codes = _mm_load_si128((const __m128i*)batch.pieces[square]);
+			__m128i low = _mm_shuffle_epi8(_mm_load_si128((const __m128i*)lowBytes[square]), codes);
+			__m128i high = _mm_shuffle_epi8(_mm_load_si128((const __m128i*)highBytes[square]), codes);
+			sumLow = _mm256_add_epi32(sumLow, _mm256_cvtepi16_epi32(_mm_unpacklo_epi8(low, high)));
+			sumHigh = _mm256_add_epi32(sumHigh, _mm256_cvtepi16_epi32(_mm_unpackhi_epi8(low, high)));
+		}
+		_mm256_storeu_si256((__m256i*)sums, sumLow);
+		_mm256_storeu_si256((__m256i*)(sums + 8), sumHigh);
+#else
+		sumPieceSquaresScalar(batch, sums);
+#endif
+	}
+
+	// Scores in centipawns from the side to move, for the first nPositions entries of scores
+	void evaluate(const EvalBatch& batch, int* scores) {
+		alignas(64) int32_t sums[EVAL_BATCH_SIZE];
+		sumPieceSquares(batch, sums);
+		for (int lane = 0; lane < batch.nPositions; lane++) {
+			int whiteScore = sums[lane];
+			const uint8_t* kings = batch.kingSquare[lane];
+			if (batch.endgame[lane])
+				whiteScore += kingEndgameChange[WHITE][kings[WHITE]] + kingEndgameChange[BLACK][kings[BLACK]];
+			whiteScore += evaluator->evaluatePawnStructure(batch.pawns[lane]);
+			if (!batch.endgame[lane])
+				whiteScore += evaluator->evaluateKingShelter(batch.pawns[lane][WHITE], WHITE, kings[WHITE]) -
+					evaluator->evaluateKingShelter(batch.pawns[lane][BLACK], BLACK, kings[BLACK]);
+			scores[lane] = batch.sideToMove[lane] == WHITE ? whiteScore : -whiteScore;
+		}
+	}
+
+	const char* getInstructionSet() {
+		if (!fitsShort) return "scalar";
+#if defined(__AVX512BW__) && defined(__AVX512VL__)
+		return "AVX-512";
+#elif defined(__AVX2__)
+		return "AVX2";
+#else
+		return "scalar";
+#endif
+	}
+};
+
+#endif
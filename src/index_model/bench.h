@@ -0,0 +1,107 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "index_model/search.h"
+#include "index_model/transposition.h"
+
+const int BENCH_DEPTH = 6;
+
+// Searched in this order by every bench run, changing the list changes the signature
+const char* const benchPositions[] = {
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+	"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+	"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+	"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+	"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+	"r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP2BPPP/R1BQ1RK1 w - - 0 9",
+	"2rq1rk1/pp1bppbp/3p1np1/4n3/3NP3/1BN1BP2/PPPQ2PP/2KR3R w - - 0 12",
+	"r2q1rk1/1b1nbppp/p2ppn2/1p6/3NP3/1BN1BP2/PPPQ2PP/2KR3R w - - 0 12",
+	"8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 1",
+	"8/5pk1/6p1/8/5P2/6P1/5K2/8 w - - 0 1",
+	"8/8/1p3k2/p1r5/P7/1P3K2/4R3/8 w - - 0 1"
+};
+
+struct BenchResult {
+	long long nodes = 0; // The signature, equal between runs unless the search changed
+	double seconds = 0.0;
+
+	long long getNPS() const { return seconds > 0.0 ? (long long)(nodes / seconds) : 0; }
+};
+
+// Searches every bench position single threaded to a fixed depth, starting each one with an empty
+// transposition table so the node count does not depend on what ran before. The signature is that of
+// the default options, others are for comparing techniques
+inline BenchResult runBench(int depth = BENCH_DEPTH, std::ostream* out = nullptr, const SearchOptions& options = SearchOptions()) {
+	TranspositionTable transpositionTable;
+	std::unique_ptr<Searcher> searcher(new Searcher(transpositionTable));
+	searcher->setOptions(options);
+	BenchResult result;
+
+	int position = 1;
+	for (const char* state : benchPositions) {
+		transpositionTable.clear();
+		searcher->setPosition(state, std::vector<Move>(), 0);
+		auto start = std::chrono::steady_clock::now();
+		SearchResult searchResult = searcher->search(depth);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		result.nodes += searchResult.nodes;
+		result.seconds += seconds;
+		if (out) *out << "Position " << position++ << ": " << searchResult.nodes << " nodes\n";
+	}
+	if (out) {
+		*out << "===========================\n";
+		*out << "Total time (ms) : " << (long long)(result.seconds * 1000) << "\n";
+		*out << "Nodes searched  : " << result.nodes << "\n";
+		*out << "Nodes/second    : " << result.getNPS() << "\n";
+	}
+	return result;
+}
+
+// Runs the bench with every search option, without each one in turn and without all of them, which is plain
+// alpha-beta with a transposition table, move ordering and quiescence. Nodes and time are compared to plain
+// alpha-beta at the same depth
+inline void runBenchReport(int depth, std::ostream& out) {
+	const int nOptions = (int)(sizeof(SEARCH_OPTION_NAMES) / sizeof(SEARCH_OPTION_NAMES[0]));
+	std::vector<std::string> names;
+	std::vector<BenchResult> results;
+	names.push_back("all options");
+	results.push_back(runBench(depth));
+	for (int i = 0; i < nOptions; i++) {
+		SearchOptions options;
+		*getSearchOption(options, SEARCH_OPTION_NAMES[i]) = false;
+		names.push_back(std::string("without ") + SEARCH_OPTION_NAMES[i]);
+		results.push_back(runBench(depth, nullptr, options));
+	}
+	SearchOptions plain;
+	for (int i = 0; i < nOptions; i++)
+		*getSearchOption(plain, SEARCH_OPTION_NAMES[i]) = false;
+	BenchResult plainResult = runBench(depth, nullptr, plain);
+	names.push_back("plain alpha-beta");
+	results.push_back(plainResult);
+
+	std::string title = "Depth " + std::to_string(depth);
+	int width = (int)title.size();
+	for (const std::string& name : names)
+		width = std::max(width, (int)name.size());
+	char line[160];
+	std::snprintf(line, sizeof(line), "%-*s %12s %10s %10s %10s\n", width, title.c_str(), "nodes", "ms", "nodes %", "time %");
+	out << line;
+	for (size_t i = 0; i < results.size(); i++) {
+		std::snprintf(line, sizeof(line), "%-*s %12lld %10lld %9.1f%% %9.1f%%\n", width, names[i].c_str(), results[i].nodes,
+			(long long)(results[i].seconds * 1000), 100.0 * results[i].nodes / plainResult.nodes,
+			plainResult.seconds > 0.0 ? 100.0 * results[i].seconds / plainResult.seconds : 0.0);
+		out << line;
+	}
+}
+
+#endif
@@ -4,12 +4,15 @@
 #include "index_model/piece.h"
 #include "index_model/move.h"
 #include "index_model/move_gen.h"
+#include "index_model/game_tree.h"
 #include "index_model/mailbox.h"
+#include "index_model/zobrist.h"
 
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <map>
 #include <sstream>
-#include <iostream>
 
 #define CHECKMATE 1
 #define STALEMATE 2
@@ -38,18 +41,29 @@ class ChessBoardIndex {
 
 	int possibleEpCapture = -1;
 	int filteredMoves[MAX_AVAILABLE_MOVES];
+	std::vector<Move> replayMoves;
+	ChessMoves availableMoves;
+	MoveLookup moveLookup;
+	bool availableMovesValid = false; // Cleared by every change of the position, moves are generated when asked for
+
+	bool isUnmovedPiece(int square, int type, int color) {
+		return mailbox[square].getType() == type && mailbox[square].getColor() == color && !mailbox[square].hasMoved();
+	}
 
 public:
 	Mailbox mailbox;
-	ChessMoves availableMoves;
 	PieceList pieceList;
-	MadeMoves madeMoves;
+	GameTree gameTree;
 	int sideToMove;
 	int promotedPawnSquare = -1;
 	int halfMoveClock = 0;
+	uint64_t hashKey = 0; // Pieces and side to move, castling and en passant are added in getHashKey
+	uint64_t pawnKey = 0; // Pawns only, for the pawn structure cache of the evaluation
+	std::string initialState;
 	
 	void changeBoardState(std::string state) {
 
+		initialState = state;
 		std::istringstream stateParts(state);
 
 		std::string statePart;
@@ -89,9 +103,12 @@ public:
 
 		possibleEpCapture = -1;
 		promotedPawnSquare = -1;
-		madeMoves.resetMadeMoves();
+		gameTree.reset();
 		//Implement rest of Forsyth–Edwards Notation
-		updateAvailableMoves();
+		hashKey = computeHashKey();
+		pawnKey = computePawnKey();
+		gameTree.setKeyframe(getSnapshot());
+		availableMovesValid = false;
 	}
 
 	MadeMove getMadeMove(Move move) {
@@ -100,6 +117,8 @@ public:
 		madeMove.movedPieceFlags = mailbox[move.getFrom()].getFlags();
 		madeMove.move = move;
 		madeMove.halfMoveClock = this->halfMoveClock;
+		madeMove.hashKey = this->hashKey;
+		madeMove.pawnKey = this->pawnKey;
 		if (move.isCapture()) {
 			int capturedSquare;
 			if (move.isEpCapture()) capturedSquare = mailbox.getCapturedEpSquare(move);
@@ -110,10 +129,12 @@ public:
 		return madeMove;
 	}
 
+	// updateMoves returns whether the game ended, which generates the moves of the new position
 	int makeMove(Move move, bool waitForSelection = false, bool updateMoves = true, bool updateMadeMoves = true) {
+		availableMovesValid = false;
 		if (updateMadeMoves) {
 			MadeMove madeMove = getMadeMove(move);
-			madeMoves.addMove(madeMove);
+			gameTree.addMove(madeMove);
 		}
 
 		int promotionCause = 0;
@@ -125,6 +146,9 @@ public:
 			if (move.isEpCapture()) capturedSquare = mailbox.getCapturedEpSquare(move);
 			else capturedSquare = move.getTo();
 			pieceList.removePiece(capturedSquare, sideToMove ^ WHITE, mailbox[capturedSquare].getType());
+			hashKey ^= zobristKeys.getPieceKey(sideToMove ^ WHITE, mailbox[capturedSquare].getType(), capturedSquare);
+			if (mailbox[capturedSquare].getType() == PAWN)
+				pawnKey ^= zobristKeys.getPieceKey(sideToMove ^ WHITE, PAWN, capturedSquare);
 			mailbox[capturedSquare].setType(EMPTY);
 		}
 
@@ -141,6 +165,10 @@ public:
 		else if (!piece.hasMoved())
 			piece.setFlags(MOVED);
 
+		hashKey ^= zobristKeys.getPieceKey(sideToMove, piece.getType(), move.getFrom()) ^
+			zobristKeys.getPieceKey(sideToMove, piece.getType(), move.getTo());
+		if (piece.getType() == PAWN)
+			pawnKey ^= zobristKeys.getPieceKey(sideToMove, PAWN, move.getFrom()) ^ zobristKeys.getPieceKey(sideToMove, PAWN, move.getTo());
 		pieceList.movePiece(move.getFrom(), move.getTo(), sideToMove);
 		mailbox.movePiece(move.getFrom(), move.getTo());
 		
@@ -148,34 +176,76 @@ public:
 			std::pair<int, int> rookMove = mailbox.getRookMoveFromCastle(move);
 			mailbox.movePiece(rookMove.first, rookMove.second);
 			pieceList.movePiece(rookMove.first, rookMove.second, sideToMove);
+			hashKey ^= zobristKeys.getPieceKey(sideToMove, ROOK, rookMove.first) ^
+				zobristKeys.getPieceKey(sideToMove, ROOK, rookMove.second);
 		}
 		else if (move.isPromotion()) {
 			promotedPawnSquare = move.getTo();
 			if (!waitForSelection)
-				promotionCause = updatePromotion((move.getFlags() & (~0x4)) - 8, updateMoves);
+				promotionCause = updatePromotion((move.getFlags() & (~0x4)) - 8, updateMoves, updateMadeMoves);
 		}
 		
 		if (!move.isPromotion()) { //Promotion happens first, then moves are updated
 			sideToMove ^= WHITE;
-			if (updateMoves) {
-				updateAvailableMoves();
+			hashKey ^= zobristKeys.sideKey;
+			if (updateMadeMoves && gameTree.needsKeyframe()) gameTree.setKeyframe(getSnapshot());
+			if (updateMoves)
 				return checkGameEnded();
-			}
 		}
 		return promotionCause;
 	}
 
-	void unmakeLastMove(bool updateMoves = false) {
-		if (madeMoves.nMadeMoves == 0) return;
+	// Passes the turn, for null move pruning in the search. The clock restarts so repetitions are not looked
+	// for across the null move
+	MadeMove makeNullMove() {
+		MadeMove nullMove;
+		nullMove.previousEpCapture = possibleEpCapture;
+		nullMove.halfMoveClock = halfMoveClock;
+		nullMove.hashKey = hashKey;
+		nullMove.pawnKey = pawnKey;
+		availableMovesValid = false;
+		if (possibleEpCapture != -1) {
+			mailbox[possibleEpCapture].setFlags(MOVED);
+			possibleEpCapture = -1;
+		}
+		halfMoveClock = 0;
+		sideToMove ^= WHITE;
+		hashKey ^= zobristKeys.sideKey;
+		return nullMove;
+	}
 
-		MadeMove lastMove = madeMoves.getLastMove();
-		Move& move = lastMove.move;
-		madeMoves.popLastMove();
-		unmakeMove(lastMove, updateMoves);
+	void unmakeNullMove(MadeMove& nullMove) {
+		availableMovesValid = false;
+		halfMoveClock = nullMove.halfMoveClock;
+		hashKey = nullMove.hashKey;
+		pawnKey = nullMove.pawnKey;
+		sideToMove ^= WHITE;
+		possibleEpCapture = nullMove.previousEpCapture;
+		if (possibleEpCapture != -1) mailbox[possibleEpCapture].setFlags(EN_PASSANT);
+	}
+
+	void unmakeLastMove() {
+		if (gameTree.getPly() == 0) return;
+
+		MadeMove lastMove = gameTree.getLastMove();
+		gameTree.popLastMove();
+		unmakeMove(lastMove);
+	}
+
+	// Takes back a move that should not have been played, such as one a game server rejected
+	void takeBackLastMove() {
+		if (gameTree.getPly() == 0) return;
+
+		MadeMove lastMove = gameTree.getLastMove();
+		gameTree.removeLastMove();
+		unmakeMove(lastMove);
 	}
 
-	void unmakeMove(MadeMove& lastMove, bool updateMoves = false) {
+	void unmakeMove(MadeMove& lastMove) {
+		availableMovesValid = false;
 		halfMoveClock = lastMove.halfMoveClock;
+		hashKey = lastMove.hashKey;
+		pawnKey = lastMove.pawnKey;
 		Move& move = lastMove.move;
 		sideToMove ^= WHITE;
 		possibleEpCapture = lastMove.previousEpCapture;
@@ -203,80 +273,214 @@ public:
 			mailbox.movePiece(rookMove.second, rookMove.first);
 			pieceList.movePiece(rookMove.second, rookMove.first, sideToMove);
 		}
-
-		if (updateMoves)
-			updateAvailableMoves();
 	}
 
 	void goForthMadeMoves() {
-		if (madeMoves.maxMadeMoves == madeMoves.nMadeMoves) return;
-		Move move = madeMoves.getNextMove().move;
+		if (!gameTree.hasNextMove()) return;
+		Move move = gameTree.getNextMove().move;
 		makeMove(move);
 	}
 
-	int updatePromotion(int promotion, bool updateMoves = true) {
+	// Jumps to a ply of the current line from the closest snapshot before it, replaying at most
+	// KEYFRAME_INTERVAL - 1 moves without generating moves in between
+	int goToPly(int ply, bool updateMoves = true) {
+		int targetNode = gameTree.getLineNode(ply);
+		if (targetNode == -1 || promotedPawnSquare != -1) return 0;
+
+		int keyframeNode = gameTree.getKeyframeNode(targetNode);
+		restoreSnapshot(gameTree.getKeyframe(keyframeNode));
+		gameTree.setCurrent(keyframeNode);
+		gameTree.getMovesBetween(keyframeNode, targetNode, replayMoves);
+		for (Move move : replayMoves)
+			makeMove(move, false, false);
+
+		return updateMoves ? checkGameEnded() : 0;
+	}
+
+	PositionSnapshot getSnapshot() {
+		PositionSnapshot snapshot;
+		for (int i = 0; i < 64; i++) {
+			Piece piece = mailbox[i];
+			snapshot.pieces[i] = piece.getType() == EMPTY ? 0 : (uint8_t)(piece.getType() | (piece.getColor() << 3) | (piece.getFlags() << 4));
+		}
+		snapshot.sideToMove = (uint8_t)sideToMove;
+		snapshot.possibleEpCapture = (int8_t)possibleEpCapture;
+		snapshot.halfMoveClock = (uint16_t)halfMoveClock;
+		snapshot.hashKey = hashKey;
+		snapshot.pawnKey = pawnKey;
+		return snapshot;
+	}
+
+	void restoreSnapshot(const PositionSnapshot& snapshot) {
+		pieceList.resetPieceLists();
+		for (int i = 0; i < 64; i++) {
+			int piece = snapshot.pieces[i];
+			mailbox[i] = Piece(piece & 0x07, (piece >> 3) & 0x01, (piece >> 4) & 0x03);
+			if (mailbox[i].getType() != EMPTY)
+				pieceList.addPiece(i, mailbox[i].getColor(), mailbox[i].getType());
+		}
+		sideToMove = snapshot.sideToMove;
+		possibleEpCapture = snapshot.possibleEpCapture;
+		halfMoveClock = snapshot.halfMoveClock;
+		hashKey = snapshot.hashKey;
+		pawnKey = snapshot.pawnKey;
+		promotedPawnSquare = -1;
+		availableMovesValid = false;
+	}
+
+	// Replaces the last move by the next variation played from the same position
+	int switchVariation() {
+		Move move;
+		if (!gameTree.getNextVariation(move)) return 0;
+		unmakeLastMove();
+		return makeMove(move);
+	}
+
+	int updatePromotion(int promotion, bool updateMoves = true, bool updateMadeMoves = true) {
 		mailbox[promotedPawnSquare].setType(KNIGHT + promotion);
-		madeMoves.updateLastPromotionMove(promotion);
+		if (updateMadeMoves) gameTree.updateLastPromotionMove(promotion);
 		pieceList.nSpecPieces[sideToMove][PAWN - 1]--;
 		pieceList.nSpecPieces[sideToMove][KNIGHT + promotion - 1]++;
+		hashKey ^= zobristKeys.getPieceKey(sideToMove, PAWN, promotedPawnSquare) ^
+			zobristKeys.getPieceKey(sideToMove, KNIGHT + promotion, promotedPawnSquare);
+		pawnKey ^= zobristKeys.getPieceKey(sideToMove, PAWN, promotedPawnSquare);
 		sideToMove ^= WHITE;
+		hashKey ^= zobristKeys.sideKey;
 		promotedPawnSquare = -1;
-		if (updateMoves) {
-			updateAvailableMoves();
-			return checkGameEnded();
-		}
-		return 0;
+		if (updateMadeMoves && gameTree.needsKeyframe()) gameTree.setKeyframe(getSnapshot());
+		return updateMoves ? checkGameEnded() : 0;
 	}
 
-	//Very slow but only for visuals
-	Move getMove(int fromPos, int toPos) { //Promotions not implemented but should not be a problem as long as this is only used for visuals
-		for (int i = 0; i < availableMoves.nMoves; i++) {
-			Move& move = availableMoves[i];
-			if (move.getFrom() == fromPos && move.getTo() == toPos)
-				return move;
-		}
-		return Move();
+	// Empty move if it is not legal, promotion is 0 to 3 for knight to queen
+	Move getMove(int fromPos, int toPos, int promotion = 0) {
+		return getMoveLookup().getMove(fromPos, toPos, promotion);
 	}
 	
 	void filterPseudoLegalMoves(ChessMoves& moves) {
 		int nFilteredMoves = 0;
 		for (int i = 0; i < moves.nMoves; i++) {
-			Move& move = moves[i];
-
-			if (move.isCastle()) {
-				int squareBesidesKing;
-				if (move.isQueenCastle()) squareBesidesKing = pieceList.getKingSquare(sideToMove) - 1;
-				else squareBesidesKing = pieceList.getKingSquare(sideToMove) + 1;
-
-				if (moveGenerator.squareIsAttacked(pieceList.getKingSquare(sideToMove), mailbox, sideToMove) ||
-					moveGenerator.squareIsAttacked(squareBesidesKing, mailbox, sideToMove)) {
-
-					filteredMoves[nFilteredMoves] = i;
-					nFilteredMoves++;
-					continue;
-				}
-			}
-			MadeMove madeMove = getMadeMove(move);
-			this->makeMove(move, false, false, false);
-			// Color is reversed because makeMove inverts it
-			if (moveGenerator.squareIsAttacked(pieceList.getKingSquare(sideToMove ^ WHITE), mailbox, sideToMove ^ WHITE)) {
+			if (!isLegalPseudoMove(moves[i])) {
 				filteredMoves[nFilteredMoves] = i;
 				nFilteredMoves++;
 			}
-			this->unmakeMove(madeMove);
 		}
 		for (int i = nFilteredMoves - 1; i >= 0; i--)
 			moves.removeMove(filteredMoves[i]);
 	}
 
-	void updateAvailableMoves() {
-		moveGenerator.updatePossibleMoves(mailbox, pieceList, availableMoves, sideToMove);
-		this->filterPseudoLegalMoves(availableMoves);
+	// Whether a move of the move generator keeps the king out of check, castling also needs the squares it
+	// starts from and crosses to be safe
+	bool isLegalPseudoMove(Move move) {
+		if (move.isCastle()) {
+			int squareBesidesKing;
+			if (move.isQueenCastle()) squareBesidesKing = pieceList.getKingSquare(sideToMove) - 1;
+			else squareBesidesKing = pieceList.getKingSquare(sideToMove) + 1;
+
+			if (moveGenerator.squareIsAttacked(pieceList.getKingSquare(sideToMove), mailbox, sideToMove) ||
+				moveGenerator.squareIsAttacked(squareBesidesKing, mailbox, sideToMove))
+				return false;
+		}
+		MadeMove madeMove = getMadeMove(move);
+		this->makeMove(move, false, false, false);
+		// Color is reversed because makeMove inverts it
+		bool legal = !moveGenerator.squareIsAttacked(pieceList.getKingSquare(sideToMove ^ WHITE), mailbox, sideToMove ^ WHITE);
+		this->unmakeMove(madeMove);
+		return legal;
+	}
+
+	// Legal moves of the current position, generated the first time they are asked for after a change
+	ChessMoves& getAvailableMoves() {
+		if (!availableMovesValid) {
+			generateLegalMoves(availableMoves); // Makes and unmakes moves, so validate after
+			moveLookup.update(availableMoves);
+			availableMovesValid = true;
+		}
+		return availableMoves;
+	}
+
+	const MoveLookup& getMoveLookup() {
+		getAvailableMoves();
+		return moveLookup;
+	}
+
+	// Leaves the position without moves until it changes, used once the game has ended
+	void clearAvailableMoves() {
+		availableMoves.resetMoves();
+		moveLookup.clear();
+		availableMovesValid = true;
+	}
+
+	// Makes the next request for the moves generate them again, for timing the generation
+	void invalidateAvailableMoves() { availableMovesValid = false; }
+
+	void generateLegalMoves(ChessMoves& moves, int genType = GEN_ALL) {
+		if (genType == GEN_ALL && inCheck()) genType = GEN_EVASIONS;
+		moveGenerator.updatePossibleMoves(mailbox, pieceList, moves, sideToMove, genType);
+		this->filterPseudoLegalMoves(moves);
+	}
+
+	// The moves generateLegalMoves starts from, in the move generator's order and including some that leave
+	// the king in check
+	void generatePseudoLegalMoves(ChessMoves& moves) {
+		moveGenerator.updatePossibleMoves(mailbox, pieceList, moves, sideToMove, inCheck() ? GEN_EVASIONS : GEN_ALL);
+	}
+
+	// Legal moves that give check, the attacker's moves when solving for mate
+	void generateCheckingMoves(ChessMoves& moves) {
+		moveGenerator.updatePossibleMoves(mailbox, pieceList, moves, sideToMove, inCheck() ? GEN_EVASIONS : GEN_CHECKS);
+		this->filterPseudoLegalMoves(moves);
+		for (int i = moves.nMoves - 1; i >= 0; i--) {
+			MadeMove madeMove = getMadeMove(moves[i]);
+			this->makeMove(moves[i], false, false, false);
+			bool givesCheck = inCheck();
+			this->unmakeMove(madeMove);
+			if (!givesCheck)
+				moves.removeMove(i);
+		}
+	}
+
+	bool inCheck() {
+		return moveGenerator.squareIsAttacked(pieceList.getKingSquare(sideToMove), mailbox, sideToMove);
+	}
+
+	uint64_t computeHashKey() {
+		uint64_t key = 0;
+		for (int i = 0; i < 64; i++)
+			if (mailbox[i].getType() != EMPTY)
+				key ^= zobristKeys.getPieceKey(mailbox[i].getColor(), mailbox[i].getType(), i);
+		if (sideToMove == WHITE) key ^= zobristKeys.sideKey;
+		return key;
+	}
+
+	uint64_t computePawnKey() {
+		uint64_t key = 0;
+		for (int i = 0; i < 64; i++)
+			if (mailbox[i].getType() == PAWN)
+				key ^= zobristKeys.getPieceKey(mailbox[i].getColor(), PAWN, i);
+		return key;
+	}
+
+	int getCastlingRights() {
+		int rights = 0;
+		if (isUnmovedPiece(60, KING, WHITE)) {
+			if (isUnmovedPiece(63, ROOK, WHITE)) rights |= 0b0001;
+			if (isUnmovedPiece(56, ROOK, WHITE)) rights |= 0b0010;
+		}
+		if (isUnmovedPiece(4, KING, BLACK)) {
+			if (isUnmovedPiece(7, ROOK, BLACK)) rights |= 0b0100;
+			if (isUnmovedPiece(0, ROOK, BLACK)) rights |= 0b1000;
+		}
+		return rights;
+	}
+
+	uint64_t getHashKey() {
+		uint64_t key = hashKey ^ zobristKeys.castleKeys[getCastlingRights()];
+		if (possibleEpCapture != -1) key ^= zobristKeys.epKeys[possibleEpCapture % 8];
+		return key;
 	}
 
 	int checkGameEnded() {
-		std::cout << halfMoveClock << "\n";
-		if (availableMoves.nMoves == 0) {
+		if (getAvailableMoves().nMoves == 0) {
 			if (!moveGenerator.squareIsAttacked(pieceList.kingSquare[sideToMove], mailbox, sideToMove))
 				return STALEMATE;
 			else
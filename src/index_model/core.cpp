@@ -0,0 +1,31 @@
+// The chess logic is header-only. This file gives the chess-core library its object and compiles every
+// header once with the library's options, so a broken header shows up even when no tool includes it
+
+#include "index_model/piece.h"
+#include "index_model/move.h"
+#include "index_model/mailbox.h"
+#include "index_model/piece_list.h"
+#include "index_model/zobrist.h"
+#include "index_model/move_gen.h"
+#include "index_model/game_tree.h"
+#include "index_model/board.h"
+#include "index_model/notation.h"
+#include "index_model/epd.h"
+#include "index_model/pgn.h"
+#include "index_model/game_record.h"
+#include "index_model/pawn_hash.h"
+#include "index_model/evaluation.h"
+#include "index_model/batch_evaluation.h"
+#include "index_model/transposition.h"
+#include "index_model/analysis_cache.h"
+#include "index_model/search_stats.h"
+#include "index_model/search.h"
+#include "index_model/game_analysis.h"
+#include "index_model/training_data.h"
+#include "index_model/self_play.h"
+#include "index_model/tuner.h"
+#include "index_model/mate_solver.h"
+#include "index_model/perft.h"
+#include "index_model/bench.h"
+
+#include "util/logger.h"
@@ -0,0 +1,89 @@
+#ifndef EPD_H
+#define EPD_H
+
+#include <cctype>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// One line of an Extended Position Description file, the four position fields followed by operations like
+// bm Qxf7#; dm 1; id "puzzle 1";
+struct EPDRecord {
+	std::string state; // Full FEN, the clocks are set to 0 1 unless the line has them
+	std::map<std::string, std::string> operations;
+
+	std::string getOperation(const std::string& opcode, const std::string& fallback = "") const {
+		auto it = operations.find(opcode);
+		return it == operations.end() ? fallback : it->second;
+	}
+};
+
+inline bool parseEPD(const std::string& line, EPDRecord& record) {
+	std::istringstream fields(line);
+	std::string placement, side, castling, enPassant;
+	if (!(fields >> placement >> side >> castling >> enPassant))
+		return false;
+
+	std::string halfMoveClock = "0", fullMoveNumber = "1";
+	std::streampos operationsStart = fields.tellg();
+	std::string token;
+	if (fields >> token && !token.empty() && std::isdigit((unsigned char)token[0])) {
+		halfMoveClock = token;
+		operationsStart = fields.tellg();
+		if (fields >> token && !token.empty() && std::isdigit((unsigned char)token[0])) {
+			fullMoveNumber = token;
+			operationsStart = fields.tellg();
+		}
+	}
+	record.state = placement + " " + side + " " + castling + " " + enPassant + " " + halfMoveClock + " " + fullMoveNumber;
+	record.operations.clear();
+	if (operationsStart == std::streampos(-1))
+		return true;
+
+	std::string operation;
+	bool quoted = false;
+	for (size_t i = operationsStart; i <= line.size(); i++) {
+		char c = i < line.size() ? line[i] : ';';
+		if (c == '"') {
+			quoted = !quoted;
+			continue;
+		}
+		if (c != ';' || quoted) {
+			operation += c;
+			continue;
+		}
+
+		size_t start = operation.find_first_not_of(" \t\r");
+		if (start != std::string::npos) {
+			size_t end = operation.find_last_not_of(" \t\r");
+			size_t split = operation.find_first_of(" \t", start);
+			std::string opcode = operation.substr(start, split == std::string::npos || split > end ? end - start + 1 : split - start);
+			std::string operand;
+			if (split != std::string::npos && split < end) {
+				size_t operandStart = operation.find_first_not_of(" \t", split);
+				operand = operation.substr(operandStart, end - operandStart + 1);
+			}
+			record.operations[opcode] = operand;
+		}
+		operation.clear();
+	}
+	return true;
+}
+
+inline std::vector<EPDRecord> loadEPDFile(const std::string& path) {
+	std::vector<EPDRecord> records;
+	std::ifstream file(path);
+	std::string line;
+	while (std::getline(file, line)) {
+		if (line.empty() || line[0] == '#')
+			continue;
+		EPDRecord record;
+		if (parseEPD(line, record))
+			records.push_back(record);
+	}
+	return records;
+}
+
+#endif
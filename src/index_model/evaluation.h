@@ -0,0 +1,464 @@
+#ifndef EVALUATION_H
+#define EVALUATION_H
+
+#include <cstdint>
+#include <fstream>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "index_model/piece.h"
+#include "index_model/board.h"
+#include "index_model/move_gen.h"
+#include "index_model/pawn_hash.h"
+
+#define DOUBLED_PAWN_PENALTY 12
+#define ISOLATED_PAWN_PENALTY 12
+#define BACKWARD_PAWN_PENALTY 8
+#define SHELTER_PAWN_BONUS 10
+#define SHELTER_ADVANCED_PAWN_BONUS 5
+#define SHELTER_MISSING_PAWN_PENALTY 10
+
+// Index of the lowest set bit, bits must not be 0
+inline int getLowestSquare(uint64_t bits) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return (int)index;
+#else
+	return __builtin_ctzll(bits);
+#endif
+}
+
+inline int countSquares(uint64_t bits) {
+#ifdef _MSC_VER
+	return (int)__popcnt64(bits);
+#else
+	return __builtin_popcountll(bits);
+#endif
+}
+
+// Every weight of the evaluation. chess-tune fits them to game results and writes them to a parameter
+// file, getEvalParameters holds the ones new evaluators start from. The struct is nothing but ints, so
+// the flat index of a weight is its offset in ints, which is the order of the parameter file
+struct EvalParameters {
+
+	int pieceValue[7] = { 0, 100, 320, 330, 500, 900, 0 };
+	int passedPawnBonus[8] = { 0, 5, 10, 20, 35, 60, 100, 0 }; // By rank seen from the pawn's side
+
+	// Piece-square tables seen from white, square 0 is a8. Black mirrors the square vertically
+	int pieceSquareTable[7][64] = {
+		{ 0 }, // EMPTY
+		{ // PAWN
+			  0,  0,  0,  0,  0,  0,  0,  0,
+			 50, 50, 50, 50, 50, 50, 50, 50,
+			 10, 10, 20, 30, 30, 20, 10, 10,
+			  5,  5, 10, 25, 25, 10,  5,  5,
+			  0,  0,  0, 20, 20,  0,  0,  0,
+			  5, -5,-10,  0,  0,-10, -5,  5,
+			  5, 10, 10,-20,-20, 10, 10,  5,
+			  0,  0,  0,  0,  0,  0,  0,  0
+		},
+		{ // KNIGHT
+			-50,-40,-30,-30,-30,-30,-40,-50,
+			-40,-20,  0,  0,  0,  0,-20,-40,
+			-30,  0, 10, 15, 15, 10,  0,-30,
+			-30,  5, 15, 20, 20, 15,  5,-30,
+			-30,  0, 15, 20, 20, 15,  0,-30,
+			-30,  5, 10, 15, 15, 10,  5,-30,
+			-40,-20,  0,  5,  5,  0,-20,-40,
+			-50,-40,-30,-30,-30,-30,-40,-50
+		},
+		{ // BISHOP
+			-20,-10,-10,-10,-10,-10,-10,-20,
+			-10,  0,  0,  0,  0,  0,  0,-10,
+			-10,  0,  5, 10, 10,  5,  0,-10,
+			-10,  5,  5, 10, 10,  5,  5,-10,
+			-10,  0, 10, 10, 10, 10,  0,-10,
+			-10, 10, 10, 10, 10, 10, 10,-10,
+			-10,  5,  0,  0,  0,  0,  5,-10,
+			-20,-10,-10,-10,-10,-10,-10,-20
+		},
+		{ // ROOK
+			  0,  0,  0,  0,  0,  0,  0,  0,
+			  5, 10, 10, 10, 10, 10, 10,  5,
+			 -5,  0,  0,  0,  0,  0,  0, -5,
+			 -5,  0,  0,  0,  0,  0,  0, -5,
+			 -5,  0,  0,  0,  0,  0,  0, -5,
+			 -5,  0,  0,  0,  0,  0,  0, -5,
+			 -5,  0,  0,  0,  0,  0,  0, -5,
+			  0,  0,  0,  5,  5,  0,  0,  0
+		},
+		{ // QUEEN
+			-20,-10,-10, -5, -5,-10,-10,-20,
+			-10,  0,  0,  0,  0,  0,  0,-10,
+			-10,  0,  5,  5,  5,  5,  0,-10,
+			 -5,  0,  5,  5,  5,  5,  0, -5,
+			  0,  0,  5,  5,  5,  5,  0, -5,
+			-10,  5,  5,  5,  5,  5,  0,-10,
+			-10,  0,  5,  0,  0,  0,  0,-10,
+			-20,-10,-10, -5, -5,-10,-10,-20
+		},
+		{ // KING, middlegame
+			-30,-40,-40,-50,-50,-40,-40,-30,
+			-30,-40,-40,-50,-50,-40,-40,-30,
+			-30,-40,-40,-50,-50,-40,-40,-30,
+			-30,-40,-40,-50,-50,-40,-40,-30,
+			-20,-30,-30,-40,-40,-30,-30,-20,
+			-10,-20,-20,-20,-20,-20,-20,-10,
+			 20, 20,  0,  0,  0,  0, 20, 20,
+			 20, 30, 10,  0,  0, 10, 30, 20
+		}
+	};
+
+	int kingEndgameTable[64] = {
+		-50,-40,-30,-20,-20,-30,-40,-50,
+		-30,-20,-10,  0,  0,-10,-20,-30,
+		-30,-10, 20, 30, 30, 20,-10,-30,
+		-30,-10, 30, 40, 40, 30,-10,-30,
+		-30,-10, 30, 40, 40, 30,-10,-30,
+		-30,-10, 20, 30, 30, 20,-10,-30,
+		-30,-30,  0,  0,  0,  0,-30,-30,
+		-50,-30,-30,-30,-30,-30,-30,-50
+	};
+
+	int doubledPawnPenalty = DOUBLED_PAWN_PENALTY;
+	int isolatedPawnPenalty = ISOLATED_PAWN_PENALTY;
+	int backwardPawnPenalty = BACKWARD_PAWN_PENALTY;
+	int shelterPawnBonus = SHELTER_PAWN_BONUS;                 // Own pawn right in front of the king
+	int shelterAdvancedPawnBonus = SHELTER_ADVANCED_PAWN_BONUS; // One row further
+	int shelterMissingPawnPenalty = SHELTER_MISSING_PAWN_PENALTY;
+
+	struct Table {
+		std::string name;
+		int* values;
+		int count;
+	};
+
+	// The weights in file order, a table per line of the parameter file
+	std::vector<Table> getTables() {
+		static const char* typeNames[7] = { "empty", "pawn", "knight", "bishop", "rook", "queen", "king" };
+		std::vector<Table> tables = { { "pieceValue", pieceValue, 7 }, { "passedPawnBonus", passedPawnBonus, 8 } };
+		for (int type = 0; type < 7; type++)
+			tables.push_back({ std::string("pieceSquareTable.") + typeNames[type], pieceSquareTable[type], 64 });
+		tables.push_back({ "kingEndgameTable", kingEndgameTable, 64 });
+		tables.push_back({ "doubledPawnPenalty", &doubledPawnPenalty, 1 });
+		tables.push_back({ "isolatedPawnPenalty", &isolatedPawnPenalty, 1 });
+		tables.push_back({ "backwardPawnPenalty", &backwardPawnPenalty, 1 });
+		tables.push_back({ "shelterPawnBonus", &shelterPawnBonus, 1 });
+		tables.push_back({ "shelterAdvancedPawnBonus", &shelterAdvancedPawnBonus, 1 });
+		tables.push_back({ "shelterMissingPawnPenalty", &shelterMissingPawnPenalty, 1 });
+		return tables;
+	}
+
+	// All weights as one array, indexed by the flat index
+	int* getValues() { return pieceValue; }
+	const int* getValues() const { return pieceValue; }
+
+	// FNV-1a of every weight, tells apart results that were searched with other weights
+	uint32_t getHash() const {
+		const int* values = getValues();
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < sizeof(EvalParameters) / sizeof(int); i++)
+			hash = (hash ^ (uint32_t)values[i]) * 16777619u;
+		return hash;
+	}
+
+	// Table names, each followed by its values, # starts a comment. Tables the file leaves out keep their
+	// values. False if the file cannot be read or does not fit the tables, nothing is changed then
+	bool load(const std::string& path) {
+		std::ifstream file(path);
+		if (!file.is_open()) return false;
+		std::string text, line;
+		while (std::getline(file, line))
+			text += line.substr(0, line.find('#')) + "\n";
+
+		EvalParameters loaded = *this;
+		std::vector<Table> tables = loaded.getTables();
+		std::istringstream fields(text);
+		std::string name;
+		while (fields >> name) {
+			size_t table = 0;
+			while (table < tables.size() && tables[table].name != name)
+				table++;
+			if (table == tables.size()) return false;
+			for (int i = 0; i < tables[table].count; i++)
+				if (!(fields >> tables[table].values[i])) return false;
+		}
+		*this = loaded;
+		return true;
+	}
+
+	bool save(const std::string& path) {
+		std::ofstream file(path);
+		file << "# Evaluation parameters, loaded with --eval or the EvalFile option\n";
+		for (const Table& table : getTables()) {
+			file << table.name;
+			for (int i = 0; i < table.count; i++)
+				file << (table.count == 64 && i % 8 == 0 ? "\n   " : " ") << table.values[i];
+			file << "\n";
+		}
+		return file.good();
+	}
+};
+
+const int N_EVAL_PARAMETERS = sizeof(EvalParameters) / sizeof(int);
+
+// Parameters every new Evaluator starts from. Loaded from a parameter file at startup, before any search
+inline EvalParameters& getEvalParameters() {
+	static EvalParameters parameters;
+	return parameters;
+}
+
+class Evaluator {
+
+	EvalParameters parameters = getEvalParameters();
+
+	PawnHashTable pawnHashTable;
+	uint64_t adjacentFilesMask[8];
+	uint64_t passedPawnMask[2][64];  // Squares in front of the pawn on its own and adjacent files
+	uint64_t supportingPawnMask[2][64]; // Squares beside and behind the pawn on adjacent files
+
+public:
+
+	Evaluator() {
+		for (int file = 0; file < 8; file++) {
+			adjacentFilesMask[file] = 0;
+			for (int row = 0; row < 8; row++) {
+				if (file > 0) adjacentFilesMask[file] |= 1ULL << (row * 8 + file - 1);
+				if (file < 7) adjacentFilesMask[file] |= 1ULL << (row * 8 + file + 1);
+			}
+		}
+		for (int square = 0; square < 64; square++) {
+			for (int color = BLACK; color <= WHITE; color++) {
+				passedPawnMask[color][square] = 0;
+				supportingPawnMask[color][square] = 0;
+			}
+			int row = square / 8, column = square % 8;
+			for (int other = 0; other < 64; other++) {
+				int otherRow = other / 8, otherColumn = other % 8;
+				int columnDistance = otherColumn > column ? otherColumn - column : column - otherColumn;
+				if (columnDistance > 1) continue;
+				if (otherRow < row) passedPawnMask[WHITE][square] |= 1ULL << other;
+				if (otherRow > row) passedPawnMask[BLACK][square] |= 1ULL << other;
+				if (columnDistance == 1 && otherRow >= row) supportingPawnMask[WHITE][square] |= 1ULL << other;
+				if (columnDistance == 1 && otherRow <= row) supportingPawnMask[BLACK][square] |= 1ULL << other;
+			}
+		}
+	}
+
+	PawnHashTable& getPawnHashTable() { return pawnHashTable; }
+
+	EvalParameters& getParameters() { return parameters; }
+
+	// Cached pawn scores were computed with the old weights, so the pawn hash table is cleared
+	void setParameters(const EvalParameters& newParameters) {
+		parameters = newParameters;
+		pawnHashTable.clear();
+	}
+
+	// Calls add(index, coefficient) for the weights evaluate adds up for the position, index as in
+	// EvalParameters and the coefficients from white, so the score from white is the sum of coefficient
+	// times weight. It has to follow every change of evaluate, chess-tune checks that both agree
+	template <typename Add>
+	void traceEvaluation(ChessBoardIndex& board, Add add) {
+		const int* base = parameters.getValues();
+		auto addWeight = [&](const int* weight, int coefficient) { add((int)(weight - base), coefficient); };
+		PieceList& pieceList = board.pieceList;
+		bool endgame = isEndgame(pieceList);
+
+		uint64_t pawns[2] = { 0, 0 };
+		int pawnsOnFile[2][8] = { { 0 }, { 0 } };
+		for (int color = BLACK; color <= WHITE; color++) {
+			int sign = color == WHITE ? 1 : -1;
+			for (int i = 0; i < pieceList.nPieces[color]; i++) {
+				int square = pieceList.pieces[color][i];
+				int type = board.mailbox[square].getType();
+				int tableSquare = color == WHITE ? square : square ^ 56;
+				addWeight(&parameters.pieceValue[type], sign);
+				if (type == KING && endgame) addWeight(&parameters.kingEndgameTable[tableSquare], sign);
+				else addWeight(&parameters.pieceSquareTable[type][tableSquare], sign);
+				if (type != PAWN) continue;
+				pawns[color] |= 1ULL << square;
+				pawnsOnFile[color][square % 8]++;
+			}
+		}
+
+		for (int color = BLACK; color <= WHITE; color++) {
+			int sign = color == WHITE ? 1 : -1, opponent = color ^ WHITE;
+			for (int file = 0; file < 8; file++)
+				if (pawnsOnFile[color][file] > 1)
+					addWeight(&parameters.doubledPawnPenalty, -sign * (pawnsOnFile[color][file] - 1));
+			for (int i = 0; i < pieceList.nPieces[color]; i++) {
+				int square = pieceList.pieces[color][i];
+				if (board.mailbox[square].getType() != PAWN) continue;
+				int file = square % 8;
+				int rank = color == WHITE ? 7 - square / 8 : square / 8;
+				if (!(pawns[opponent] & passedPawnMask[color][square]))
+					addWeight(&parameters.passedPawnBonus[rank], sign);
+				if (!(pawns[color] & adjacentFilesMask[file]))
+					addWeight(&parameters.isolatedPawnPenalty, -sign);
+				else if (!(pawns[color] & supportingPawnMask[color][square])) {
+					int stopSquare = square + (color == WHITE ? -8 : 8);
+					for (int j = 0; j < 2; j++) {
+						int attackerSquare = moveTables.pawnCaptures[color][stopSquare][j];
+						if (attackerSquare != -1 && (pawns[opponent] & (1ULL << attackerSquare))) {
+							addWeight(&parameters.backwardPawnPenalty, -sign);
+							break;
+						}
+					}
+				}
+			}
+
+			if (endgame) continue;
+			int kingSquare = pieceList.kingSquare[color];
+			int forwardOffset = color == WHITE ? -8 : 8;
+			int column = kingSquare % 8;
+			for (int file = column - 1; file <= column + 1; file++) {
+				if (file < 0 || file > 7) continue;
+				int square = kingSquare - column + file + forwardOffset;
+				if (square < 0 || square > 63) continue;
+				int nextSquare = square + forwardOffset;
+				Mailbox& mailbox = board.mailbox;
+				if (mailbox[square].getType() == PAWN && mailbox[square].getColor() == color) addWeight(&parameters.shelterPawnBonus, sign);
+				else if (nextSquare >= 0 && nextSquare < 64 && mailbox[nextSquare].getType() == PAWN && mailbox[nextSquare].getColor() == color)
+					addWeight(&parameters.shelterAdvancedPawnBonus, sign);
+				else addWeight(&parameters.shelterMissingPawnPenalty, -sign);
+			}
+		}
+	}
+
+	// Score in centipawns from the side to move
+	int evaluate(ChessBoardIndex& board) {
+		PieceList& pieceList = board.pieceList;
+		bool endgame = isEndgame(pieceList);
+
+		int score[2] = { 0, 0 };
+		for (int color = BLACK; color <= WHITE; color++) {
+			for (int i = 0; i < pieceList.nPieces[color]; i++) {
+				int square = pieceList.pieces[color][i];
+				int type = board.mailbox[square].getType();
+				int tableSquare = color == WHITE ? square : square ^ 56;
+
+				score[color] += parameters.pieceValue[type];
+				if (type == KING && endgame) score[color] += parameters.kingEndgameTable[tableSquare];
+				else score[color] += parameters.pieceSquareTable[type][tableSquare];
+			}
+		}
+		int whiteScore = score[WHITE] - score[BLACK];
+
+		bool found;
+		PawnHashEntry& entry = pawnHashTable.probe(board.pawnKey, found);
+		if (!found) {
+			entry.key = board.pawnKey;
+			entry.score = evaluatePawnStructure(board);
+			entry.shelterKingSquare[BLACK] = entry.shelterKingSquare[WHITE] = -1;
+		}
+		whiteScore += entry.score;
+
+		if (!endgame) {
+			for (int color = BLACK; color <= WHITE; color++) {
+				int kingSquare = pieceList.kingSquare[color];
+				if (entry.shelterKingSquare[color] != kingSquare) {
+					entry.shelterKingSquare[color] = kingSquare;
+					entry.shelter[color] = evaluateKingShelter(board.mailbox, color, kingSquare);
+				}
+			}
+			whiteScore += entry.shelter[WHITE] - entry.shelter[BLACK];
+		}
+		return board.sideToMove == WHITE ? whiteScore : -whiteScore;
+	}
+
+	// Passed, isolated, doubled and backward pawns, from white
+	int evaluatePawnStructure(ChessBoardIndex& board) {
+		PieceList& pieceList = board.pieceList;
+		uint64_t pawns[2] = { 0, 0 };
+		for (int color = BLACK; color <= WHITE; color++)
+			for (int i = 0; i < pieceList.nPieces[color]; i++) {
+				int square = pieceList.pieces[color][i];
+				if (board.mailbox[square].getType() == PAWN) pawns[color] |= 1ULL << square;
+			}
+		return evaluatePawnStructure(pawns);
+	}
+
+	// The same from the pawns of each color as bitboards, bit n is square n. Works on whole sets of pawns
+	// instead of pawn by pawn, row 0 is the eighth rank, so white pawns move to lower bits
+	int evaluatePawnStructure(const uint64_t pawns[2]) {
+		const uint64_t notFileA = ~0x0101010101010101ULL, notFileH = ~0x8080808080808080ULL;
+		auto fillUp = [](uint64_t bits) { bits |= bits >> 8; bits |= bits >> 16; return bits | (bits >> 32); };  // Toward row 0
+		auto fillDown = [](uint64_t bits) { bits |= bits << 8; bits |= bits << 16; return bits | (bits << 32); };
+		auto sideways = [&](uint64_t bits) { return ((bits & notFileH) << 1) | ((bits & notFileA) >> 1); };
+
+		// Squares behind an enemy pawn on its file and the ones beside it, and squares attacked by enemy pawns
+		uint64_t blocked[2], attacked[2], supported[2];
+		uint64_t behindBlack = fillDown(pawns[BLACK]) << 8, behindWhite = fillUp(pawns[WHITE]) >> 8;
+		blocked[WHITE] = behindBlack | sideways(behindBlack);
+		blocked[BLACK] = behindWhite | sideways(behindWhite);
+		attacked[WHITE] = sideways(pawns[BLACK] << 8); // By black pawns, to the white pawns' stop squares
+		attacked[BLACK] = sideways(pawns[WHITE] >> 8);
+		supported[WHITE] = sideways(fillUp(pawns[WHITE]));  // Beside or behind an own pawn on the file next to it
+		supported[BLACK] = sideways(fillDown(pawns[BLACK]));
+
+		int score[2] = { 0, 0 };
+		for (int color = BLACK; color <= WHITE; color++) {
+			uint64_t files = fillUp(pawns[color]) & 0xff;
+			uint64_t isolated = pawns[color] & fillDown(files & ~((files << 1) | (files >> 1)));
+			uint64_t stopAttacked = color == WHITE ? attacked[WHITE] << 8 : attacked[BLACK] >> 8;
+			uint64_t backward = pawns[color] & ~isolated & ~supported[color] & stopAttacked;
+
+			score[color] -= parameters.doubledPawnPenalty * (countSquares(pawns[color]) - countSquares(files));
+			score[color] -= parameters.isolatedPawnPenalty * countSquares(isolated);
+			score[color] -= parameters.backwardPawnPenalty * countSquares(backward);
+			for (uint64_t passed = pawns[color] & ~blocked[color]; passed; passed &= passed - 1) {
+				int square = getLowestSquare(passed);
+				score[color] += parameters.passedPawnBonus[color == WHITE ? 7 - square / 8 : square / 8];
+			}
+		}
+		return score[WHITE] - score[BLACK];
+	}
+
+	// Own pawns on the king file and the files beside it, one or two rows in front of the king
+	int evaluateKingShelter(Mailbox& mailbox, int color, int kingSquare) {
+		return evaluateShelter([&](int square) { return mailbox[square].getType() == PAWN && mailbox[square].getColor() == color; },
+			color, kingSquare);
+	}
+
+	int evaluateKingShelter(uint64_t ownPawns, int color, int kingSquare) {
+		return evaluateShelter([&](int square) { return (ownPawns >> square) & 1; }, color, kingSquare);
+	}
+
+	template <typename IsOwnPawn>
+	int evaluateShelter(IsOwnPawn isOwnPawn, int color, int kingSquare) {
+		int forwardOffset = color == WHITE ? -8 : 8;
+		int column = kingSquare % 8;
+		int shelter = 0;
+		for (int file = column - 1; file <= column + 1; file++) {
+			if (file < 0 || file > 7) continue;
+			int square = kingSquare - column + file + forwardOffset;
+			if (square < 0 || square > 63) continue;
+			int nextSquare = square + forwardOffset;
+
+			if (isOwnPawn(square)) shelter += parameters.shelterPawnBonus;
+			else if (nextSquare >= 0 && nextSquare < 64 && isOwnPawn(nextSquare)) shelter += parameters.shelterAdvancedPawnBonus;
+			else shelter -= parameters.shelterMissingPawnPenalty;
+		}
+		return shelter;
+	}
+
+	bool isEndgame(PieceList& pieceList) { return isEndgame(pieceList.nSpecPieces); }
+
+	// From the number of pieces of each color and type, indexed by type - 1
+	static bool isEndgame(const int nSpecPieces[2][6]) {
+		for (int color = BLACK; color <= WHITE; color++) {
+			int minorPieces = nSpecPieces[color][KNIGHT - 1] + nSpecPieces[color][BISHOP - 1];
+			if (nSpecPieces[color][ROOK - 1] > 0) return false;
+			if (nSpecPieces[color][QUEEN - 1] > 0 && minorPieces > 1) return false;
+		}
+		return true;
+	}
+};
+
+#endif
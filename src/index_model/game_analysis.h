@@ -0,0 +1,226 @@
+#ifndef GAME_ANALYSIS_H
+#define GAME_ANALYSIS_H
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+
+#include "index_model/analysis_cache.h"
+#include "index_model/board.h"
+#include "index_model/search.h"
+#include "index_model/search_stats.h"
+#include "index_model/transposition.h"
+#include "index_model/notation.h"
+#include "index_model/move.h"
+
+#include "util/logger.h"
+
+#define NO_JUDGEMENT 0
+#define INACCURACY 1
+#define MISTAKE 2
+#define BLUNDER 3
+
+const int ANALYSIS_DEPTH = 5;
+
+struct MoveAnnotation {
+	Move move;
+	std::string san;
+	int evaluation;    // Centipawns from white after the move
+	int scoreLoss;     // Centipawns lost by the moving side compared to the best move
+	int judgement;
+	std::string bestMoveSan;
+	std::string bestLineSan; // The principal variation of the position before the move
+};
+
+inline std::string formatEvaluation(int score) { // Score from white
+	std::ostringstream text;
+	if (isMateScore(score)) {
+		int mateIn = (MATE_SCORE - (score > 0 ? score : -score) + 1) / 2;
+		text << (score > 0 ? "#" : "#-") << mateIn;
+	}
+	else {
+		text.setf(std::ios::fixed);
+		text.precision(2);
+		text << (score >= 0 ? "+" : "") << score / 100.0;
+	}
+	return text.str();
+}
+
+class GameAnalyzer {
+
+	const char* judgementSymbols[4] = { "", "?!", "?", "??" };
+	const char* judgementNAGs[4] = { "", "$6", "$2", "$4" };
+
+	TranspositionTable transpositionTable = TranspositionTable(64);
+	AnalysisCache* analysisCache = nullptr;
+	std::string initialState;
+	std::vector<Move> gameMoves;
+	std::vector<SearchResult> positionResults;
+	std::atomic<int> nextPosition{ -1 };
+	std::string result = "*";
+
+	void analyzePositions(int depth) {
+		std::unique_ptr<Searcher> searcher(new Searcher(transpositionTable));
+		searcher->setAnalysisCache(analysisCache);
+		// Positions are taken from the end of the game so the shared table carries results backwards
+		for (int ply = nextPosition.fetch_sub(1); ply >= 0; ply = nextPosition.fetch_sub(1)) {
+			searcher->setPosition(initialState, gameMoves, ply);
+			positionResults[ply] = searcher->search(depth);
+			positionStatistics[ply] = searcher->getStatistics();
+			analyzedPositions++;
+		}
+	}
+
+	int clampScore(int score) { return std::max(-1000, std::min(1000, score)); } // Keeps mate scores comparable
+
+	int getJudgement(int scoreLoss) {
+		if (scoreLoss >= 300) return BLUNDER;
+		if (scoreLoss >= 100) return MISTAKE;
+		if (scoreLoss >= 50) return INACCURACY;
+		return NO_JUDGEMENT;
+	}
+
+	void annotateMoves() {
+		ChessBoardIndex board;
+		board.changeBoardState(initialState);
+		annotations.resize(gameMoves.size());
+		positionEvaluations.resize(gameMoves.size() + 1);
+
+		for (int ply = 0; ply <= (int)gameMoves.size(); ply++) {
+			int score = positionResults[ply].score;
+			positionEvaluations[ply] = board.sideToMove == WHITE ? score : -score;
+			if (ply == (int)gameMoves.size()) break;
+
+			MoveAnnotation& annotation = annotations[ply];
+			annotation.move = gameMoves[ply];
+			annotation.san = getMoveSAN(board, gameMoves[ply]);
+			annotation.bestMoveSan = getMoveSAN(board, positionResults[ply].bestMove);
+			annotation.bestLineSan = getLineSAN(board, positionResults[ply].principalVariation);
+			annotation.scoreLoss = std::max(0, clampScore(score) + clampScore(positionResults[ply + 1].score));
+			if (annotation.move == positionResults[ply].bestMove) annotation.scoreLoss = 0;
+			annotation.judgement = getJudgement(annotation.scoreLoss);
+			board.makeMove(gameMoves[ply], false, false, false);
+			annotation.evaluation = board.sideToMove == WHITE ? positionResults[ply + 1].score : -positionResults[ply + 1].score;
+		}
+
+		ChessMoves finalMoves;
+		board.generateLegalMoves(finalMoves);
+		if (finalMoves.nMoves == 0 && board.inCheck()) result = board.sideToMove == WHITE ? "0-1" : "1-0";
+		else if (finalMoves.nMoves == 0 || board.halfMoveClock >= 100) result = "1/2-1/2";
+		else result = "*";
+	}
+
+public:
+	std::atomic<int> analyzedPositions{ 0 };
+	std::atomic<int> positionCount{ 0 }; // Read by the UI while gameMoves is being assigned on the analysis thread
+	std::atomic<bool> finished{ false };
+	std::vector<MoveAnnotation> annotations;
+	std::vector<SearchStatistics> positionStatistics; // Written by the worker that searched the position
+	std::vector<int> positionEvaluations; // Centipawns from white for every ply, the eval graph of the game
+	int analysisDepth = ANALYSIS_DEPTH;
+
+	int getPositionCount() { return positionCount; }
+
+	// Games analysed again, or games sharing their openings, are answered from the cache
+	void setAnalysisCache(AnalysisCache* cache) { analysisCache = cache; }
+
+	void analyzeGame(const std::string& state, const std::vector<Move>& moves, int depth = ANALYSIS_DEPTH, int nThreads = 0) {
+		finished = false;
+		positionCount = (int)moves.size() + 1;
+		initialState = state;
+		gameMoves = moves;
+		analysisDepth = depth;
+		analyzedPositions = 0;
+		annotations.clear();
+		positionResults.assign(moves.size() + 1, SearchResult());
+		positionStatistics.assign(moves.size() + 1, SearchStatistics());
+		transpositionTable.clear();
+
+		if (nThreads <= 0) nThreads = std::max(1, (int)std::thread::hardware_concurrency());
+		nextPosition = (int)moves.size();
+
+		std::vector<std::thread> workers;
+		for (int i = 0; i < nThreads; i++)
+			workers.emplace_back(&GameAnalyzer::analyzePositions, this, depth);
+		for (std::thread& worker : workers)
+			worker.join();
+
+		annotateMoves();
+		finished = true;
+	}
+
+	std::string getAnnotatedPGN() {
+		std::ostringstream pgn;
+		pgn << "[Event \"Chess-3D Game\"]\n";
+		pgn << "[Site \"?\"]\n";
+		pgn << "[Date \"????.??.??\"]\n";
+		pgn << "[Round \"-\"]\n";
+		pgn << "[White \"?\"]\n";
+		pgn << "[Black \"?\"]\n";
+		pgn << "[Result \"" << result << "\"]\n";
+		pgn << "[Annotator \"Chess-3D depth " << analysisDepth << "\"]\n";
+		if (initialState != "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1") {
+			pgn << "[SetUp \"1\"]\n";
+			pgn << "[FEN \"" << initialState << "\"]\n";
+		}
+		pgn << "\n";
+
+		bool whiteStarts = initialState.find(" w ") != std::string::npos;
+		for (int ply = 0; ply < (int)annotations.size(); ply++) {
+			MoveAnnotation& annotation = annotations[ply];
+			bool whiteMove = (ply % 2 == 0) == whiteStarts;
+			int moveNumber = (ply + (whiteStarts ? 0 : 1)) / 2 + 1;
+			if (whiteMove) pgn << moveNumber << ". ";
+			else if (ply == 0) pgn << moveNumber << "... ";
+
+			pgn << annotation.san;
+			if (annotation.judgement != NO_JUDGEMENT) pgn << " " << judgementNAGs[annotation.judgement];
+			if (annotation.san.back() == '#') {
+				pgn << " ";
+				continue;
+			}
+			pgn << " { [%eval " << formatEvaluation(annotation.evaluation) << "]";
+			if (annotation.judgement != NO_JUDGEMENT) pgn << " " << annotation.bestMoveSan << " was best.";
+			pgn << " } ";
+		}
+		pgn << result << "\n";
+		return pgn.str();
+	}
+
+	bool writeAnnotatedPGN(const std::string& path) {
+		std::ofstream file(path);
+		if (!file.is_open()) {
+			LOG_ERROR("Failed to write analysis to path: %s", path.c_str());
+			return false;
+		}
+		file << getAnnotatedPGN();
+		return true;
+	}
+
+	// Totals of every position searched, only complete once the analysis has finished
+	SearchStatistics getStatistics() {
+		SearchStatistics total;
+		for (const SearchStatistics& statistics : positionStatistics)
+			total += statistics;
+		return total;
+	}
+
+	bool writeStatisticsLog(const std::string& path) {
+		for (int ply = 0; ply < (int)positionStatistics.size(); ply++)
+			if (!appendStatisticsLog(path, formatStatisticsJSON(positionStatistics[ply], "ply " + std::to_string(ply))))
+				return false;
+		return true;
+	}
+
+	std::string getMoveText(int ply) {
+		MoveAnnotation& annotation = annotations[ply];
+		return annotation.san + judgementSymbols[annotation.judgement];
+	}
+};
+
+#endif
@@ -0,0 +1,303 @@
+#ifndef GAME_RECORD_H
+#define GAME_RECORD_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "index_model/board.h"
+#include "index_model/move.h"
+#include "index_model/pgn.h"
+
+// Binary game file, little endian:
+//   header   magic "CHSGAMES", version (4), reserved (4), game count (8), offset of the game table (8)
+//   games    one after the other, each:
+//              tag count (varint), per tag its name, as the index of a common name in gameRecordTagNames
+//              plus one or 0 followed by the name as a string, and its value as a string. Strings are a
+//              varint length and the bytes
+//              result (1 byte, GAME_RESULT_...), flags (1 byte, bit 0: the FEN string of the start follows)
+//              move count (varint) and one byte per move: its index in the moves MoveGenerator produces
+//              for the position, before the ones leaving the king in check are filtered out, sorted by
+//              from square, to square and flags. An index of 255 or more is written as 255 and a second
+//              byte with the rest, no position comes close
+//   table    game count + 1 offsets (8 bytes each) of the games, the last one is the end of the games
+// Indexing the generator's moves instead of the legal ones lets a reader check only the move that was
+// played instead of every move of the position, which is most of the time spent reading. They are sorted
+// because the order they are generated in also follows the board's piece lists, which checking a capture
+// for legality reorders. An index only depends on which moves MoveGenerator produces, GAME_RECORD_VERSION
+// has to be raised when that or the sort key changes
+const uint64_t GAME_RECORD_MAGIC = 0x53454d4147534843ULL; // "CHSGAMES"
+const uint32_t GAME_RECORD_VERSION = 2;
+const size_t GAME_RECORD_HEADER_SIZE = 32;
+
+const char* const gameRecordTagNames[] = { "Event", "Site", "Date", "Round", "White", "Black", "Result", "WhiteElo",
+	"BlackElo", "ECO", "Opening", "Variation", "TimeControl", "Termination", "PlyCount", "EventDate", "SetUp", "FEN",
+	"Annotator", "WhiteTitle", "BlackTitle", "UTCDate", "UTCTime" };
+const int N_GAME_RECORD_TAG_NAMES = sizeof(gameRecordTagNames) / sizeof(gameRecordTagNames[0]);
+
+inline void writeRecordVarint(std::string& out, uint64_t value) {
+	while (value >= 0x80) {
+		out += (char)(value | 0x80);
+		value >>= 7;
+	}
+	out += (char)value;
+}
+
+inline void writeRecordString(std::string& out, const std::string& text) {
+	writeRecordVarint(out, text.size());
+	out += text;
+}
+
+inline void writeRecordLittleEndian(std::string& out, uint64_t value, int bytes) {
+	for (int i = 0; i < bytes; i++)
+		out += (char)(value >> (8 * i));
+}
+
+inline uint64_t readRecordLittleEndian(const uint8_t* data, int bytes) {
+	uint64_t value = 0;
+	for (int i = 0; i < bytes; i++)
+		value |= (uint64_t)data[i] << (8 * i);
+	return value;
+}
+
+// Encodes and decodes single games, replaying them on its own board
+class GameRecordCodec {
+
+	ChessBoardIndex board;
+	ChessMoves moves;
+	int keys[MAX_AVAILABLE_MOVES];
+
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	size_t offset = 0;
+
+	bool readVarint(uint64_t& value) {
+		value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (offset >= size) return false;
+			uint8_t byte = data[offset++];
+			value |= (uint64_t)(byte & 0x7f) << shift;
+			if (!(byte & 0x80)) return true;
+		}
+		return false;
+	}
+
+	static int getMoveKey(Move move) { return (move.getFrom() << 10) | (move.getTo() << 4) | move.getFlags(); }
+
+	// The index-th generated move in key order. Moves are counted by from square first, so only the
+	// moves of one piece have to be ordered
+	Move getSortedMove(int index) {
+		uint8_t fromCounts[64] = {};
+		for (int i = 0; i < moves.nMoves; i++)
+			fromCounts[moves[i].getFrom()]++;
+		int from = 0;
+		while (index >= fromCounts[from])
+			index -= fromCounts[from++];
+		int n = 0;
+		for (int i = 0; i < moves.nMoves; i++)
+			if (moves[i].getFrom() == from) keys[n++] = getMoveKey(moves[i]);
+		std::nth_element(keys, keys + index, keys + n);
+		return Move(from, (keys[index] >> 4) & 0x3f, keys[index] & 0xf);
+	}
+
+	bool readString(std::string& text) {
+		uint64_t length;
+		if (!readVarint(length) || length > size - offset) return false;
+		text.assign((const char*)data + offset, length);
+		offset += length;
+		return true;
+	}
+
+public:
+
+	// Appends the game, false if one of its moves is not legal. out is then left as it was
+	bool encode(const GameRecord& game, std::string& out) {
+		size_t start = out.size();
+		writeRecordVarint(out, game.tags.size());
+		for (const auto& tag : game.tags) {
+			int nameIndex = 0;
+			while (nameIndex < N_GAME_RECORD_TAG_NAMES && tag.first != gameRecordTagNames[nameIndex])
+				nameIndex++;
+			if (nameIndex < N_GAME_RECORD_TAG_NAMES) out += (char)(nameIndex + 1);
+			else {
+				out += (char)0;
+				writeRecordString(out, tag.first);
+			}
+			writeRecordString(out, tag.second);
+		}
+		bool customStart = game.initialState != PGN_START_POSITION;
+		out += (char)game.result;
+		out += (char)(customStart ? 1 : 0);
+		if (customStart) writeRecordString(out, game.initialState);
+
+		writeRecordVarint(out, game.moves.size());
+		board.changeBoardState(game.initialState);
+		for (Move move : game.moves) {
+			board.generatePseudoLegalMoves(moves);
+			int key = getMoveKey(move), index = 0;
+			bool generated = false;
+			for (int i = 0; i < moves.nMoves; i++) {
+				int otherKey = getMoveKey(moves[i]);
+				if (otherKey < key) index++;
+				generated |= otherKey == key;
+			}
+			if (!generated || !board.isLegalPseudoMove(move)) {
+				out.resize(start);
+				return false;
+			}
+			out += (char)std::min(index, 255);
+			if (index >= 255) out += (char)(index - 255);
+			board.makeMove(move, false, false, false);
+		}
+		return true;
+	}
+
+	// False if the bytes are not a valid game
+	bool decode(const void* bytes, size_t length, GameRecord& game) {
+		data = (const uint8_t*)bytes;
+		size = length;
+		offset = 0;
+		game.clear();
+
+		uint64_t nTags;
+		if (!readVarint(nTags)) return false;
+		for (uint64_t i = 0; i < nTags; i++) {
+			if (offset >= size) return false;
+			int nameIndex = data[offset++];
+			std::string name, value;
+			if (nameIndex > N_GAME_RECORD_TAG_NAMES || (nameIndex == 0 && !readString(name)) || !readString(value))
+				return false;
+			if (nameIndex > 0) name = gameRecordTagNames[nameIndex - 1];
+			game.tags.emplace_back(std::move(name), std::move(value));
+		}
+		if (offset + 2 > size) return false;
+		game.result = data[offset++];
+		bool customStart = data[offset++] & 1;
+		if (customStart && !readString(game.initialState)) return false;
+
+		uint64_t nMoves;
+		if (!readVarint(nMoves) || nMoves > size - offset) return false;
+		game.moves.resize(nMoves);
+		board.changeBoardState(game.initialState);
+		for (uint64_t i = 0; i < nMoves; i++) {
+			if (offset >= size) return false;
+			board.generatePseudoLegalMoves(moves);
+			int index = data[offset++];
+			if (index == 255 && offset < size) index += data[offset++];
+			if (index >= moves.nMoves) return false;
+			Move move = getSortedMove(index);
+			if (!board.isLegalPseudoMove(move)) return false;
+			game.moves[i] = move;
+			board.makeMove(move, false, false, false);
+		}
+		return true;
+	}
+};
+
+// Writes a game file. The offset table and the header's count are written by close
+class GameFileWriter {
+
+	std::ofstream file;
+	GameRecordCodec codec;
+	std::vector<uint64_t> offsets;
+	std::string buffer;
+	uint64_t position = 0;
+
+public:
+	int skipped = 0; // Games with an illegal move, they are left out
+
+	~GameFileWriter() { close(); }
+
+	bool open(const std::string& path) {
+		file.open(path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) return false;
+		std::string header(GAME_RECORD_HEADER_SIZE, '\0');
+		file.write(header.data(), header.size());
+		position = GAME_RECORD_HEADER_SIZE;
+		offsets.clear();
+		skipped = 0;
+		return true;
+	}
+
+	bool write(const GameRecord& game) {
+		buffer.clear();
+		if (!codec.encode(game, buffer)) {
+			skipped++;
+			return false;
+		}
+		offsets.push_back(position);
+		file.write(buffer.data(), buffer.size());
+		position += buffer.size();
+		return true;
+	}
+
+	uint64_t getGameCount() { return offsets.size(); }
+
+	bool close() {
+		if (!file.is_open()) return false;
+		std::string table;
+		offsets.push_back(position);
+		for (uint64_t offset : offsets)
+			writeRecordLittleEndian(table, offset, 8);
+		file.write(table.data(), table.size());
+
+		std::string header;
+		writeRecordLittleEndian(header, GAME_RECORD_MAGIC, 8);
+		writeRecordLittleEndian(header, GAME_RECORD_VERSION, 4);
+		writeRecordLittleEndian(header, 0, 4);
+		writeRecordLittleEndian(header, offsets.size() - 1, 8);
+		writeRecordLittleEndian(header, position, 8);
+		file.seekp(0);
+		file.write(header.data(), header.size());
+		bool written = file.good();
+		file.close();
+		return written;
+	}
+};
+
+// Reads games of a game file by their number. Only the header and the offset table are read when it is
+// opened, a game is read from the file when it is asked for
+class GameFileReader {
+
+	std::ifstream file;
+	GameRecordCodec codec;
+	std::vector<uint64_t> offsets;
+	std::vector<char> buffer;
+
+public:
+
+	bool open(const std::string& path) {
+		offsets.clear();
+		file.open(path, std::ios::binary);
+		uint8_t header[GAME_RECORD_HEADER_SIZE];
+		if (!file.is_open() || !file.read((char*)header, sizeof(header))) return false;
+		if (readRecordLittleEndian(header, 8) != GAME_RECORD_MAGIC || readRecordLittleEndian(header + 8, 4) != GAME_RECORD_VERSION)
+			return false;
+		uint64_t nGames = readRecordLittleEndian(header + 16, 8);
+		uint64_t tableOffset = readRecordLittleEndian(header + 24, 8);
+
+		std::vector<uint8_t> table((nGames + 1) * 8);
+		file.seekg(tableOffset);
+		if (!file.read((char*)table.data(), table.size())) return false;
+		offsets.resize(nGames + 1);
+		for (uint64_t i = 0; i <= nGames; i++)
+			offsets[i] = readRecordLittleEndian(&table[i * 8], 8);
+		return true;
+	}
+
+	uint64_t getGameCount() { return offsets.empty() ? 0 : offsets.size() - 1; }
+
+	bool readGame(uint64_t index, GameRecord& game) {
+		if (index >= getGameCount() || offsets[index + 1] < offsets[index]) return false;
+		buffer.resize(offsets[index + 1] - offsets[index]);
+		file.clear();
+		file.seekg(offsets[index]);
+		if (!file.read(buffer.data(), buffer.size())) return false;
+		return codec.decode(buffer.data(), buffer.size(), game);
+	}
+};
+
+#endif
@@ -0,0 +1,222 @@
+#ifndef GAME_TREE_H
+#define GAME_TREE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "index_model/move.h"
+
+const int INITIAL_GAME_NODES = 1024;
+const int KEYFRAME_INTERVAL = 16; // Plies between position snapshots, a jump replays fewer moves than this
+
+// Everything needed to set up a position without replaying the game to it, pieces as type | color << 3 | flags << 4
+struct PositionSnapshot {
+	uint8_t pieces[64];
+	uint8_t sideToMove;
+	int8_t possibleEpCapture;
+	uint16_t halfMoveClock;
+	uint64_t hashKey;
+	uint64_t pawnKey;
+};
+
+struct GameNode {
+	MadeMove madeMove;       // Move leading to this node, unused at the root
+	int parent = -1;
+	int firstChild = -1;
+	int lastChild = -1;
+	int nextSibling = -1;
+	int selectedChild = -1;  // Continuation followed when going forward
+	int ply = 0;
+	int keyframe = -1;       // Snapshot of the position, at the root and every KEYFRAME_INTERVAL plies
+};
+
+// Every move of the game including the lines left by going back and playing something else. Nodes are kept
+// in one array and link to each other by index, so once it has grown to the size of the game adding moves
+// and starting variations does not allocate
+class GameTree {
+
+	std::vector<GameNode> nodes;
+	std::vector<PositionSnapshot> keyframes;
+	int current = 0;
+	bool currentIsNew = false; // The last move added a node instead of following an earlier one
+
+	int findChild(int parent, Move move) {
+		for (int child = nodes[parent].firstChild; child != -1; child = nodes[child].nextSibling)
+			if (nodes[child].madeMove.move == move)
+				return child;
+		return -1;
+	}
+
+	int addChild(int parent, const MadeMove& madeMove) {
+		int child = (int)nodes.size();
+		nodes.emplace_back();
+		nodes[child].madeMove = madeMove;
+		nodes[child].parent = parent;
+		nodes[child].ply = nodes[parent].ply + 1;
+		if (nodes[parent].lastChild == -1) nodes[parent].firstChild = child;
+		else nodes[nodes[parent].lastChild].nextSibling = child;
+		nodes[parent].lastChild = child;
+		return child;
+	}
+
+	// Only a node just added by addMove can be removed, it is always the last one in the array
+	void removeNewestNode() {
+		int node = (int)nodes.size() - 1;
+		int parent = nodes[node].parent;
+		int previous = -1;
+		for (int child = nodes[parent].firstChild; child != node; child = nodes[child].nextSibling)
+			previous = child;
+		if (previous == -1) nodes[parent].firstChild = -1;
+		else nodes[previous].nextSibling = -1;
+		nodes[parent].lastChild = previous;
+		if (nodes[parent].selectedChild == node) nodes[parent].selectedChild = previous;
+		if (nodes.back().keyframe != -1) keyframes.pop_back(); // Its snapshot is always the newest too
+		nodes.pop_back();
+	}
+
+public:
+
+	GameTree() {
+		nodes.reserve(INITIAL_GAME_NODES);
+		keyframes.reserve(INITIAL_GAME_NODES / KEYFRAME_INTERVAL);
+		reset();
+	}
+
+	void reset() { // Keeps the capacity of the array
+		nodes.clear();
+		keyframes.clear();
+		nodes.emplace_back();
+		current = 0;
+		currentIsNew = false;
+	}
+
+	// Follows the move if it was played from this position before, otherwise starts a new variation
+	void addMove(const MadeMove& madeMove) {
+		int child = findChild(current, madeMove.move);
+		currentIsNew = child == -1;
+		if (currentIsNew) child = addChild(current, madeMove);
+		nodes[current].selectedChild = child;
+		current = child;
+	}
+
+	void popLastMove() {
+		if (current != 0) current = nodes[current].parent;
+		currentIsNew = false;
+	}
+
+	// Like popLastMove, but a move that added its node is forgotten instead of staying as a continuation
+	void removeLastMove() {
+		if (!currentIsNew) return popLastMove();
+		current = nodes[current].parent;
+		removeNewestNode();
+		currentIsNew = false;
+	}
+
+	int getPly() { return nodes[current].ply; }
+	bool hasNextMove() { return nodes[current].selectedChild != -1; }
+	MadeMove getLastMove() { return current == 0 ? MadeMove() : nodes[current].madeMove; }
+	MadeMove getNextMove() { return hasNextMove() ? nodes[nodes[current].selectedChild].madeMove : MadeMove(); }
+
+	// The move is added before the promotion piece is chosen, it is moved to the variation with that piece
+	void updateLastPromotionMove(int promotion) {
+		if (current == 0) return;
+		Move move = nodes[current].madeMove.move;
+		move.setFlags(move.getFlags() | promotion);
+		if (move == nodes[current].madeMove.move) return;
+
+		int parent = nodes[current].parent;
+		int existing = findChild(parent, move);
+		if (existing != -1) {
+			if (currentIsNew) removeNewestNode();
+			current = existing;
+			currentIsNew = false;
+		}
+		else if (currentIsNew) nodes[current].madeMove.move = move;
+		else {
+			MadeMove madeMove = nodes[current].madeMove;
+			madeMove.move = move;
+			current = addChild(parent, madeMove);
+			currentIsNew = true;
+		}
+		nodes[parent].selectedChild = current;
+	}
+
+	int getVariationCount() {
+		if (current == 0) return 1;
+		int count = 0;
+		for (int child = nodes[nodes[current].parent].firstChild; child != -1; child = nodes[child].nextSibling)
+			count++;
+		return count;
+	}
+
+	// The move after the last move among those played from the same position, wrapping around
+	bool getNextVariation(Move& move) {
+		if (getVariationCount() < 2) return false;
+		int next = nodes[current].nextSibling;
+		if (next == -1) next = nodes[nodes[current].parent].firstChild;
+		move = nodes[next].madeMove.move;
+		return true;
+	}
+
+	// Moves from the start of the game through the current position and on along the selected continuation
+	std::vector<Move> getLineMoves() {
+		std::vector<Move> moves;
+		for (int node = current; node != 0; node = nodes[node].parent)
+			moves.push_back(nodes[node].madeMove.move);
+		std::vector<Move> line(moves.rbegin(), moves.rend());
+		for (int node = nodes[current].selectedChild; node != -1; node = nodes[node].selectedChild)
+			line.push_back(nodes[node].madeMove.move);
+		return line;
+	}
+
+	int getNodeCount() { return (int)nodes.size(); }
+
+	int getLineLength() {
+		int length = nodes[current].ply;
+		for (int node = nodes[current].selectedChild; node != -1; node = nodes[node].selectedChild)
+			length++;
+		return length;
+	}
+
+	// Node at the given ply of the current line, -1 past its end
+	int getLineNode(int ply) {
+		int node = current;
+		while (nodes[node].ply > ply)
+			node = nodes[node].parent;
+		while (node != -1 && nodes[node].ply < ply)
+			node = nodes[node].selectedChild;
+		return node;
+	}
+
+	bool needsKeyframe() { return nodes[current].keyframe == -1 && nodes[current].ply % KEYFRAME_INTERVAL == 0; }
+
+	void setKeyframe(const PositionSnapshot& snapshot) {
+		nodes[current].keyframe = (int)keyframes.size();
+		keyframes.push_back(snapshot);
+	}
+
+	// Closest node at or before the given one that has a snapshot, the root always has one
+	int getKeyframeNode(int node) {
+		while (nodes[node].keyframe == -1 && node != 0)
+			node = nodes[node].parent;
+		return node;
+	}
+
+	const PositionSnapshot& getKeyframe(int node) { return keyframes[nodes[node].keyframe]; }
+
+	// Moves leading from one node to a later node on the same line
+	void getMovesBetween(int fromNode, int toNode, std::vector<Move>& moves) {
+		moves.clear();
+		for (int node = toNode; node != fromNode; node = nodes[node].parent)
+			moves.push_back(nodes[node].madeMove.move);
+		std::reverse(moves.begin(), moves.end());
+	}
+
+	void setCurrent(int node) {
+		current = node;
+		currentIsNew = false;
+	}
+};
+
+#endif
@@ -8,7 +8,7 @@
 
 class Mailbox {
 
-	int mailbox[120] = {
+	static constexpr int mailbox[120] = {
 		 -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
 		 -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
 		 -1,  0,  1,  2,  3,  4,  5,  6,  7, -1,
@@ -23,7 +23,7 @@ class Mailbox {
 		 -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
 	};
 
-	int mailbox64[64] = {
+	static constexpr int mailbox64[64] = {
 		21, 22, 23, 24, 25, 26, 27, 28,
 		31, 32, 33, 34, 35, 36, 37, 38,
 		41, 42, 43, 44, 45, 46, 47, 48,
@@ -62,4 +62,4 @@ public:
 	}
 };
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -0,0 +1,228 @@
+#ifndef MATE_SOLVER_H
+#define MATE_SOLVER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "index_model/board.h"
+#include "index_model/move.h"
+
+#define MATE_UNKNOWN 0   // Ran out of nodes
+#define MATE_PROVEN 1
+#define MATE_DISPROVEN 2 // No mate within the given number of moves
+
+const uint32_t PROOF_INFINITY = 1000000000;
+const int DEFAULT_MATE_NODES = 2000000;
+
+struct ProofNode {
+	Move move;           // Move leading to this node
+	int parent;
+	int firstChild = -1; // Children are stored next to each other, -1 until expanded
+	int nChildren = 0;
+	int pliesLeft;
+	uint32_t proof;
+	uint32_t disproof;
+};
+
+struct MateResult {
+	int result = MATE_UNKNOWN;
+	int mateIn = 0;          // Attacker moves of the line found, when proven
+	std::vector<Move> line;  // Attacker moves and the longest defence, when proven
+	long long nodes = 0;
+};
+
+// Proof-number search for forced mates, kept apart from the alpha-beta search. The tree is held in memory
+// and always grown at its most-proving node. The attacker first only tries checking moves, which finds
+// most mates in a small tree, and the defender tries every legal move. A mate that is not found that way
+// may start with a quiet move, so before a position is disproven it is searched again with every move
+class MateSolver {
+
+	ChessBoardIndex board;
+	std::vector<ProofNode> nodes;
+	int maxNodes;
+	bool checksOnly = true;
+	ChessMoves moves;
+
+	static uint32_t addProof(uint32_t a, uint32_t b) { return std::min(a + b, PROOF_INFINITY); }
+
+	bool attackerToMove(const ProofNode& node) { return node.pliesLeft % 2 == 1; }
+
+	// The last attacker move has to give mate, so it has to give check
+	void generateAttackerMoves(const ProofNode& node) {
+		if (checksOnly || node.pliesLeft == 1) board.generateCheckingMoves(moves);
+		else board.generateLegalMoves(moves);
+	}
+
+	// Sets the numbers of a new node from its move count, fewer replies makes a node easier to prove or disprove
+	void initializeNode(ProofNode& node) {
+		if (attackerToMove(node)) {
+			generateAttackerMoves(node);
+			if (moves.nMoves == 0) setDisproven(node);
+			else setNumbers(node, 1, moves.nMoves);
+			return;
+		}
+		board.generateLegalMoves(moves);
+		if (moves.nMoves == 0) {
+			// Mate, or stalemate after a quiet attacker move
+			if (checksOnly || board.inCheck()) setNumbers(node, 0, PROOF_INFINITY);
+			else setDisproven(node);
+		}
+		else if (node.pliesLeft == 0) setDisproven(node);
+		else setNumbers(node, moves.nMoves, 1);
+	}
+
+	void setNumbers(ProofNode& node, uint32_t proof, uint32_t disproof) {
+		node.proof = proof;
+		node.disproof = disproof;
+	}
+
+	void setDisproven(ProofNode& node) { setNumbers(node, PROOF_INFINITY, 0); }
+
+	void expand(int index) {
+		if (attackerToMove(nodes[index])) generateAttackerMoves(nodes[index]);
+		else board.generateLegalMoves(moves);
+		ChessMoves nodeMoves = moves;
+
+		int firstChild = (int)nodes.size();
+		for (int i = 0; i < nodeMoves.nMoves; i++) {
+			ProofNode child;
+			child.move = nodeMoves[i];
+			child.parent = index;
+			child.pliesLeft = nodes[index].pliesLeft - 1;
+
+			MadeMove madeMove = board.getMadeMove(child.move);
+			board.makeMove(child.move, false, false, false);
+			initializeNode(child);
+			board.unmakeMove(madeMove);
+			nodes.push_back(child);
+		}
+		nodes[index].firstChild = firstChild;
+		nodes[index].nChildren = nodeMoves.nMoves;
+	}
+
+	void updateNumbers(ProofNode& node) {
+		bool attacker = attackerToMove(node);
+		uint32_t proof = attacker ? PROOF_INFINITY : 0;
+		uint32_t disproof = attacker ? 0 : PROOF_INFINITY;
+		for (int i = node.firstChild; i < node.firstChild + node.nChildren; i++) {
+			if (attacker) {
+				proof = std::min(proof, nodes[i].proof);
+				disproof = addProof(disproof, nodes[i].disproof);
+			}
+			else {
+				proof = addProof(proof, nodes[i].proof);
+				disproof = std::min(disproof, nodes[i].disproof);
+			}
+		}
+		setNumbers(node, proof, disproof);
+	}
+
+	int selectChild(const ProofNode& node) {
+		bool attacker = attackerToMove(node);
+		for (int i = node.firstChild; i < node.firstChild + node.nChildren; i++)
+			if ((attacker && nodes[i].proof == node.proof) || (!attacker && nodes[i].disproof == node.disproof))
+				return i;
+		return node.firstChild;
+	}
+
+	// Attacker moves needed from a proven node, taking the fastest mate and the longest defence
+	int getProofLength(int index) {
+		const ProofNode& node = nodes[index];
+		if (node.nChildren == 0)
+			return 0;
+		bool attacker = attackerToMove(node);
+		int length = attacker ? INT32_MAX : 0;
+		for (int i = node.firstChild; i < node.firstChild + node.nChildren; i++) {
+			if (nodes[i].proof != 0)
+				continue;
+			int childLength = getProofLength(i) + (attacker ? 1 : 0);
+			length = attacker ? std::min(length, childLength) : std::max(length, childLength);
+		}
+		return length;
+	}
+
+	void collectLine(int index, std::vector<Move>& line) {
+		while (nodes[index].nChildren > 0) {
+			const ProofNode& node = nodes[index];
+			bool attacker = attackerToMove(node);
+			int best = -1, bestLength = 0;
+			for (int i = node.firstChild; i < node.firstChild + node.nChildren; i++) {
+				if (nodes[i].proof != 0)
+					continue;
+				int length = getProofLength(i);
+				if (best == -1 || (attacker ? length < bestLength : length > bestLength)) {
+					best = i;
+					bestLength = length;
+				}
+			}
+			line.push_back(nodes[best].move);
+			index = best;
+		}
+	}
+
+public:
+
+	MateSolver(int maxNodes = DEFAULT_MATE_NODES) : maxNodes(maxNodes) {}
+
+	ChessBoardIndex& getBoard() { return board; }
+
+	MateResult solve(const std::string& state, int mateIn) {
+		board.changeBoardState(state);
+		checksOnly = true;
+		MateResult result = search(mateIn, maxNodes);
+		if (result.result == MATE_DISPROVEN) {
+			long long checkNodes = result.nodes;
+			checksOnly = false;
+			result = search(mateIn, maxNodes - (int)checkNodes);
+			result.nodes += checkNodes;
+		}
+		return result;
+	}
+
+private:
+
+	MateResult search(int mateIn, int nodeLimit) {
+		nodes.clear();
+		nodes.reserve(std::max(1, std::min(nodeLimit, 1 << 20)));
+
+		ProofNode root;
+		root.parent = -1;
+		root.pliesLeft = mateIn * 2 - 1;
+		initializeNode(root);
+		nodes.push_back(root);
+
+		std::vector<MadeMove> path;
+		while (nodes[0].proof != 0 && nodes[0].disproof != 0 && (int)nodes.size() < nodeLimit) {
+			int index = 0;
+			while (nodes[index].nChildren > 0) {
+				index = selectChild(nodes[index]);
+				path.push_back(board.getMadeMove(nodes[index].move));
+				board.makeMove(nodes[index].move, false, false, false);
+			}
+
+			expand(index);
+			updateNumbers(nodes[index]);
+			while (index != 0) {
+				board.unmakeMove(path.back());
+				path.pop_back();
+				index = nodes[index].parent;
+				updateNumbers(nodes[index]);
+			}
+		}
+
+		MateResult result;
+		result.nodes = (long long)nodes.size();
+		if (nodes[0].proof == 0) {
+			result.result = MATE_PROVEN;
+			result.mateIn = getProofLength(0);
+			collectLine(0, result.line);
+		}
+		else if (nodes[0].disproof == 0)
+			result.result = MATE_DISPROVEN;
+		return result;
+	}
+};
+
+#endif
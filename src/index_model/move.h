@@ -1,6 +1,8 @@
 #ifndef CHESS_MOVE_H
 #define CHESS_MOVE_H
 
+#include <cstdint>
+
 #include "index_model/piece.h"
 
 #define QUIET_MOVE				0b0000
@@ -19,7 +21,6 @@
 #define QUEEN_PROMOTION_CAP		0b1111
 
 const int MAX_AVAILABLE_MOVES = 300;
-const int MAX_GAME_MOVES = 1000;
 
 class Move {
 
@@ -79,54 +80,47 @@ public:
 	}
 };
 
-
-struct MadeMove {
-	Move move;
-	int movedPieceFlags;
-	Piece capturedPiece;
-	int previousEpCapture;
-	int halfMoveClock;
-};
-
-class MadeMoves {
-	MadeMove madeMoves[MAX_GAME_MOVES];
-	
-public:
-	int nMadeMoves = 0;
-	int maxMadeMoves = 0;
-
-	void resetMadeMoves() {
-		nMadeMoves = 0;
-		maxMadeMoves = 0;
+// Legal moves of one position indexed by squares, built once per position. destinations[from] has a bit for
+// every square the piece on from can go to, moves[from][to] is the move with promotions stored as knight ones
+struct MoveLookup {
+	uint64_t destinations[64] = {};
+	Move moves[64][64];
+
+	void update(ChessMoves& legalMoves) {
+		clear();
+		for (int i = 0; i < legalMoves.nMoves; i++) {
+			Move move = legalMoves[i];
+			if (move.isPromotion()) move.setFlags(move.getFlags() & ~0x3);
+			destinations[move.getFrom()] |= 1ULL << move.getTo();
+			moves[move.getFrom()][move.getTo()] = move;
+		}
 	}
 
-	void addMove(MadeMove move) {
-		madeMoves[nMadeMoves] = move;
-		nMadeMoves++;
-		if (maxMadeMoves < nMadeMoves) maxMadeMoves = nMadeMoves;
+	void clear() {
+		for (int i = 0; i < 64; i++)
+			destinations[i] = 0;
 	}
 
-	void popLastMove() {
-		nMadeMoves--;
-	}
-
-	MadeMove getLastMove() {
-		if (nMadeMoves == 0) return MadeMove();
-		return madeMoves[nMadeMoves - 1];
-	}
+	bool isLegal(int from, int to) const { return (destinations[from] >> to) & 1; }
 
-	MadeMove getNextMove() {
-		if (nMadeMoves == maxMadeMoves) return MadeMove();
-		return madeMoves[nMadeMoves];
-		nMadeMoves++;
-	}
-
-	void updateLastPromotionMove(int promotion) {
-		Move& move = madeMoves[nMadeMoves - 1].move;
-		move.setFlags(move.getFlags() | promotion);
+	// Promotion is 0 to 3 for knight to queen, ignored when the move does not promote
+	Move getMove(int from, int to, int promotion = 0) const {
+		if (!isLegal(from, to)) return Move();
+		Move move = moves[from][to];
+		if (move.isPromotion()) move.setFlags(move.getFlags() | (promotion & 0x3));
+		return move;
 	}
 };
 
 
+struct MadeMove {
+	Move move;
+	int movedPieceFlags;
+	Piece capturedPiece;
+	int previousEpCapture;
+	int halfMoveClock;
+	uint64_t hashKey;
+	uint64_t pawnKey;
+};
 
-#endif
\ No newline at end of file
+#endif
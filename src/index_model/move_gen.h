@@ -1,175 +1,376 @@
 #ifndef MOVE_GENERATOR_H
 #define MOVE_GENERATOR_H
 
+#include <cstdint>
+
 #include "index_model/piece.h"
 #include "index_model/mailbox.h"
 #include "index_model/piece_list.h"
 #include "index_model/move.h"
 
+#define GEN_CAPTURES 0 // Captures and promotions
+#define GEN_QUIETS 1   // Everything else, including castling
+#define GEN_EVASIONS 2 // Moves that may get the king out of check
+#define GEN_ALL 3
+#define GEN_CHECKS 4   // Moves that may give check, without the rest of the quiet moves
+
+#define NORTH 0
+#define SOUTH 1
+#define EAST 2
+#define WEST 3
+#define NORTH_EAST 4
+#define NORTH_WEST 5
+#define SOUTH_EAST 6
+#define SOUTH_WEST 7
+
+// Destination squares for every piece and square, built at compile time. -1 is off the board
+struct MoveTables {
+	int raySteps[64][8];       // Next square in each direction, rook directions first
+	int knightJumps[64][8];
+	int nKnightJumps[64];
+	int pawnCaptures[2][64][2];
+	uint64_t betweenSquares[64][64];
+
+	constexpr MoveTables() : raySteps(), knightJumps(), nKnightJumps(), pawnCaptures(), betweenSquares() {
+		const int rayRows[8] = { -1, 1, 0, 0, -1, -1, 1, 1 };
+		const int rayColumns[8] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+		const int knightRows[8] = { -2, -2, -1, -1, 1, 1, 2, 2 };
+		const int knightColumns[8] = { -1, 1, -2, 2, -2, 2, -1, 1 };
+
+		for (int square = 0; square < 64; square++) {
+			int row = square / 8, column = square % 8;
+			for (int dir = 0; dir < 8; dir++)
+				raySteps[square][dir] = getSquare(row + rayRows[dir], column + rayColumns[dir]);
+			for (int i = 0; i < 8; i++) {
+				int toSquare = getSquare(row + knightRows[i], column + knightColumns[i]);
+				if (toSquare != -1)
+					knightJumps[square][nKnightJumps[square]++] = toSquare;
+			}
+			pawnCaptures[WHITE][square][0] = getSquare(row - 1, column - 1);
+			pawnCaptures[WHITE][square][1] = getSquare(row - 1, column + 1);
+			pawnCaptures[BLACK][square][0] = getSquare(row + 1, column - 1);
+			pawnCaptures[BLACK][square][1] = getSquare(row + 1, column + 1);
+		}
+
+		for (int square = 0; square < 64; square++)
+			for (int dir = 0; dir < 8; dir++) {
+				uint64_t ray = 0;
+				for (int toSquare = raySteps[square][dir]; toSquare != -1; toSquare = raySteps[toSquare][dir]) {
+					betweenSquares[square][toSquare] = ray;
+					ray |= 1ULL << toSquare;
+				}
+			}
+	}
+
+	static constexpr int getSquare(int row, int column) {
+		return (row < 0 || row > 7 || column < 0 || column > 7) ? -1 : row * 8 + column;
+	}
+};
+
+inline constexpr MoveTables moveTables = MoveTables();
+
 class MoveGenerator {
 
-	int pieceOffset[6][8] = {
-		{   0,   0,  0,  0, 0,  0,  0,  0 }, // EMPTY
-		{ -21, -19,-12, -8, 8, 12, 19, 21 }, // KNIGHT
-		{ -11,  -9,  9, 11, 0,  0,  0,  0 }, // BISHOP
-		{ -10,  -1,  1, 10, 0,  0,  0,  0 }, // ROOK
-		{ -11, -10, -9, -1, 1,  9, 10, 11 }, // QUEEN
-		{ -11, -10, -9, -1, 1,  9, 10, 11 }  // KING
-	};
-	int pieceOffsets[6] = { 0, 8, 4, 4, 8, 8 };
-	bool slidingPiece[6] = { false, false, true, true, true, false };
-
-	int filteredMoves[MAX_AVAILABLE_MOVES];
-	
-public:
+	static constexpr int rayStart[7] = { 0, 0, 0, 4, 0, 0, 0 }; // Bishops use the diagonal directions only
+	static constexpr int rayEnd[7] = { 0, 0, 0, 8, 4, 8, 8 };
+	static constexpr bool slidingPiece[7] = { false, false, false, true, true, true, false };
 
-	void updatePossibleMoves(Mailbox& mailbox, PieceList& pieceList, ChessMoves& moves, int sideToMove) {
+public:
 
+	void updatePossibleMoves(Mailbox& mailbox, PieceList& pieceList, ChessMoves& moves, int sideToMove, int genType = GEN_ALL) {
 		moves.resetMoves();
-		int (&piecePositions)[16] = pieceList.pieces[sideToMove];
-		int& nPieces = pieceList.nPieces[sideToMove];
+		if (sideToMove == WHITE) generateMoves<WHITE>(mailbox, pieceList, moves, genType);
+		else generateMoves<BLACK>(mailbox, pieceList, moves, genType);
+	}
+
+	bool squareIsAttacked(int square, Mailbox& mailbox, int color) {
+		for (int i = 0; i < moveTables.nKnightJumps[square]; i++) {
+			Piece attackingPiece = mailbox[moveTables.knightJumps[square][i]];
+			if (attackingPiece.getType() == KNIGHT && attackingPiece.getColor() != color)
+				return true;
+		}
+		for (int dir = 0; dir < 8; dir++) {
+			int toSquare = moveTables.raySteps[square][dir];
+			if (toSquare == -1)
+				continue;
+			Piece attackingPiece = mailbox[toSquare];
+			if (attackingPiece.getType() == KING && attackingPiece.getColor() != color)
+				return true;
+
+			int diagonalSlider = dir >= NORTH_EAST ? BISHOP : ROOK;
+			for (; toSquare != -1; toSquare = moveTables.raySteps[toSquare][dir]) {
+				attackingPiece = mailbox[toSquare];
+				if (attackingPiece.getType() == EMPTY)
+					continue;
+				if (attackingPiece.getColor() != color && (attackingPiece.getType() == diagonalSlider || attackingPiece.getType() == QUEEN))
+					return true;
+				break;
+			}
+		}
+		for (int i = 0; i < 2; i++) {
+			int pawnSquare = moveTables.pawnCaptures[color][square][i];
+			if (pawnSquare != -1 && mailbox[pawnSquare].getType() == PAWN && mailbox[pawnSquare].getColor() != color)
+				return true;
+		}
+		return false;
+	}
+
+private:
 
+	template<int Side>
+	void generateMoves(Mailbox& mailbox, PieceList& pieceList, ChessMoves& moves, int genType) {
+		switch (genType) {
+		case GEN_CAPTURES: generateMoves<Side, GEN_CAPTURES>(mailbox, pieceList, moves); break;
+		case GEN_QUIETS: generateMoves<Side, GEN_QUIETS>(mailbox, pieceList, moves); break;
+		case GEN_EVASIONS: generateMoves<Side, GEN_EVASIONS>(mailbox, pieceList, moves); break;
+		case GEN_CHECKS: generateCheckCandidates<Side>(mailbox, pieceList, moves); break;
+		default: generateMoves<Side, GEN_ALL>(mailbox, pieceList, moves); break;
+		}
+	}
+
+	template<int Side, int GenType>
+	void generateMoves(Mailbox& mailbox, PieceList& pieceList, ChessMoves& moves) {
+		constexpr bool quiets = GenType != GEN_CAPTURES;
+
+		// Squares non-king moves must land on, when in check only the checker and the squares blocking it
+		uint64_t targets = ~0ULL;
+		int checkerSquare = -1;
+		if constexpr (GenType == GEN_EVASIONS) {
+			int nCheckers = getCheckers<Side>(mailbox, pieceList.kingSquare[Side], targets, checkerSquare);
+			if (nCheckers == 0) targets = ~0ULL;
+			if (nCheckers > 1) {
+				addPieceMoves<Side, GenType, KING>(mailbox, moves, pieceList.kingSquare[Side], targets);
+				return;
+			}
+		}
+
+		int (&piecePositions)[16] = pieceList.pieces[Side];
+		int nPieces = pieceList.nPieces[Side];
 		for (int i = 0; i < nPieces; i++) {
-			int& fromSquare = piecePositions[i];
-			Piece& piece = mailbox[fromSquare];
-
-			if (piece.getType() != PAWN) {
-				//All moves but pawns and castling
-				for (int j = 0; j < pieceOffsets[piece.getType() - 1]; j++) {
-					for (int toSquare = fromSquare;;) {
-						toSquare = mailbox.getSquareWithOffset(toSquare, pieceOffset[piece.getType() - 1][j]);
-						if (toSquare == -1)
-							break;
-
-						Piece& capturedPiece = mailbox[toSquare];
-						if (capturedPiece.getType() != EMPTY) {
-							if (capturedPiece.getColor() != sideToMove) 
-								moves.addMove(fromSquare, toSquare, CAPTURE);
-							break;
-						}
-
-						moves.addMove(fromSquare, toSquare, QUIET_MOVE);
-						if (!slidingPiece[piece.getType() - 1])
-							break;
-					}
-				}
-				//Castling
-				if (piece.getType() == KING && !piece.hasMoved()) {
-					int row;
-					if (sideToMove == WHITE) row = 7;
-					else row = 0;
-
-					Piece& kingRook = mailbox[row * 8 + 7];
-					Piece& queenRook = mailbox[row * 8];
-					bool queenSideEmpty = true, kingSideEmpty = true;
-
-					if (queenRook.getType() == ROOK && !queenRook.hasMoved()) {
-						for (int j = 0; j < 3 && queenSideEmpty; j++)
-							if (mailbox[row * 8 + 1 + j].getType() != EMPTY)
-								queenSideEmpty = false;
-						if (queenSideEmpty)
-							moves.addMove(fromSquare, row * 8 + 2, QUEEN_CASTLE);
-					}
+			int fromSquare = piecePositions[i];
+			switch (mailbox[fromSquare].getType()) {
+			case PAWN: addPawnMoves<Side, GenType>(mailbox, moves, fromSquare, targets, checkerSquare); break;
+			case KNIGHT: addPieceMoves<Side, GenType, KNIGHT>(mailbox, moves, fromSquare, targets); break;
+			case BISHOP: addPieceMoves<Side, GenType, BISHOP>(mailbox, moves, fromSquare, targets); break;
+			case ROOK: addPieceMoves<Side, GenType, ROOK>(mailbox, moves, fromSquare, targets); break;
+			case QUEEN: addPieceMoves<Side, GenType, QUEEN>(mailbox, moves, fromSquare, targets); break;
+			case KING:
+				addPieceMoves<Side, GenType, KING>(mailbox, moves, fromSquare, targets);
+				if constexpr (quiets && GenType != GEN_EVASIONS)
+					addCastlingMoves<Side>(mailbox, moves, fromSquare);
+				break;
+			}
+		}
+	}
 
-					if (kingRook.getType() == ROOK && !kingRook.hasMoved()) {
-						for (int j = 0; j < 2 && kingSideEmpty; j++)
-							if (mailbox[row * 8 + 5 + j].getType() != EMPTY)
-								kingSideEmpty = false;
-						if (kingSideEmpty)
-							moves.addMove(fromSquare, row * 8 + 6, KING_CASTLE);
-					}
+	// Direct checks land on a square attacking the enemy king, discovered checks move a piece off the line between
+	// the king and one of our sliders. Promotions, en passant and castling are always added since they can check
+	// in less obvious ways, the caller confirms the check after making the move
+	template<int Side>
+	void generateCheckCandidates(Mailbox& mailbox, PieceList& pieceList, ChessMoves& moves) {
+		constexpr int rowBeforePromotion = Side == WHITE ? 1 : 6;
+		int enemyKingSquare = pieceList.kingSquare[Side ^ WHITE];
+
+		uint64_t checkSquares[7] = {};
+		uint64_t discoveredCheckers = 0;
+		for (int i = 0; i < moveTables.nKnightJumps[enemyKingSquare]; i++)
+			checkSquares[KNIGHT] |= 1ULL << moveTables.knightJumps[enemyKingSquare][i];
+		for (int i = 0; i < 2; i++) {
+			int square = moveTables.pawnCaptures[Side ^ WHITE][enemyKingSquare][i];
+			if (square != -1) checkSquares[PAWN] |= 1ULL << square;
+		}
+		for (int dir = 0; dir < 8; dir++) {
+			int diagonalSlider = dir >= NORTH_EAST ? BISHOP : ROOK;
+			int blockerSquare = -1;
+			for (int square = moveTables.raySteps[enemyKingSquare][dir]; square != -1; square = moveTables.raySteps[square][dir]) {
+				Piece piece = mailbox[square];
+				if (blockerSquare == -1)
+					checkSquares[diagonalSlider] |= 1ULL << square;
+				if (piece.getType() == EMPTY)
+					continue;
+				if (blockerSquare != -1 || piece.getColor() != Side) {
+					if (blockerSquare != -1 && piece.getColor() == Side && (piece.getType() == diagonalSlider || piece.getType() == QUEEN))
+						discoveredCheckers |= 1ULL << blockerSquare;
+					break;
 				}
-				
+				blockerSquare = square;
 			}
-			//Pawn
-			else {
-				int forwardOffset;
-				if (sideToMove == WHITE) forwardOffset = -8;
-				else forwardOffset = 8;
-
-				bool squareBeforePromotion = ((sideToMove == WHITE && mailbox.getRow(fromSquare) == 1) ||
-					sideToMove == BLACK && mailbox.getRow(fromSquare) == 6);
-				bool inStartingSquare = ((sideToMove == BLACK && mailbox.getRow(fromSquare) == 1) ||
-					sideToMove == WHITE && mailbox.getRow(fromSquare) == 6);
-
-				if (mailbox[fromSquare + forwardOffset].getType() == EMPTY) {
-					if (squareBeforePromotion) {
-						moves.addMove(fromSquare, fromSquare + forwardOffset, KNIGHT_PROMOTION);
-						moves.addMove(fromSquare, fromSquare + forwardOffset, BISHOP_PROMOTION);
-						moves.addMove(fromSquare, fromSquare + forwardOffset, ROOK_PROMOTION);
-						moves.addMove(fromSquare, fromSquare + forwardOffset, QUEEN_PROMOTION);
-					}
-					else {
-						moves.addMove(fromSquare, fromSquare + forwardOffset, QUIET_MOVE);
-						if (inStartingSquare && mailbox[fromSquare + 2 * forwardOffset].getType() == EMPTY)
-							moves.addMove(fromSquare, fromSquare + 2 * forwardOffset, DOUBLE_PAWN_PUSH);
-					}
-				}
+		}
+		checkSquares[QUEEN] = checkSquares[ROOK] | checkSquares[BISHOP];
 
-				addPawnCaptures(moves, pieceList, mailbox, fromSquare, forwardOffset,  1, sideToMove, squareBeforePromotion);
-				addPawnCaptures(moves, pieceList, mailbox, fromSquare, forwardOffset, -1, sideToMove, squareBeforePromotion);
+		int epSquare = -1;
+		for (int i = 0; i < pieceList.nPieces[Side ^ WHITE]; i++) {
+			int square = pieceList.pieces[Side ^ WHITE][i];
+			if (mailbox[square].getType() == PAWN && mailbox[square].canBeCapturedEP())
+				epSquare = square;
+		}
+
+		int (&piecePositions)[16] = pieceList.pieces[Side];
+		int nPieces = pieceList.nPieces[Side];
+		for (int i = 0; i < nPieces; i++) {
+			int fromSquare = piecePositions[i];
+			int type = mailbox[fromSquare].getType();
+			bool discovers = discoveredCheckers & (1ULL << fromSquare);
+			uint64_t targets = discovers ? ~0ULL : checkSquares[type];
+			switch (type) {
+			case PAWN:
+				if (fromSquare / 8 == rowBeforePromotion) targets = ~0ULL;
+				addPawnMoves<Side, GEN_ALL>(mailbox, moves, fromSquare, targets, epSquare);
+				break;
+			case KNIGHT: addPieceMoves<Side, GEN_ALL, KNIGHT>(mailbox, moves, fromSquare, targets); break;
+			case BISHOP: addPieceMoves<Side, GEN_ALL, BISHOP>(mailbox, moves, fromSquare, targets); break;
+			case ROOK: addPieceMoves<Side, GEN_ALL, ROOK>(mailbox, moves, fromSquare, targets); break;
+			case QUEEN: addPieceMoves<Side, GEN_ALL, QUEEN>(mailbox, moves, fromSquare, targets); break;
+			case KING:
+				if (discovers)
+					addPieceMoves<Side, GEN_ALL, KING>(mailbox, moves, fromSquare, targets);
+				addCastlingMoves<Side>(mailbox, moves, fromSquare);
+				break;
 			}
 		}
 	}
 
-	bool squareIsAttacked(int square, Mailbox& mailbox, int color) {
-		for (int piece = KNIGHT; piece <= KING; piece++) {
-			for (int i = 0; i < pieceOffsets[piece - 1]; i++) {
-				for (int toSquare = square;;) {
-					toSquare = mailbox.getSquareWithOffset(toSquare, pieceOffset[piece - 1][i]);
-					if (toSquare == -1)
-						break;
+	template<int Side, int GenType, int Type>
+	void addPieceMoves(Mailbox& mailbox, ChessMoves& moves, int fromSquare, uint64_t targets) {
+		constexpr bool captures = GenType != GEN_QUIETS;
+		constexpr bool quiets = GenType != GEN_CAPTURES;
+		if constexpr (Type == KING) targets = ~0ULL; // The king escapes by moving, legality is checked later
 
-					Piece& attackingPiece = mailbox[toSquare];
-					if (attackingPiece.getType() != EMPTY) {
-						if (attackingPiece.getColor() != color && attackingPiece.getType() == piece)
-							return true;
+		if constexpr (Type == KNIGHT) {
+			for (int i = 0; i < moveTables.nKnightJumps[fromSquare]; i++)
+				addPieceMove<Side, captures, quiets>(mailbox, moves, fromSquare, moveTables.knightJumps[fromSquare][i], targets);
+		}
+		else {
+			for (int dir = rayStart[Type]; dir < rayEnd[Type]; dir++) {
+				for (int toSquare = moveTables.raySteps[fromSquare][dir]; toSquare != -1; toSquare = moveTables.raySteps[toSquare][dir]) {
+					if (!addPieceMove<Side, captures, quiets>(mailbox, moves, fromSquare, toSquare, targets))
 						break;
-					}
-					if (!slidingPiece[piece - 1])
+					if constexpr (!slidingPiece[Type])
 						break;
 				}
 			}
 		}
-		int opposingPawnOffset;
-		if (color == WHITE) opposingPawnOffset = -10;
-		else opposingPawnOffset = 10;
-		Piece& possibleOppPawn1 = mailbox[mailbox.getSquareWithOffset(square, opposingPawnOffset + 1)];
-		Piece& possibleOppPawn2 = mailbox[mailbox.getSquareWithOffset(square, opposingPawnOffset - 1)];
-		if (possibleOppPawn1.getType() == PAWN && possibleOppPawn1.getColor() != color) return true;
-		if (possibleOppPawn2.getType() == PAWN && possibleOppPawn2.getColor() != color) return true;
-		
-		return false;
 	}
 
+	// Returns false if the square is occupied and the ray stops there
+	template<int Side, bool Captures, bool Quiets>
+	bool addPieceMove(Mailbox& mailbox, ChessMoves& moves, int fromSquare, int toSquare, uint64_t targets) {
+		Piece capturedPiece = mailbox[toSquare];
+		bool onTarget = targets & (1ULL << toSquare);
+		if (capturedPiece.getType() != EMPTY) {
+			if (Captures && onTarget && capturedPiece.getColor() != Side)
+				moves.addMove(fromSquare, toSquare, CAPTURE);
+			return false;
+		}
+		if (Quiets && onTarget)
+			moves.addMove(fromSquare, toSquare, QUIET_MOVE);
+		return true;
+	}
 
-private:
+	template<int Side>
+	void addCastlingMoves(Mailbox& mailbox, ChessMoves& moves, int fromSquare) {
+		constexpr int row = Side == WHITE ? 7 : 0;
+		if (mailbox[fromSquare].hasMoved())
+			return;
 
-	void addPawnCaptures(ChessMoves& moves, PieceList& pieceList, Mailbox& mailbox, 
-		int fromSquare, int forwardOffset, int sideOffset, int sideToMove, bool squareBeforePromotion) {
+		Piece queenRook = mailbox[row * 8];
+		Piece kingRook = mailbox[row * 8 + 7];
+		if (queenRook.getType() == ROOK && !queenRook.hasMoved() && mailbox[row * 8 + 1].getType() == EMPTY &&
+			mailbox[row * 8 + 2].getType() == EMPTY && mailbox[row * 8 + 3].getType() == EMPTY)
+			moves.addMove(fromSquare, row * 8 + 2, QUEEN_CASTLE);
+		if (kingRook.getType() == ROOK && !kingRook.hasMoved() && mailbox[row * 8 + 5].getType() == EMPTY &&
+			mailbox[row * 8 + 6].getType() == EMPTY)
+			moves.addMove(fromSquare, row * 8 + 6, KING_CASTLE);
+	}
 
-		forwardOffset < 0 ? forwardOffset -= 2 : forwardOffset += 2; //Because mailbox120 has different offsets
-		int sideSquare = mailbox.getSquareWithOffset(fromSquare, sideOffset);
-		if (sideSquare != -1 && mailbox[sideSquare].getType() == PAWN && mailbox[sideSquare].canBeCapturedEP()) {
-			moves.addMove(fromSquare, mailbox.getSquareWithOffset(sideSquare, forwardOffset), EP_CAPTURE);
+	template<int Side, int GenType>
+	void addPawnMoves(Mailbox& mailbox, ChessMoves& moves, int fromSquare, uint64_t targets, int checkerSquare) {
+		constexpr bool captures = GenType != GEN_QUIETS;
+		constexpr bool quiets = GenType != GEN_CAPTURES;
+		constexpr int forwardOffset = Side == WHITE ? -8 : 8;
+		constexpr int rowBeforePromotion = Side == WHITE ? 1 : 6;
+		constexpr int startingRow = Side == WHITE ? 6 : 1;
+
+		int row = fromSquare / 8;
+		int toSquare = fromSquare + forwardOffset;
+		if (mailbox[toSquare].getType() == EMPTY) {
+			if (row == rowBeforePromotion) {
+				if (captures && (targets & (1ULL << toSquare)))
+					addPromotions(moves, fromSquare, toSquare, KNIGHT_PROMOTION);
+			}
+			else if (quiets) {
+				if (targets & (1ULL << toSquare))
+					moves.addMove(fromSquare, toSquare, QUIET_MOVE);
+				int doubleSquare = toSquare + forwardOffset;
+				if (row == startingRow && mailbox[doubleSquare].getType() == EMPTY && (targets & (1ULL << doubleSquare)))
+					moves.addMove(fromSquare, doubleSquare, DOUBLE_PAWN_PUSH);
+			}
 		}
-		else {
-			int diagonalSquare = mailbox.getSquareWithOffset(fromSquare, forwardOffset + sideOffset);
-			if (diagonalSquare != -1) {
-				Piece& capturePiece = mailbox[diagonalSquare];
-				if (capturePiece.getType() != EMPTY && capturePiece.getColor() != sideToMove) {
-					if (squareBeforePromotion) {
-						moves.addMove(fromSquare, diagonalSquare, KNIGHT_PROMOTION_CAP);
-						moves.addMove(fromSquare, diagonalSquare, BISHOP_PROMOTION_CAP);
-						moves.addMove(fromSquare, diagonalSquare, ROOK_PROMOTION_CAP);
-						moves.addMove(fromSquare, diagonalSquare, QUEEN_PROMOTION_CAP);
+
+		if constexpr (captures) {
+			for (int i = 0; i < 2; i++) {
+				int diagonalSquare = moveTables.pawnCaptures[Side][fromSquare][i];
+				if (diagonalSquare == -1)
+					continue;
+				Piece capturedPiece = mailbox[diagonalSquare];
+				if (capturedPiece.getType() != EMPTY) {
+					if (capturedPiece.getColor() != Side && (targets & (1ULL << diagonalSquare))) {
+						if (row == rowBeforePromotion) addPromotions(moves, fromSquare, diagonalSquare, KNIGHT_PROMOTION_CAP);
+						else moves.addMove(fromSquare, diagonalSquare, CAPTURE);
 					}
-					else
-						moves.addMove(fromSquare, diagonalSquare, CAPTURE);
+					continue;
+				}
+				int sideSquare = diagonalSquare - forwardOffset;
+				Piece sidePiece = mailbox[sideSquare];
+				if (sidePiece.getType() == PAWN && sidePiece.getColor() != Side && sidePiece.canBeCapturedEP() &&
+					((targets & (1ULL << diagonalSquare)) || sideSquare == checkerSquare))
+					moves.addMove(fromSquare, diagonalSquare, EP_CAPTURE);
+			}
+		}
+	}
+
+	void addPromotions(ChessMoves& moves, int fromSquare, int toSquare, int firstPromotion) {
+		for (int promotion = 0; promotion < 4; promotion++)
+			moves.addMove(fromSquare, toSquare, firstPromotion + promotion);
+	}
+
+	// Counts the pieces giving check and sets the squares a single check can be answered on
+	template<int Side>
+	int getCheckers(Mailbox& mailbox, int kingSquare, uint64_t& targets, int& checkerSquare) {
+		int nCheckers = 0;
+		targets = 0;
+		for (int i = 0; i < moveTables.nKnightJumps[kingSquare]; i++) {
+			int square = moveTables.knightJumps[kingSquare][i];
+			if (mailbox[square].getType() == KNIGHT && mailbox[square].getColor() != Side) {
+				nCheckers++;
+				checkerSquare = square;
+				targets |= 1ULL << square;
+			}
+		}
+		for (int i = 0; i < 2; i++) {
+			int square = moveTables.pawnCaptures[Side][kingSquare][i];
+			if (square != -1 && mailbox[square].getType() == PAWN && mailbox[square].getColor() != Side) {
+				nCheckers++;
+				checkerSquare = square;
+				targets |= 1ULL << square;
+			}
+		}
+		for (int dir = 0; dir < 8; dir++) {
+			int diagonalSlider = dir >= NORTH_EAST ? BISHOP : ROOK;
+			for (int square = moveTables.raySteps[kingSquare][dir]; square != -1; square = moveTables.raySteps[square][dir]) {
+				Piece piece = mailbox[square];
+				if (piece.getType() == EMPTY)
+					continue;
+				if (piece.getColor() != Side && (piece.getType() == diagonalSlider || piece.getType() == QUEEN)) {
+					nCheckers++;
+					checkerSquare = square;
+					targets |= (1ULL << square) | moveTables.betweenSquares[kingSquare][square];
 				}
+				break;
 			}
 		}
+		return nCheckers;
 	}
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,163 @@
+#ifndef NOTATION_H
+#define NOTATION_H
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "index_model/board.h"
+#include "index_model/move.h"
+#include "index_model/piece.h"
+
+inline std::string getSquareName(int square) {
+	return { (char)('a' + square % 8), (char)('1' + 7 - square / 8) };
+}
+
+// Standard algebraic notation of a legal move in the current position of the board
+inline std::string getMoveSAN(ChessBoardIndex& board, Move move) {
+	const char pieceLetters[7] = { ' ', ' ', 'N', 'B', 'R', 'Q', 'K' };
+	std::string san;
+
+	if (move.isKingCastle()) san = "O-O";
+	else if (move.isQueenCastle()) san = "O-O-O";
+	else {
+		int type = board.mailbox[move.getFrom()].getType();
+		if (type == PAWN) {
+			if (move.isCapture()) san += (char)('a' + move.getFrom() % 8);
+		}
+		else {
+			san += pieceLetters[type];
+
+			ChessMoves moves;
+			board.generateLegalMoves(moves);
+			bool ambiguous = false, sameColumn = false, sameRow = false;
+			for (int i = 0; i < moves.nMoves; i++) {
+				Move other = moves[i];
+				if (other.getTo() != move.getTo() || other.getFrom() == move.getFrom() ||
+					board.mailbox[other.getFrom()].getType() != type)
+					continue;
+				ambiguous = true;
+				if (other.getFrom() % 8 == move.getFrom() % 8) sameColumn = true;
+				if (other.getFrom() / 8 == move.getFrom() / 8) sameRow = true;
+			}
+			if (ambiguous) {
+				if (!sameColumn) san += (char)('a' + move.getFrom() % 8);
+				else if (!sameRow) san += (char)('1' + 7 - move.getFrom() / 8);
+				else san += getSquareName(move.getFrom());
+			}
+		}
+		if (move.isCapture()) san += 'x';
+		san += getSquareName(move.getTo());
+		if (move.isPromotion()) {
+			san += '=';
+			san += pieceLetters[KNIGHT + (move.getFlags() & 0x3)];
+		}
+	}
+
+	MadeMove madeMove = board.getMadeMove(move);
+	board.makeMove(move, false, false, false);
+	if (board.inCheck()) {
+		ChessMoves replies;
+		board.generateLegalMoves(replies);
+		san += replies.nMoves == 0 ? '#' : '+';
+	}
+	board.unmakeMove(madeMove);
+	return san;
+}
+
+// The moves of a line played from the current position, separated by spaces. The board is left unchanged
+inline std::string getLineSAN(ChessBoardIndex& board, const std::vector<Move>& line) {
+	std::string text;
+	std::vector<MadeMove> madeMoves;
+	for (Move move : line) {
+		if (!text.empty()) text += ' ';
+		text += getMoveSAN(board, move);
+		madeMoves.push_back(board.getMadeMove(move));
+		board.makeMove(move, false, false, false);
+	}
+	for (int i = (int)madeMoves.size() - 1; i >= 0; i--)
+		board.unmakeMove(madeMoves[i]);
+	return text;
+}
+
+// Coordinate notation used by UCI, e2e4 or e7e8q
+inline std::string getMoveUCI(Move move) {
+	const char promotionLetters[4] = { 'n', 'b', 'r', 'q' };
+	std::string uci = getSquareName(move.getFrom()) + getSquareName(move.getTo());
+	if (move.isPromotion()) uci += promotionLetters[move.getFlags() & 0x3];
+	return uci;
+}
+
+// Finds the legal move matching coordinate notation, an empty move if there is none
+inline Move parseMoveUCI(ChessBoardIndex& board, const std::string& uci) {
+	const std::string promotionLetters = "nbrq";
+	if (uci.size() < 4 || uci.size() > 5 || uci[0] < 'a' || uci[0] > 'h' || uci[2] < 'a' || uci[2] > 'h' ||
+		uci[1] < '1' || uci[1] > '8' || uci[3] < '1' || uci[3] > '8')
+		return Move();
+	int from = ('8' - uci[1]) * 8 + (uci[0] - 'a');
+	int to = ('8' - uci[3]) * 8 + (uci[2] - 'a');
+	size_t promotion = uci.size() == 5 ? promotionLetters.find(uci[4]) : 0;
+	if (promotion == std::string::npos) return Move();
+
+	Move move = board.getMove(from, to, (int)promotion);
+	if (move.isPromotion() != (uci.size() == 5)) return Move();
+	return move;
+}
+
+// Finds the legal move matching standard algebraic notation, an empty move if there is none or the text is
+// ambiguous. Check and annotation symbols are ignored, castling may be written with zeros
+inline Move parseMoveSAN(ChessBoardIndex& board, const std::string& san) {
+	const std::string pieceLetters = "  NBRQK";
+	std::string text = san;
+	while (!text.empty() && std::string("+#!?").find(text.back()) != std::string::npos)
+		text.pop_back();
+
+	ChessMoves moves;
+	board.generateLegalMoves(moves);
+	if (text == "O-O" || text == "0-0" || text == "O-O-O" || text == "0-0-0") {
+		bool kingSide = text.size() == 3;
+		for (int i = 0; i < moves.nMoves; i++)
+			if (kingSide ? moves[i].isKingCastle() : moves[i].isQueenCastle())
+				return moves[i];
+		return Move();
+	}
+
+	int promotion = -1;
+	size_t equals = text.find('=');
+	if (equals != std::string::npos || (text.size() > 2 && std::string("NBRQ").find(text.back()) != std::string::npos)) {
+		size_t letter = pieceLetters.find(text.back());
+		if (letter == std::string::npos || letter < KNIGHT || letter > QUEEN) return Move();
+		promotion = (int)letter - KNIGHT;
+		text.erase(equals != std::string::npos ? equals : text.size() - 1);
+	}
+
+	int type = PAWN;
+	if (!text.empty() && pieceLetters.find(text[0]) != std::string::npos && text[0] != ' ') {
+		type = (int)pieceLetters.find(text[0]);
+		text.erase(0, 1);
+	}
+	text.erase(std::remove(text.begin(), text.end(), 'x'), text.end());
+	if (text.size() < 2 || text.size() > 4) return Move();
+	char file = text[text.size() - 2], rank = text[text.size() - 1];
+	if (file < 'a' || file > 'h' || rank < '1' || rank > '8') return Move();
+	int to = ('8' - rank) * 8 + (file - 'a');
+	int fromFile = -1, fromRank = -1;
+	for (size_t i = 0; i + 2 < text.size(); i++) {
+		if (text[i] >= 'a' && text[i] <= 'h') fromFile = text[i] - 'a';
+		else if (text[i] >= '1' && text[i] <= '8') fromRank = '8' - text[i];
+		else return Move();
+	}
+
+	Move found;
+	for (int i = 0; i < moves.nMoves; i++) {
+		Move move = moves[i];
+		if (move.getTo() != to || move.isCastle() || board.mailbox[move.getFrom()].getType() != type) continue;
+		if ((fromFile != -1 && move.getFrom() % 8 != fromFile) || (fromRank != -1 && move.getFrom() / 8 != fromRank)) continue;
+		if (move.isPromotion() != (promotion != -1) || (promotion != -1 && (move.getFlags() & 0x3) != promotion)) continue;
+		if (found != Move()) return Move();
+		found = move;
+	}
+	return found;
+}
+
+#endif
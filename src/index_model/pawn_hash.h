@@ -0,0 +1,49 @@
+#ifndef PAWN_HASH_H
+#define PAWN_HASH_H
+
+#include <cstdint>
+#include <vector>
+
+const int PAWN_HASH_ENTRIES = 1 << 16;
+
+struct PawnHashEntry {
+	uint64_t key = 0;
+	int score = 0;                          // Pawn structure from white
+	int shelter[2] = { 0, 0 };              // King shelter of each side, valid for shelterKingSquare
+	int shelterKingSquare[2] = { -1, -1 };
+};
+
+// Caches the pawn structure evaluation by the pawn key of the board, one table per evaluator
+class PawnHashTable {
+
+	std::vector<PawnHashEntry> entries;
+
+public:
+	long long probes = 0;
+	long long hits = 0;
+
+	PawnHashTable() : entries(PAWN_HASH_ENTRIES) {}
+
+	PawnHashEntry& probe(uint64_t key, bool& found) {
+		PawnHashEntry& entry = entries[key & (PAWN_HASH_ENTRIES - 1)];
+		probes++;
+		found = entry.key == key;
+		if (found) hits++;
+		return entry;
+	}
+
+	void clear() {
+		for (PawnHashEntry& entry : entries)
+			entry = PawnHashEntry();
+		resetStatistics();
+	}
+
+	void resetStatistics() {
+		probes = 0;
+		hits = 0;
+	}
+
+	double getHitRate() { return probes == 0 ? 0.0 : (double)hits / probes; }
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef PERFT_H
+#define PERFT_H
+
+#include "index_model/board.h"
+#include "index_model/move.h"
+
+struct PerftPosition {
+	const char* state;
+	int depth;
+	long long nodes;
+};
+
+// Reference positions with known node counts, see https://www.chessprogramming.org/Perft_Results
+const PerftPosition perftPositions[] = {
+	{ "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, 4865609 },
+	{ "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603 },
+	{ "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624 },
+	{ "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, 422333 },
+	{ "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, 2103487 },
+	{ "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594 }
+};
+
+inline long long perft(ChessBoardIndex& board, int depth) {
+	ChessMoves moves;
+	board.generateLegalMoves(moves);
+	if (depth <= 1)
+		return depth == 1 ? moves.nMoves : 1;
+
+	long long nodes = 0;
+	for (int i = 0; i < moves.nMoves; i++) {
+		MadeMove madeMove = board.getMadeMove(moves[i]);
+		board.makeMove(moves[i], false, false, false);
+		nodes += perft(board, depth - 1);
+		board.unmakeMove(madeMove);
+	}
+	return nodes;
+}
+
+#endif
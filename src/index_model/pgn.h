@@ -0,0 +1,222 @@
+#ifndef PGN_H
+#define PGN_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <istream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "index_model/board.h"
+#include "index_model/epd.h"
+#include "index_model/move.h"
+#include "index_model/notation.h"
+
+#define GAME_RESULT_UNKNOWN 0
+#define GAME_RESULT_WHITE_WINS 1
+#define GAME_RESULT_BLACK_WINS 2
+#define GAME_RESULT_DRAW 3
+
+const std::string PGN_START_POSITION = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+inline const char* getResultText(int result) {
+	const char* texts[4] = { "*", "1-0", "0-1", "1/2-1/2" };
+	return result >= 0 && result < 4 ? texts[result] : "*";
+}
+
+inline int parseResultText(const std::string& text) {
+	if (text == "1-0") return GAME_RESULT_WHITE_WINS;
+	if (text == "0-1") return GAME_RESULT_BLACK_WINS;
+	if (text == "1/2-1/2") return GAME_RESULT_DRAW;
+	return GAME_RESULT_UNKNOWN;
+}
+
+// A game as stored in PGN or the binary game file of game_record.h: its tags in file order, the position
+// it starts from and the moves of the main line. Comments and variations are not kept
+struct GameRecord {
+	std::vector<std::pair<std::string, std::string>> tags;
+	std::string initialState = PGN_START_POSITION;
+	std::vector<Move> moves;
+	int result = GAME_RESULT_UNKNOWN;
+
+	std::string getTag(const std::string& name, const std::string& fallback = "") const {
+		for (const auto& tag : tags)
+			if (tag.first == name) return tag.second;
+		return fallback;
+	}
+
+	void clear() {
+		tags.clear();
+		initialState = PGN_START_POSITION;
+		moves.clear();
+		result = GAME_RESULT_UNKNOWN;
+	}
+};
+
+// Reads the games of a PGN stream one at a time. Moves are replayed on a board to resolve their
+// notation, a game with a move that is not legal is read up to that move and reported as malformed
+class PGNReader {
+
+	std::istream& input;
+	ChessBoardIndex board;
+	std::string line;
+	bool hasLine = false;
+
+	bool nextLine() {
+		if (hasLine) {
+			hasLine = false;
+			return true;
+		}
+		return (bool)std::getline(input, line);
+	}
+
+	void parseTag(GameRecord& game) {
+		size_t nameStart = line.find_first_not_of(" \t[");
+		size_t nameEnd = line.find_first_of(" \t", nameStart);
+		size_t valueStart = line.find('"', nameEnd);
+		size_t valueEnd = line.rfind('"');
+		if (nameStart == std::string::npos || nameEnd == std::string::npos || valueStart == std::string::npos || valueEnd <= valueStart)
+			return;
+		std::string value;
+		for (size_t i = valueStart + 1; i < valueEnd; i++) {
+			if (line[i] == '\\' && i + 1 < valueEnd) i++;
+			value += line[i];
+		}
+		game.tags.emplace_back(line.substr(nameStart, nameEnd - nameStart), value);
+	}
+
+	// Returns false once the game's result token was read
+	bool parseMovetext(GameRecord& game, int& commentDepth, int& variationDepth) {
+		size_t i = 0;
+		while (i < line.size()) {
+			char c = line[i];
+			if (commentDepth > 0) {
+				if (c == '}') commentDepth = 0;
+				i++;
+				continue;
+			}
+			if (c == '{') {
+				commentDepth = 1;
+				i++;
+				continue;
+			}
+			if (c == ';') break; // Comment to the end of the line
+			if (c == '(') variationDepth++;
+			if (c == ')' && variationDepth > 0) variationDepth--;
+			if (std::isspace((unsigned char)c) || c == '(' || c == ')') {
+				i++;
+				continue;
+			}
+
+			size_t end = i;
+			while (end < line.size() && !std::isspace((unsigned char)line[end]) && std::string("{}();").find(line[end]) == std::string::npos)
+				end++;
+			std::string token = line.substr(i, end - i);
+			i = end;
+			if (variationDepth > 0 || token[0] == '$') continue;
+			if (token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*") {
+				game.result = parseResultText(token);
+				return false;
+			}
+			size_t dots = token.find_last_of('.');
+			if (dots != std::string::npos) token.erase(0, dots + 1); // Move numbers, possibly glued to the move
+			if (token.empty() || malformed) continue;
+
+			Move move = parseMoveSAN(board, token);
+			if (move == Move()) {
+				malformed = true;
+				continue;
+			}
+			board.makeMove(move, false, false, false);
+			game.moves.push_back(move);
+		}
+		return true;
+	}
+
+public:
+	bool malformed = false; // The last game had a move that could not be read
+
+	PGNReader(std::istream& input) : input(input) {}
+
+	bool next(GameRecord& game) {
+		game.clear();
+		malformed = false;
+		bool inGame = false, inMovetext = false;
+		int commentDepth = 0, variationDepth = 0;
+		while (nextLine()) {
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			size_t start = line.find_first_not_of(" \t");
+			if (start == std::string::npos || line[0] == '%')
+				continue;
+			if (line[start] == '[' && commentDepth == 0) {
+				if (inMovetext) { // A game without a result token ended
+					hasLine = true;
+					return true;
+				}
+				parseTag(game);
+				inGame = true;
+				continue;
+			}
+			if (!inMovetext) {
+				EPDRecord position; // FEN tags without clocks are common
+				if (parseEPD(game.getTag("FEN", PGN_START_POSITION), position)) game.initialState = position.state;
+				board.changeBoardState(game.initialState);
+				inMovetext = inGame = true;
+			}
+			if (!parseMovetext(game, commentDepth, variationDepth))
+				return true;
+		}
+		return inGame;
+	}
+};
+
+inline std::string escapeTagValue(const std::string& value) {
+	std::string escaped;
+	for (char c : value) {
+		if (c == '"' || c == '\\') escaped += '\\';
+		escaped += c;
+	}
+	return escaped;
+}
+
+// Export format: the tags, then the moves with their numbers wrapped at 80 columns
+inline std::string getGamePGN(const GameRecord& game) {
+	std::string pgn;
+	for (const auto& tag : game.tags)
+		pgn += "[" + tag.first + " \"" + escapeTagValue(tag.second) + "\"]\n";
+	if (game.initialState != PGN_START_POSITION && game.getTag("FEN").empty())
+		pgn += "[SetUp \"1\"]\n[FEN \"" + game.initialState + "\"]\n";
+	pgn += "\n";
+
+	ChessBoardIndex board;
+	board.changeBoardState(game.initialState);
+	std::string lineText;
+	int moveNumber = 1;
+	std::istringstream fields(game.initialState);
+	std::string field;
+	for (int i = 0; i < 6 && fields >> field; i++)
+		if (i == 5) moveNumber = std::max(1, std::atoi(field.c_str()));
+
+	auto addToken = [&](const std::string& token) {
+		if (!lineText.empty() && lineText.size() + 1 + token.size() > 79) {
+			pgn += lineText + "\n";
+			lineText.clear();
+		}
+		lineText += (lineText.empty() ? "" : " ") + token;
+	};
+	for (size_t i = 0; i < game.moves.size(); i++) {
+		if (board.sideToMove == WHITE) addToken(std::to_string(moveNumber) + ".");
+		else if (i == 0) addToken(std::to_string(moveNumber) + "...");
+		addToken(getMoveSAN(board, game.moves[i]));
+		if (board.sideToMove == BLACK) moveNumber++;
+		board.makeMove(game.moves[i], false, false, false);
+	}
+	addToken(getResultText(game.result));
+	pgn += lineText + "\n\n";
+	return pgn;
+}
+
+#endif
@@ -0,0 +1,572 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "index_model/analysis_cache.h"
+#include "index_model/board.h"
+#include "index_model/evaluation.h"
+#include "index_model/search_stats.h"
+#include "index_model/transposition.h"
+#include "index_model/move.h"
+
+#define MATE_SCORE 30000
+#define INFINITE_SCORE 32000
+#define MAX_SEARCH_PLY 64
+
+const int LIMIT_CHECK_INTERVAL = 1024; // Nodes between checks of the node and time limits, a power of two
+
+// Selective search, margins in centipawns per ply of remaining depth
+const int NULL_MOVE_MIN_DEPTH = 3;
+const int NULL_MOVE_DEEP_DEPTH = 7;         // From this depth the null move is reduced by 3 plies instead of 2
+const int REVERSE_FUTILITY_MAX_DEPTH = 6;
+const int REVERSE_FUTILITY_MARGIN = 80;
+const int FUTILITY_MAX_DEPTH = 3;
+const int FUTILITY_MARGIN = 120;
+const int RAZORING_MAX_DEPTH = 2;
+const int RAZORING_MARGIN = 250;
+const int LATE_MOVE_PRUNING_MAX_DEPTH = 3;
+const int LATE_MOVE_REDUCTION_MIN_DEPTH = 3;
+const int LATE_MOVE_REDUCTION_MIN_MOVES = 3; // Moves searched at full depth before reductions start
+const int ASPIRATION_MIN_DEPTH = 4;
+const int ASPIRATION_WINDOW = 50;            // Half width of the first window, doubled on every fail high or low
+const int ASPIRATION_MAX_WINDOW = 1000;      // Wider windows are opened all the way
+
+struct SearchResult {
+	Move bestMove;
+	int score = 0; // From the side to move
+	int depth = 0;
+	long long nodes = 0;
+	double pawnHashHitRate = 0.0;
+	std::vector<Move> principalVariation; // Starts with bestMove
+};
+
+// A search stops at whichever limit comes first, 0 turns the node and time limits off
+struct SearchLimits {
+	int depth = MAX_SEARCH_PLY - 1;
+	long long nodes = 0;
+	double milliseconds = 0.0;
+};
+
+// Which search techniques the searcher uses, all of them by default. Each can be switched off to measure
+// what it does to time to depth and playing strength, all of them off is plain alpha-beta
+struct SearchOptions {
+	bool principalVariationSearch = true;
+	bool aspirationWindows = true;
+	bool nullMove = true;
+	bool lateMoveReductions = true;
+	bool reverseFutility = true;
+	bool futility = true;
+	bool razoring = true;
+	bool lateMovePruning = true;
+};
+
+const char* const SEARCH_OPTION_NAMES[] = { "PVS", "AspirationWindows", "NullMove", "LateMoveReductions", "ReverseFutility", "Futility", "Razoring", "LateMovePruning" };
+
+// The switch of a technique by its UCI option name, nullptr for other names
+inline bool* getSearchOption(SearchOptions& options, const std::string& name) {
+	bool* switches[] = { &options.principalVariationSearch, &options.aspirationWindows, &options.nullMove, &options.lateMoveReductions, &options.reverseFutility, &options.futility, &options.razoring,
+		&options.lateMovePruning };
+	for (int i = 0; i < (int)(sizeof(switches) / sizeof(switches[0])); i++)
+		if (name == SEARCH_OPTION_NAMES[i]) return switches[i];
+	return nullptr;
+}
+
+inline bool isMateScore(int score) { return score > MATE_SCORE - MAX_SEARCH_PLY || score < -MATE_SCORE + MAX_SEARCH_PLY; }
+
+class Searcher {
+
+	ChessBoardIndex board;
+	TranspositionTable& transpositionTable;
+	AnalysisCache* analysisCache = nullptr;
+	Evaluator evaluator;
+
+	ChessMoves moveLists[MAX_SEARCH_PLY];
+	int moveScores[MAX_SEARCH_PLY][MAX_AVAILABLE_MOVES];
+	Move killerMoves[MAX_SEARCH_PLY][2];
+	int lateMoveReductions[MAX_SEARCH_PLY][64]; // By depth and move number
+	Move pvTable[MAX_SEARCH_PLY][MAX_SEARCH_PLY]; // Triangular, the best line found from each ply of the current path
+	int pvLength[MAX_SEARCH_PLY];
+	SearchOptions options;
+	std::vector<uint64_t> keyHistory;
+	int nKeys = 0;
+
+	Move rootBestMove;
+	SearchStatistics statistics;
+	long long nodeLimit = 0;
+	bool hasDeadline = false;
+	std::chrono::steady_clock::time_point deadline;
+	bool stopped = false; // A limit was reached, the iteration it happened in is thrown away
+	std::function<void(const SearchResult&, const SearchStatistics&)> iterationCallback;
+
+public:
+
+	Searcher(TranspositionTable& transpositionTable) : transpositionTable(transpositionTable) {
+		for (int depth = 0; depth < MAX_SEARCH_PLY; depth++)
+			for (int move = 0; move < 64; move++)
+				lateMoveReductions[depth][move] = depth == 0 || move == 0 ? 0 : (int)(0.75 + std::log(depth) * std::log(move) / 2.25);
+	}
+
+	ChessBoardIndex& getBoard() { return board; }
+	Evaluator& getEvaluator() { return evaluator; }
+	const SearchStatistics& getStatistics() { return statistics; }
+	const SearchOptions& getOptions() { return options; }
+	void setOptions(const SearchOptions& searchOptions) { options = searchOptions; }
+
+	// Called after every completed iteration, used for UCI info output
+	void setIterationCallback(std::function<void(const SearchResult&, const SearchStatistics&)> callback) {
+		iterationCallback = callback;
+	}
+
+	// Results deep enough for the cache are read from and written to it as well as the transposition table
+	void setAnalysisCache(AnalysisCache* cache) { analysisCache = cache; }
+
+	void setPosition(const std::string& state, const std::vector<Move>& moves, int nMoves) {
+		board.changeBoardState(state);
+		keyHistory.resize(nMoves + MAX_SEARCH_PLY + 1);
+		nKeys = 0;
+		keyHistory[nKeys++] = board.getHashKey();
+		for (int i = 0; i < nMoves; i++) {
+			board.makeMove(moves[i], false, false, false);
+			keyHistory[nKeys++] = board.getHashKey();
+		}
+	}
+
+	SearchResult search(int maxDepth) {
+		SearchLimits limits;
+		limits.depth = maxDepth;
+		return search(limits);
+	}
+
+	SearchResult search(const SearchLimits& limits) {
+		SearchResult result;
+		int maxDepth = std::min(limits.depth, MAX_SEARCH_PLY - 1);
+		nodeLimit = limits.nodes;
+		hasDeadline = limits.milliseconds > 0.0;
+		deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<double, std::milli>(limits.milliseconds));
+		stopped = false;
+		statistics.reset();
+		evaluator.getPawnHashTable().resetStatistics();
+		for (int i = 0; i < MAX_SEARCH_PLY; i++) {
+			killerMoves[i][0] = Move();
+			killerMoves[i][1] = Move();
+		}
+
+		if (getCachedResult(limits, maxDepth, result))
+			return result;
+
+		for (int depth = 1; depth <= maxDepth; depth++) {
+			rootBestMove = Move();
+			long long iterationStartNodes = statistics.nodes;
+			auto iterationStart = std::chrono::steady_clock::now();
+			int score = searchRoot(depth, result.score);
+			double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - iterationStart).count();
+			if (stopped) {
+				statistics.milliseconds += milliseconds;
+				result.nodes = statistics.nodes;
+				if (result.depth == 0) {
+					result.bestMove = rootBestMove != Move() ? rootBestMove : getFirstLegalMove();
+					result.principalVariation.assign(result.bestMove != Move() ? 1 : 0, result.bestMove);
+				}
+				break;
+			}
+
+			if (statistics.nIterations < MAX_STATS_ITERATIONS) {
+				statistics.iterationNodes[statistics.nIterations] = statistics.nodes - iterationStartNodes;
+				statistics.iterationMilliseconds[statistics.nIterations] = milliseconds;
+				statistics.nIterations++;
+			}
+			statistics.milliseconds += milliseconds;
+			result.score = score;
+			result.depth = depth;
+			result.bestMove = rootBestMove;
+			result.nodes = statistics.nodes;
+			result.principalVariation.assign(pvTable[0], pvTable[0] + pvLength[0]);
+			if (result.principalVariation.empty() && rootBestMove != Move()) result.principalVariation.push_back(rootBestMove);
+			if (iterationCallback) iterationCallback(result, statistics);
+			if (isMateScore(score)) break;
+		}
+		result.pawnHashHitRate = evaluator.getPawnHashTable().getHitRate();
+		if (analysisCache) analysisCache->flush();
+		return result;
+	}
+
+	// Follows the best moves stored in the transposition table, or the analysis cache, from the searched position, up to the first
+	// one that is missing, illegal or returns to a position of the line. The board is left unchanged
+	std::vector<Move> getPrincipalVariation(Move bestMove, int maxLength) {
+		std::vector<Move> line;
+		std::vector<MadeMove> madeMoves;
+		std::vector<uint64_t> keys(1, board.getHashKey());
+		Move move = bestMove;
+		while (move != Move() && (int)line.size() < maxLength) {
+			if (board.getMove(move.getFrom(), move.getTo(), move.getFlags() & 0x3) != move) break;
+			madeMoves.push_back(board.getMadeMove(move));
+			board.makeMove(move, false, false, false);
+			line.push_back(move);
+			uint64_t key = board.getHashKey();
+			if (std::find(keys.begin(), keys.end(), key) != keys.end()) break;
+			keys.push_back(key);
+
+			TTEntry entry;
+			bool found = transpositionTable.probe(key, entry) || (analysisCache && analysisCache->probe(key, entry));
+			move = found ? entry.move : Move();
+		}
+		for (int i = (int)madeMoves.size() - 1; i >= 0; i--)
+			board.unmakeMove(madeMoves[i]);
+		return line;
+	}
+
+	// Captures and promotions of the set position searched out with a full window. Far from the static
+	// evaluation when the position is in the middle of an exchange
+	int getQuiescenceScore() {
+		nodeLimit = 0;
+		hasDeadline = false;
+		stopped = false;
+		return quiescence(0, -INFINITE_SCORE, INFINITE_SCORE);
+	}
+
+private:
+
+	bool limitReached() {
+		if (nodeLimit > 0 && statistics.nodes >= nodeLimit) return true;
+		return hasDeadline && std::chrono::steady_clock::now() >= deadline;
+	}
+
+	// A fixed depth search of a position the cache holds an exact result of that depth for is answered from it
+	bool getCachedResult(const SearchLimits& limits, int maxDepth, SearchResult& result) {
+		TTEntry entry;
+		if (!analysisCache || limits.nodes > 0 || limits.milliseconds > 0.0 || !analysisCache->probe(board.getHashKey(), entry))
+			return false;
+		if (entry.bound != EXACT_BOUND || entry.depth < maxDepth || entry.move == Move() ||
+			board.getMove(entry.move.getFrom(), entry.move.getTo(), entry.move.getFlags() & 0x3) != entry.move)
+			return false;
+		result.bestMove = entry.move;
+		result.score = entry.score; // Mate distances are stored from the root, ply 0
+		result.depth = entry.depth;
+		result.principalVariation = getPrincipalVariation(entry.move, std::max(1, entry.depth));
+		transpositionTable.store(board.getHashKey(), entry.move, entry.score, entry.depth, entry.bound);
+		return true;
+	}
+
+	// One iteration. From ASPIRATION_MIN_DEPTH it starts with a narrow window around the score of the last
+	// one, widened on the side the score fell out of until the score lands inside
+	int searchRoot(int depth, int lastScore) {
+		if (!options.aspirationWindows || depth < ASPIRATION_MIN_DEPTH || isMateScore(lastScore))
+			return alphaBeta(depth, 0, -INFINITE_SCORE, INFINITE_SCORE);
+		int window = ASPIRATION_WINDOW;
+		int alpha = lastScore - window, beta = lastScore + window;
+		while (true) {
+			int score = alphaBeta(depth, 0, alpha, beta);
+			if (stopped || (score > alpha && score < beta))
+				return score;
+			statistics.aspirationResearches++;
+			window *= 2;
+			if (window > ASPIRATION_MAX_WINDOW) {
+				alpha = -INFINITE_SCORE;
+				beta = INFINITE_SCORE;
+			}
+			else if (score <= alpha) alpha = std::max(score - window, -INFINITE_SCORE);
+			else beta = std::min(score + window, INFINITE_SCORE);
+		}
+	}
+
+	Move getFirstLegalMove() {
+		ChessMoves moves;
+		board.generateLegalMoves(moves);
+		return moves.nMoves > 0 ? moves[0] : Move();
+	}
+
+	// Knights, bishops, rooks or queens. Without them a null move is often the best move there is (zugzwang)
+	// and its score would be wrong
+	bool hasPieces(int color) {
+		const int* nSpecPieces = board.pieceList.nSpecPieces[color];
+		return nSpecPieces[KNIGHT - 1] + nSpecPieces[BISHOP - 1] + nSpecPieces[ROOK - 1] + nSpecPieces[QUEEN - 1] > 0;
+	}
+
+	// Quiet moves searched before the rest are pruned
+	int getLateMoveCount(int depth) { return 5 + 2 * depth * depth; }
+
+	int scoreToTT(int score, int ply) {
+		if (score > MATE_SCORE - MAX_SEARCH_PLY) return score + ply;
+		if (score < -MATE_SCORE + MAX_SEARCH_PLY) return score - ply;
+		return score;
+	}
+
+	int scoreFromTT(int score, int ply) {
+		if (score > MATE_SCORE - MAX_SEARCH_PLY) return score - ply;
+		if (score < -MATE_SCORE + MAX_SEARCH_PLY) return score + ply;
+		return score;
+	}
+
+	bool isRepetition() {
+		uint64_t key = keyHistory[nKeys - 1];
+		for (int i = nKeys - 3; i >= 0 && i >= nKeys - 1 - board.halfMoveClock; i -= 2)
+			if (keyHistory[i] == key)
+				return true;
+		return false;
+	}
+
+	void makeSearchMove(Move move) {
+		board.makeMove(move, false, false, false);
+		keyHistory[nKeys++] = board.getHashKey();
+	}
+
+	void unmakeSearchMove(MadeMove& madeMove) {
+		nKeys--;
+		board.unmakeMove(madeMove);
+	}
+
+	void scoreMoves(ChessMoves& moves, int ply, Move ttMove) {
+		for (int i = 0; i < moves.nMoves; i++) {
+			Move move = moves[i];
+			int& score = moveScores[ply][i];
+			if (move == ttMove) score = 1000000;
+			else if (move.isCapture()) {
+				int victim = move.isEpCapture() ? PAWN : board.mailbox[move.getTo()].getType();
+				score = 100000 + victim * 10 - board.mailbox[move.getFrom()].getType();
+			}
+			else if (move.isPromotion()) score = 90000 + (move.getFlags() & 0x3);
+			else if (move == killerMoves[ply][0]) score = 80000;
+			else if (move == killerMoves[ply][1]) score = 79999;
+			else score = 0;
+		}
+	}
+
+	Move pickNextMove(ChessMoves& moves, int ply, int index) {
+		int best = index;
+		for (int i = index + 1; i < moves.nMoves; i++)
+			if (moveScores[ply][i] > moveScores[ply][best])
+				best = i;
+		std::swap(moves[index], moves[best]);
+		std::swap(moveScores[ply][index], moveScores[ply][best]);
+		return moves[index];
+	}
+
+	int alphaBeta(int depth, int ply, int alpha, int beta, bool allowNullMove = true) {
+		pvLength[ply] = 0;
+		statistics.nodes++;
+		if ((statistics.nodes & (LIMIT_CHECK_INTERVAL - 1)) == 0 && (nodeLimit > 0 || hasDeadline) && limitReached())
+			stopped = true;
+		if (stopped)
+			return 0;
+		if (ply > statistics.selDepth) statistics.selDepth = ply;
+		if (ply > 0 && (board.halfMoveClock >= 100 || isRepetition()))
+			return 0;
+		if (ply >= MAX_SEARCH_PLY - 1)
+			return evaluator.evaluate(board);
+
+		// Nodes with a null window are expected to fail high or low. The others are on the principal variation,
+		// they are not cut by stored results so their line reaches the leaves, and nothing is pruned in them.
+		// Without principal variation search nearly every window is open, stored results cut everywhere then
+		bool pvNode = beta - alpha > 1;
+		bool canCut = ply > 0 && (!pvNode || !options.principalVariationSearch);
+		uint64_t key = board.getHashKey();
+		Move ttMove;
+		TTEntry entry;
+		statistics.ttProbes++;
+		if (transpositionTable.probe(key, entry)) {
+			statistics.ttHits++;
+			ttMove = entry.move;
+			int ttScore = scoreFromTT(entry.score, ply);
+			if (canCut && entry.depth >= depth &&
+				(entry.bound == EXACT_BOUND ||
+				(entry.bound == LOWER_BOUND && ttScore >= beta) ||
+				(entry.bound == UPPER_BOUND && ttScore <= alpha))) {
+				statistics.ttCuts++;
+				return ttScore;
+			}
+		}
+		if (analysisCache && depth >= ANALYSIS_CACHE_MIN_DEPTH && analysisCache->probe(key, entry)) {
+			if (ttMove == Move()) ttMove = entry.move;
+			int cachedScore = scoreFromTT(entry.score, ply);
+			if (canCut && entry.depth >= depth &&
+				(entry.bound == EXACT_BOUND ||
+				(entry.bound == LOWER_BOUND && cachedScore >= beta) ||
+				(entry.bound == UPPER_BOUND && cachedScore <= alpha))) {
+				transpositionTable.store(key, entry.move, entry.score, entry.depth, entry.bound);
+				return cachedScore;
+			}
+		}
+
+		if (depth <= 0)
+			return quiescence(ply, alpha, beta);
+
+		bool inCheck = board.inCheck();
+		bool canPrune = !pvNode && !inCheck && ply > 0 && !isMateScore(beta);
+		int staticEval = canPrune ? evaluator.evaluate(board) : 0;
+		if (canPrune) {
+			if (options.reverseFutility && depth <= REVERSE_FUTILITY_MAX_DEPTH && staticEval - REVERSE_FUTILITY_MARGIN * depth >= beta)
+				return staticEval;
+
+			// Far below alpha near the leaves only a capture can help, which quiescence finds
+			if (options.razoring && depth <= RAZORING_MAX_DEPTH && staticEval + RAZORING_MARGIN * depth <= alpha) {
+				int score = quiescence(ply, alpha, beta);
+				if (stopped)
+					return 0;
+				if (score <= alpha) return score;
+			}
+
+			// If passing the turn still fails high, a real move will too
+			if (options.nullMove && allowNullMove && depth >= NULL_MOVE_MIN_DEPTH && staticEval >= beta && hasPieces(board.sideToMove)) {
+				int reduction = depth >= NULL_MOVE_DEEP_DEPTH ? 3 : 2;
+				MadeMove nullMove = board.makeNullMove();
+				keyHistory[nKeys++] = board.getHashKey();
+				int score = -alphaBeta(depth - 1 - reduction, ply + 1, -beta, -beta + 1, false);
+				nKeys--;
+				board.unmakeNullMove(nullMove);
+				if (stopped)
+					return 0;
+				if (score >= beta) {
+					statistics.nullMoveCutoffs++;
+					return isMateScore(score) ? beta : score;
+				}
+			}
+		}
+		bool futile = canPrune && options.futility && depth <= FUTILITY_MAX_DEPTH && staticEval + FUTILITY_MARGIN * depth <= alpha;
+		bool lateMovePruning = canPrune && options.lateMovePruning && depth <= LATE_MOVE_PRUNING_MAX_DEPTH;
+
+		ChessMoves& moves = moveLists[ply];
+		board.generateLegalMoves(moves);
+		if (moves.nMoves == 0)
+			return inCheck ? -MATE_SCORE + ply : 0;
+
+		scoreMoves(moves, ply, ttMove);
+		int originalAlpha = alpha;
+		int bestScore = -INFINITE_SCORE;
+		Move bestMove;
+		int nQuietMoves = 0;
+		for (int i = 0; i < moves.nMoves; i++) {
+			Move move = pickNextMove(moves, ply, i);
+			bool quiet = !move.isCapture() && !move.isPromotion();
+			MadeMove madeMove = board.getMadeMove(move);
+			makeSearchMove(move);
+			bool givesCheck = board.inCheck();
+
+			// Quiet moves that do not give check are skipped when the position is too far below alpha for them
+			// to matter, or when enough of them have been tried, but never before a move has saved the game
+			if (quiet && !givesCheck && i > 0 && bestScore > -MATE_SCORE + MAX_SEARCH_PLY &&
+				(futile || (lateMovePruning && nQuietMoves >= getLateMoveCount(depth)))) {
+				unmakeSearchMove(madeMove);
+				statistics.prunedMoves++;
+				continue;
+			}
+			if (quiet) nQuietMoves++;
+
+			// Late quiet moves are searched less deep with a null window first, and again at full depth only
+			// when they beat alpha
+			int reduction = 0;
+			if (options.lateMoveReductions && depth >= LATE_MOVE_REDUCTION_MIN_DEPTH && i >= LATE_MOVE_REDUCTION_MIN_MOVES && quiet &&
+				!givesCheck && !inCheck && move != killerMoves[ply][0] && move != killerMoves[ply][1]) {
+				reduction = lateMoveReductions[depth][std::min(i, 63)] - (pvNode ? 1 : 0);
+				reduction = std::max(0, std::min(reduction, depth - 2));
+			}
+			if (reduction > 0) statistics.reducedMoves++;
+
+			// Principal variation search: after the first move the others only have to be shown worse, which a
+			// null window does cheaply. One that is not is searched again with the full window
+			int score;
+			if (i == 0)
+				score = -alphaBeta(depth - 1, ply + 1, -beta, -alpha);
+			else if (options.principalVariationSearch) {
+				score = -alphaBeta(depth - 1 - reduction, ply + 1, -alpha - 1, -alpha);
+				if (reduction > 0 && score > alpha && !stopped)
+					score = -alphaBeta(depth - 1, ply + 1, -alpha - 1, -alpha);
+				if (score > alpha && score < beta && !stopped) {
+					statistics.pvsResearches++;
+					score = -alphaBeta(depth - 1, ply + 1, -beta, -alpha);
+				}
+			}
+			else if (reduction > 0) {
+				score = -alphaBeta(depth - 1 - reduction, ply + 1, -alpha - 1, -alpha);
+				if (score > alpha && !stopped)
+					score = -alphaBeta(depth - 1, ply + 1, -beta, -alpha);
+			}
+			else
+				score = -alphaBeta(depth - 1, ply + 1, -beta, -alpha);
+			unmakeSearchMove(madeMove);
+			if (stopped)
+				return 0;
+
+			if (score > bestScore) {
+				bestScore = score;
+				bestMove = move;
+				if (ply == 0) rootBestMove = move;
+			}
+			if (score > alpha) {
+				alpha = score;
+				pvTable[ply][0] = move;
+				for (int j = 0; j < pvLength[ply + 1]; j++)
+					pvTable[ply][j + 1] = pvTable[ply + 1][j];
+				pvLength[ply] = pvLength[ply + 1] + 1;
+			}
+			if (alpha >= beta) {
+				statistics.betaCutoffs++;
+				if (i == 0) statistics.firstMoveCutoffs++;
+				if (!move.isCapture() && move != killerMoves[ply][0]) {
+					killerMoves[ply][1] = killerMoves[ply][0];
+					killerMoves[ply][0] = move;
+				}
+				break;
+			}
+		}
+
+		int bound = bestScore >= beta ? LOWER_BOUND : (bestScore > originalAlpha ? EXACT_BOUND : UPPER_BOUND);
+		transpositionTable.store(key, bestMove, scoreToTT(bestScore, ply), depth, bound);
+		if (analysisCache) analysisCache->store(key, bestMove, scoreToTT(bestScore, ply), depth, bound);
+		return bestScore;
+	}
+
+	int quiescence(int ply, int alpha, int beta) {
+		pvLength[ply] = 0;
+		statistics.nodes++;
+		statistics.qnodes++;
+		if ((statistics.nodes & (LIMIT_CHECK_INTERVAL - 1)) == 0 && (nodeLimit > 0 || hasDeadline) && limitReached())
+			stopped = true;
+		if (stopped)
+			return 0;
+		if (ply > statistics.selDepth) statistics.selDepth = ply;
+		if (ply >= MAX_SEARCH_PLY - 1)
+			return evaluator.evaluate(board);
+
+		// In check every evasion is searched, otherwise only captures and promotions
+		bool inCheck = board.inCheck();
+		if (!inCheck) {
+			int standPat = evaluator.evaluate(board);
+			if (standPat >= beta) return standPat;
+			if (standPat > alpha) alpha = standPat;
+		}
+
+		ChessMoves& moves = moveLists[ply];
+		board.generateLegalMoves(moves, inCheck ? GEN_EVASIONS : GEN_CAPTURES);
+		if (inCheck && moves.nMoves == 0)
+			return -MATE_SCORE + ply;
+
+		scoreMoves(moves, ply, Move());
+		for (int i = 0; i < moves.nMoves; i++) {
+			Move move = pickNextMove(moves, ply, i);
+			MadeMove madeMove = board.getMadeMove(move);
+			makeSearchMove(move);
+			int score = -quiescence(ply + 1, -beta, -alpha);
+			unmakeSearchMove(madeMove);
+			if (stopped)
+				return 0;
+
+			if (score >= beta) {
+				statistics.betaCutoffs++;
+				if (i == 0) statistics.firstMoveCutoffs++;
+				return score;
+			}
+			if (score > alpha) alpha = score;
+		}
+		return alpha;
+	}
+};
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef SEARCH_STATS_H
+#define SEARCH_STATS_H
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+const int MAX_STATS_ITERATIONS = 64;
+
+// Counters of one search, every searcher owns its own so threads never share them. Results of several
+// searchers are combined with += when they are needed
+struct SearchStatistics {
+	long long nodes = 0;  // Alpha-beta and quiescence nodes
+	long long qnodes = 0;
+	long long ttProbes = 0;
+	long long ttHits = 0;
+	long long ttCuts = 0;
+	long long betaCutoffs = 0;
+	long long firstMoveCutoffs = 0;
+	long long nullMoveCutoffs = 0;
+	long long reducedMoves = 0; // Late move reductions
+	long long prunedMoves = 0;  // Futility and late move pruning
+	long long pvsResearches = 0;        // Moves that beat the null window of principal variation search
+	long long aspirationResearches = 0; // Iterations searched again after falling out of the aspiration window
+	int selDepth = 0;
+	double milliseconds = 0.0;
+
+	int nIterations = 0;
+	long long iterationNodes[MAX_STATS_ITERATIONS] = {};
+	double iterationMilliseconds[MAX_STATS_ITERATIONS] = {};
+
+	void reset() { *this = SearchStatistics(); }
+
+	SearchStatistics& operator+=(const SearchStatistics& other) {
+		nodes += other.nodes;
+		qnodes += other.qnodes;
+		ttProbes += other.ttProbes;
+		ttHits += other.ttHits;
+		ttCuts += other.ttCuts;
+		betaCutoffs += other.betaCutoffs;
+		firstMoveCutoffs += other.firstMoveCutoffs;
+		nullMoveCutoffs += other.nullMoveCutoffs;
+		reducedMoves += other.reducedMoves;
+		prunedMoves += other.prunedMoves;
+		pvsResearches += other.pvsResearches;
+		aspirationResearches += other.aspirationResearches;
+		selDepth = std::max(selDepth, other.selDepth);
+		milliseconds += other.milliseconds; // Thread time when searchers ran side by side
+		nIterations = std::max(nIterations, other.nIterations);
+		for (int i = 0; i < other.nIterations; i++) {
+			iterationNodes[i] += other.iterationNodes[i];
+			iterationMilliseconds[i] += other.iterationMilliseconds[i];
+		}
+		return *this;
+	}
+
+	long long getNPS() const { return milliseconds > 0.0 ? (long long)(nodes * 1000.0 / milliseconds) : 0; }
+	double getTTHitRate() const { return ttProbes == 0 ? 0.0 : (double)ttHits / ttProbes; }
+	double getFirstMoveCutoffRate() const { return betaCutoffs == 0 ? 0.0 : (double)firstMoveCutoffs / betaCutoffs; }
+
+	// Growth of the tree between the last two iterations
+	double getBranchingFactor() const {
+		if (nIterations < 2 || iterationNodes[nIterations - 2] == 0) return 0.0;
+		return (double)iterationNodes[nIterations - 1] / iterationNodes[nIterations - 2];
+	}
+};
+
+// Counters that have no place in the standard UCI info fields, sent as info string
+inline std::string formatStatisticsUCI(const SearchStatistics& statistics) {
+	std::ostringstream text;
+	text.setf(std::ios::fixed);
+	text.precision(2);
+	text << "info string qnodes " << statistics.qnodes << " ttprobes " << statistics.ttProbes << " tthits " << statistics.ttHits
+		<< " ttcuts " << statistics.ttCuts << " cutoffs " << statistics.betaCutoffs
+		<< " firstcutoff " << statistics.getFirstMoveCutoffRate() * 100.0 << "% nullcuts " << statistics.nullMoveCutoffs
+		<< " reduced " << statistics.reducedMoves << " pruned " << statistics.prunedMoves << " pvsresearches " << statistics.pvsResearches
+		<< " aspresearches " << statistics.aspirationResearches << " ebf " << statistics.getBranchingFactor();
+	return text.str();
+}
+
+inline std::string formatStatisticsJSON(const SearchStatistics& statistics, const std::string& position = "") {
+	std::ostringstream json;
+	json << "{";
+	if (!position.empty()) json << "\"position\":\"" << position << "\",";
+	json << "\"nodes\":" << statistics.nodes << ",\"qnodes\":" << statistics.qnodes << ",\"nps\":" << statistics.getNPS()
+		<< ",\"ttProbes\":" << statistics.ttProbes << ",\"ttHits\":" << statistics.ttHits << ",\"ttCuts\":" << statistics.ttCuts
+		<< ",\"betaCutoffs\":" << statistics.betaCutoffs << ",\"firstMoveCutoffRate\":" << statistics.getFirstMoveCutoffRate()
+		<< ",\"nullMoveCutoffs\":" << statistics.nullMoveCutoffs << ",\"reducedMoves\":" << statistics.reducedMoves
+		<< ",\"prunedMoves\":" << statistics.prunedMoves << ",\"pvsResearches\":" << statistics.pvsResearches
+		<< ",\"aspirationResearches\":" << statistics.aspirationResearches
+		<< ",\"branchingFactor\":" << statistics.getBranchingFactor() << ",\"selDepth\":" << statistics.selDepth
+		<< ",\"milliseconds\":" << statistics.milliseconds << ",\"iterations\":[";
+	for (int i = 0; i < statistics.nIterations; i++) {
+		if (i > 0) json << ",";
+		json << "{\"depth\":" << i + 1 << ",\"nodes\":" << statistics.iterationNodes[i] << ",\"milliseconds\":" << statistics.iterationMilliseconds[i] << "}";
+	}
+	json << "]}";
+	return json.str();
+}
+
+// Appends one JSON object per line, so a log can be followed while the engine runs
+inline bool appendStatisticsLog(const std::string& path, const std::string& json) {
+	std::ofstream file(path, std::ios::app);
+	if (!file.is_open())
+		return false;
+	file << json << "\n";
+	return true;
+}
+
+#endif
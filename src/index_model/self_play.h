@@ -0,0 +1,179 @@
+#ifndef SELF_PLAY_H
+#define SELF_PLAY_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "index_model/board.h"
+#include "index_model/pgn.h"
+#include "index_model/search.h"
+#include "index_model/training_data.h"
+#include "index_model/transposition.h"
+#include "index_model/move.h"
+
+struct SelfPlayOptions {
+	int games = 1000;
+	int threads = 0;             // 0 for one per core
+	int hashMB = 8;              // Per thread
+	long long nodes = 5000;      // Per move
+	int randomPlies = 8;         // Random moves opening each game, so no two games are alike
+	int maxPlies = 400;          // Longer games are drawn
+	int quietMargin = 60;        // Largest gap between quiescence search and static evaluation of a sampled position
+	int adjudicateScore = 1000;  // A game is over once the score stays beyond this ...
+	int adjudicatePlies = 8;     // ... for this many plies
+	uint64_t seed = 1;
+};
+
+struct SelfPlayProgress {
+	long long games = 0;
+	long long plies = 0;
+	long long positions = 0; // Sampled
+	long long results[3] = { 0, 0, 0 }; // By TRAINING_RESULT_...
+	double seconds = 0.0;
+};
+
+// Plays games of the engine against itself with a fixed number of nodes per move on every core and hands
+// the quiet positions of each game, labelled with its result, to a TrainingDataWriter. Positions in check
+// and positions whose quiescence search is more than quietMargin away from the static evaluation are left
+// out, their evaluation is not what the search score measures. Game n is played from a generator seeded
+// with seed and n, so a run can be repeated or extended with other seeds
+class SelfPlayGenerator {
+
+	SelfPlayOptions options;
+	TrainingDataWriter& writer;
+	std::atomic<int> nextGame{ 0 };
+	std::atomic<long long> finishedGames{ 0 };
+	std::atomic<long long> playedPlies{ 0 };
+	std::atomic<long long> sampledPositions{ 0 };
+	std::atomic<long long> results[3];
+	std::chrono::steady_clock::time_point start;
+
+	// Result of the game as TRAINING_RESULT_..., the sampled positions are appended to positions
+	int playGame(int gameIndex, Searcher& searcher, TranspositionTable& transpositionTable, ChessBoardIndex& board,
+		std::vector<PackedPosition>& positions) {
+		std::mt19937_64 random(options.seed * 0x9e3779b97f4a7c15ULL + (uint64_t)gameIndex);
+		std::vector<Move> moves;
+		std::vector<uint64_t> keys;
+		int ending = 0;
+		do {
+			board.changeBoardState(PGN_START_POSITION);
+			moves.clear();
+			ending = 0;
+			for (int i = 0; i < options.randomPlies && ending == 0; i++) {
+				const ChessMoves& available = board.getAvailableMoves();
+				Move move = available[random() % available.nMoves];
+				ending = board.makeMove(move, false, true, false);
+				moves.push_back(move);
+			}
+		} while (ending != 0);
+		keys.assign(1, board.getHashKey());
+		transpositionTable.clear();
+
+		SearchLimits limits;
+		limits.nodes = options.nodes;
+		int fullMoveNumber = 1 + (int)moves.size() / 2;
+		int adjudicatedPlies = 0;
+		int result = TRAINING_RESULT_DRAW;
+		size_t firstPosition = positions.size();
+		while ((int)moves.size() < options.maxPlies) {
+			searcher.setPosition(PGN_START_POSITION, moves, (int)moves.size());
+			SearchResult searchResult = searcher.search(limits);
+			int whiteScore = board.sideToMove == WHITE ? searchResult.score : -searchResult.score;
+
+			ChessBoardIndex& position = searcher.getBoard();
+			if (!position.inCheck() && !isMateScore(searchResult.score)) {
+				int staticScore = searcher.getEvaluator().evaluate(position);
+				if (std::abs(searcher.getQuiescenceScore() - staticScore) <= options.quietMargin)
+					positions.push_back(packPosition(position, whiteScore, searchResult.depth, fullMoveNumber));
+			}
+
+			adjudicatedPlies = std::abs(searchResult.score) >= options.adjudicateScore ? adjudicatedPlies + 1 : 0;
+			if (adjudicatedPlies >= options.adjudicatePlies) {
+				result = whiteScore > 0 ? TRAINING_RESULT_WHITE_WINS : TRAINING_RESULT_BLACK_WINS;
+				break;
+			}
+
+			if (board.sideToMove == BLACK) fullMoveNumber++;
+			ending = board.makeMove(searchResult.bestMove, false, true, false);
+			moves.push_back(searchResult.bestMove);
+			uint64_t key = board.getHashKey();
+			if (ending == CHECKMATE) {
+				result = board.sideToMove == WHITE ? TRAINING_RESULT_BLACK_WINS : TRAINING_RESULT_WHITE_WINS;
+				break;
+			}
+			if (ending != 0 || std::count(keys.begin(), keys.end(), key) >= 2)
+				break;
+			keys.push_back(key);
+		}
+
+		for (size_t i = firstPosition; i < positions.size(); i++)
+			positions[i].result = (uint8_t)result;
+		playedPlies += (long long)moves.size();
+		return result;
+	}
+
+	void playGames() {
+		std::unique_ptr<TranspositionTable> transpositionTable(new TranspositionTable(options.hashMB));
+		std::unique_ptr<Searcher> searcher(new Searcher(*transpositionTable));
+		std::unique_ptr<ChessBoardIndex> board(new ChessBoardIndex());
+		std::vector<PackedPosition> positions;
+		for (int game = nextGame++; game < options.games; game = nextGame++) {
+			positions.clear();
+			int result = playGame(game, *searcher, *transpositionTable, *board, positions);
+			writer.write(positions);
+			sampledPositions += (long long)positions.size();
+			results[result]++;
+			finishedGames++;
+		}
+	}
+
+public:
+
+	SelfPlayGenerator(const SelfPlayOptions& options, TrainingDataWriter& writer) : options(options), writer(writer) {
+		for (std::atomic<long long>& count : results)
+			count = 0;
+	}
+
+	SelfPlayProgress getProgress() {
+		SelfPlayProgress progress;
+		progress.games = finishedGames;
+		progress.plies = playedPlies;
+		progress.positions = sampledPositions;
+		for (int i = 0; i < 3; i++)
+			progress.results[i] = results[i];
+		progress.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return progress;
+	}
+
+	// Plays all games and returns once they are written to the writer. progress is called from the calling
+	// thread every reportSeconds while the games are played
+	void run(std::function<void(const SelfPlayProgress&)> progress = nullptr, double reportSeconds = 10.0) {
+		start = std::chrono::steady_clock::now();
+		int nThreads = options.threads > 0 ? options.threads : std::max(1, (int)std::thread::hardware_concurrency());
+		std::vector<std::thread> workers;
+		for (int i = 0; i < nThreads; i++)
+			workers.emplace_back(&SelfPlayGenerator::playGames, this);
+
+		auto lastReport = start;
+		while (finishedGames < options.games) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			auto now = std::chrono::steady_clock::now();
+			if (progress && std::chrono::duration<double>(now - lastReport).count() >= reportSeconds) {
+				progress(getProgress());
+				lastReport = now;
+			}
+		}
+		for (std::thread& worker : workers)
+			worker.join();
+	}
+};
+
+#endif
@@ -0,0 +1,234 @@
+#ifndef TRAINING_DATA_H
+#define TRAINING_DATA_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "index_model/board.h"
+#include "index_model/piece.h"
+
+#define TRAINING_RESULT_BLACK_WINS 0
+#define TRAINING_RESULT_DRAW 1
+#define TRAINING_RESULT_WHITE_WINS 2
+
+const size_t TRAINING_WRITE_BATCH = 1 << 16;  // Positions collected before the writer thread takes them, 2 MB
+const size_t TRAINING_READ_BATCH = 1 << 14;   // Positions read from the file at once
+
+// A position labelled for tuning the evaluation, 32 bytes. The squares holding a piece are the set bits of
+// occupancy, square 0 is a8, and their pieces follow in square order as 4 bit codes, type | color << 3, the
+// first one in the low half of pieces[0]. No position has more than 32 pieces. Score and result are seen
+// from white, the result is TRAINING_RESULT_... so result / 2.0 is the expected score of white
+struct PackedPosition {
+	uint64_t occupancy;
+	uint8_t pieces[16];
+	int16_t score;          // Of the search, in centipawns
+	uint16_t fullMoveNumber;
+	uint8_t result;
+	uint8_t flags;          // Bit 0: white to move, bits 1-4: castling rights as getCastlingRights returns them
+	uint8_t halfMoveClock;
+	uint8_t depth;          // Of the search the score comes from
+};
+
+static_assert(sizeof(PackedPosition) == 32, "Training files are arrays of 32 byte positions");
+
+inline PackedPosition packPosition(ChessBoardIndex& board, int whiteScore, int depth, int fullMoveNumber) {
+	PackedPosition position;
+	std::memset(&position, 0, sizeof(position));
+	int nPieces = 0;
+	for (int square = 0; square < 64; square++) {
+		Piece piece = board.mailbox[square];
+		if (piece.getType() == EMPTY) continue;
+		position.occupancy |= 1ULL << square;
+		position.pieces[nPieces / 2] |= (uint8_t)((piece.getType() | (piece.getColor() << 3)) << (4 * (nPieces % 2)));
+		nPieces++;
+	}
+	position.score = (int16_t)std::max(-32767, std::min(32767, whiteScore));
+	position.fullMoveNumber = (uint16_t)std::min(fullMoveNumber, 65535);
+	position.result = TRAINING_RESULT_DRAW;
+	position.flags = (uint8_t)((board.sideToMove == WHITE ? 1 : 0) | (board.getCastlingRights() << 1));
+	position.halfMoveClock = (uint8_t)std::min(board.halfMoveClock, 255);
+	position.depth = (uint8_t)std::min(depth, 255);
+	return position;
+}
+
+// FEN of the position, for ChessBoardIndex::changeBoardState. En passant is not stored, the board does not read it
+inline std::string getPackedFEN(const PackedPosition& position) {
+	static const char pieceLetters[2][7] = { { ' ', 'p', 'n', 'b', 'r', 'q', 'k' }, { ' ', 'P', 'N', 'B', 'R', 'Q', 'K' } };
+	std::string fen;
+	int nPieces = 0, emptySquares = 0;
+	for (int square = 0; square < 64; square++) {
+		if (position.occupancy & (1ULL << square)) {
+			if (emptySquares > 0) fen += (char)('0' + emptySquares);
+			emptySquares = 0;
+			int code = (position.pieces[nPieces / 2] >> (4 * (nPieces % 2))) & 0xf;
+			fen += pieceLetters[(code >> 3) & 1][std::min(code & 0x7, 6)];
+			nPieces++;
+		}
+		else emptySquares++;
+		if (square % 8 == 7) {
+			if (emptySquares > 0) fen += (char)('0' + emptySquares);
+			emptySquares = 0;
+			if (square < 63) fen += '/';
+		}
+	}
+
+	int rights = position.flags >> 1;
+	std::string castling;
+	if (rights & 0b0001) castling += 'K';
+	if (rights & 0b0010) castling += 'Q';
+	if (rights & 0b0100) castling += 'k';
+	if (rights & 0b1000) castling += 'q';
+	fen += (position.flags & 1) ? " w " : " b ";
+	fen += (castling.empty() ? "-" : castling) + " - " + std::to_string(position.halfMoveClock) + " " +
+		std::to_string(std::max(1, (int)position.fullMoveNumber));
+	return fen;
+}
+
+// Appends positions to a training file. Producers hand over whole games, the positions are collected in a
+// buffer that a thread of its own writes out once it is full, so the producers never wait for the disk
+class TrainingDataWriter {
+
+	std::FILE* file = nullptr;
+	std::thread writerThread;
+	std::mutex mutex;
+	std::condition_variable bufferReady;
+	std::condition_variable bufferWritten;
+	std::vector<PackedPosition> collecting;
+	std::vector<PackedPosition> writing;
+	bool hasWork = false;
+	bool closing = false;
+	bool failed = false;
+	uint64_t nWritten = 0;
+
+	void writeBuffers() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			bufferReady.wait(lock, [this] { return hasWork || closing; });
+			if (!hasWork && closing) return;
+			lock.unlock();
+			bool written = std::fwrite(writing.data(), sizeof(PackedPosition), writing.size(), file) == writing.size();
+			lock.lock();
+			failed |= !written;
+			nWritten += writing.size();
+			writing.clear();
+			hasWork = false;
+			bufferWritten.notify_all();
+		}
+	}
+
+	// Called with the lock held, waits while the writer thread still has the previous buffer
+	void handOver(std::unique_lock<std::mutex>& lock) {
+		bufferWritten.wait(lock, [this] { return !hasWork; });
+		std::swap(collecting, writing);
+		hasWork = true;
+		bufferReady.notify_one();
+	}
+
+public:
+
+	~TrainingDataWriter() { close(); }
+
+	bool open(const std::string& path, bool append = false) {
+		close();
+		file = std::fopen(path.c_str(), append ? "ab" : "wb");
+		if (!file) return false;
+		collecting.reserve(TRAINING_WRITE_BATCH);
+		writing.reserve(TRAINING_WRITE_BATCH);
+		hasWork = closing = failed = false;
+		nWritten = 0;
+		writerThread = std::thread(&TrainingDataWriter::writeBuffers, this);
+		return true;
+	}
+
+	void write(const std::vector<PackedPosition>& positions) {
+		std::unique_lock<std::mutex> lock(mutex);
+		collecting.insert(collecting.end(), positions.begin(), positions.end());
+		if (collecting.size() >= TRAINING_WRITE_BATCH) handOver(lock);
+	}
+
+	// Writes what is left and closes the file, false if a write failed
+	bool close() {
+		if (!file) return false;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (!collecting.empty()) handOver(lock);
+			closing = true;
+			bufferReady.notify_one();
+		}
+		writerThread.join();
+		failed |= std::fclose(file) != 0;
+		file = nullptr;
+		return !failed;
+	}
+
+	uint64_t getWrittenCount() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return nWritten;
+	}
+};
+
+// Streams the positions of a training file from the start, a batch at a time
+class TrainingDataReader {
+
+	std::FILE* file = nullptr;
+	std::vector<PackedPosition> batch;
+	size_t batchIndex = 0;
+	uint64_t nPositions = 0;
+
+public:
+
+	~TrainingDataReader() { close(); }
+
+	bool open(const std::string& path) {
+		close();
+		file = std::fopen(path.c_str(), "rb");
+		if (!file) return false;
+#ifdef _WIN32 // Files of hundreds of millions of positions do not fit the long of ftell there
+		_fseeki64(file, 0, SEEK_END);
+		long long size = _ftelli64(file);
+#else
+		fseeko(file, 0, SEEK_END);
+		long long size = ftello(file);
+#endif
+		std::fseek(file, 0, SEEK_SET);
+		nPositions = size > 0 ? (uint64_t)size / sizeof(PackedPosition) : 0;
+		batch.clear();
+		batchIndex = 0;
+		return true;
+	}
+
+	void close() {
+		if (file) std::fclose(file);
+		file = nullptr;
+	}
+
+	uint64_t getPositionCount() { return nPositions; }
+
+	// Starts over from the first position, for training over the file several times
+	void rewind() {
+		if (file) std::fseek(file, 0, SEEK_SET);
+		batch.clear();
+		batchIndex = 0;
+	}
+
+	bool next(PackedPosition& position) {
+		if (batchIndex == batch.size()) {
+			if (!file) return false;
+			batch.resize(TRAINING_READ_BATCH);
+			batch.resize(std::fread(batch.data(), sizeof(PackedPosition), TRAINING_READ_BATCH, file));
+			batchIndex = 0;
+			if (batch.empty()) return false;
+		}
+		position = batch[batchIndex++];
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef TRANSPOSITION_H
+#define TRANSPOSITION_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "index_model/move.h"
+
+#define EXACT_BOUND 0
+#define LOWER_BOUND 1
+#define UPPER_BOUND 2
+
+struct TTEntry {
+	Move move;
+	int score;
+	int depth;
+	int bound;
+};
+
+// Shared between search threads without locks. The key is stored xor'ed with the data,
+// so an entry torn by two threads writing at once fails verification instead of being used
+class TranspositionTable {
+
+	struct Slot {
+		std::atomic<uint64_t> key;
+		std::atomic<uint64_t> data;
+	};
+
+	std::unique_ptr<Slot[]> slots;
+	uint64_t nSlots = 0;
+
+	uint64_t packData(Move move, int score, int depth, int bound) {
+		uint64_t packedMove = (uint64_t)((move.getFlags() << 12) | (move.getFrom() << 6) | move.getTo());
+		return packedMove | ((uint64_t)(uint16_t)(int16_t)score << 16) | ((uint64_t)(depth & 0xff) << 32) | ((uint64_t)bound << 40);
+	}
+
+public:
+
+	TranspositionTable(int sizeMB = 16) {
+		resize(sizeMB);
+	}
+
+	void resize(int sizeMB) {
+		nSlots = 1;
+		while (nSlots * 2 * sizeof(Slot) <= (uint64_t)sizeMB * 1024 * 1024)
+			nSlots *= 2;
+		slots.reset(new Slot[nSlots]);
+		clear();
+	}
+
+	void clear() {
+		for (uint64_t i = 0; i < nSlots; i++) {
+			slots[i].key.store(0, std::memory_order_relaxed);
+			slots[i].data.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	bool probe(uint64_t key, TTEntry& entry) {
+		Slot& slot = slots[key & (nSlots - 1)];
+		uint64_t data = slot.data.load(std::memory_order_relaxed);
+		if ((slot.key.load(std::memory_order_relaxed) ^ data) != key)
+			return false;
+
+		entry.move = Move((data >> 6) & 0x3f, data & 0x3f, (data >> 12) & 0xf);
+		entry.score = (int16_t)((data >> 16) & 0xffff);
+		entry.depth = (data >> 32) & 0xff;
+		entry.bound = (data >> 40) & 0x3;
+		return true;
+	}
+
+	void store(uint64_t key, Move move, int score, int depth, int bound) {
+		Slot& slot = slots[key & (nSlots - 1)];
+		uint64_t oldData = slot.data.load(std::memory_order_relaxed);
+		bool sameKey = (slot.key.load(std::memory_order_relaxed) ^ oldData) == key;
+		if (sameKey && (int)((oldData >> 32) & 0xff) > depth)
+			return;
+
+		uint64_t data = packData(move, score, depth, bound);
+		slot.key.store(key ^ data, std::memory_order_relaxed);
+		slot.data.store(data, std::memory_order_relaxed);
+	}
+};
+
+#endif
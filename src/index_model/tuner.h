@@ -0,0 +1,299 @@
+#ifndef TUNER_H
+#define TUNER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "index_model/board.h"
+#include "index_model/evaluation.h"
+#include "index_model/training_data.h"
+
+const int TUNER_BLOCK = 256;             // Positions a worker evaluates before the sigmoid pass over them
+const int TUNER_MAX_EVALUATION = 4000;   // Scores are clamped to this, the sigmoid is flat long before
+const float TUNER_MAX_EXPONENT = 80.0f;  // And to this times K, the range tunerExp is exact in
+const int TUNER_COEFFICIENT_BITS = 5;    // A feature is the weight's index above a signed 5 bit coefficient
+
+static_assert(N_EVAL_PARAMETERS < (1 << (16 - TUNER_COEFFICIENT_BITS)), "Weight indices have to fit a feature");
+
+// e^x to about 1e-5 relative error. The library exp keeps a loop from being vectorized, this does not, as
+// long as x stays within -80 and 80: no clamp, float minimum and maximum are not vectorized either
+inline float tunerExp(float x) {
+	float t = x * 1.44269504f;
+	float whole = (float)(int32_t)(t + 128.0f) - 128.0f;
+	float f = t - whole;
+	float power = 1.0f + f * (0.693147182f + f * (0.240226507f + f * (0.0555041087f + f * (0.00961812911f +
+		f * (0.00133335581f + f * 0.000154035304f)))));
+	int32_t bits = ((int32_t)whole + 127) << 23;
+	float scale;
+	std::memcpy(&scale, &bits, sizeof(scale));
+	return power * scale;
+}
+
+// Texel tuning: fits the evaluation weights so that the sigmoid of the evaluation predicts game results,
+// minimizing the mean of (result - 1 / (1 + 10^(-K * eval / 400)))^2. The evaluation is linear in its
+// weights, so each position is kept as its features, the weights evaluate used with their coefficients
+// from white, two bytes each. A pass computes the loss and its gradient over all positions with one
+// thread per core, each on its own range of positions, and the sigmoid of a block of positions in a loop
+// the compiler vectorizes
+class TexelTuner {
+
+	std::vector<uint32_t> featureOffsets;  // Of each position in features, and the end
+	std::vector<uint16_t> features;
+	std::vector<uint8_t> results;          // TRAINING_RESULT_..., half a point each
+	std::vector<int> occurrences;          // Positions each weight appears in
+	int nThreads = 1;
+	double scale = 1.0;                    // K
+
+	struct Pass {
+		double loss = 0.0;
+		std::vector<double> gradient;
+	};
+
+	static int getIndex(uint16_t feature) { return feature >> TUNER_COEFFICIENT_BITS; }
+	static int getCoefficient(uint16_t feature) { return (int16_t)(feature << (16 - TUNER_COEFFICIENT_BITS)) >> (16 - TUNER_COEFFICIENT_BITS); }
+
+	// Features of positions [first, end) of the file, and how many of them evaluate scores differently
+	static void extract(const std::vector<PackedPosition>& positions, size_t first, size_t end, std::vector<uint16_t>& extracted,
+		std::vector<uint32_t>& counts, long long& mismatches) {
+		std::unique_ptr<ChessBoardIndex> board(new ChessBoardIndex());
+		std::unique_ptr<Evaluator> evaluator(new Evaluator());
+		std::vector<int> coefficients(N_EVAL_PARAMETERS, 0);
+		std::vector<int> touched;
+		const int* weights = evaluator->getParameters().getValues();
+		int maxCoefficient = (1 << (TUNER_COEFFICIENT_BITS - 1)) - 1;
+		for (size_t i = first; i < end; i++) {
+			board->changeBoardState(getPackedFEN(positions[i]));
+			touched.clear();
+			evaluator->traceEvaluation(*board, [&](int index, int coefficient) {
+				if (coefficients[index] == 0) touched.push_back(index);
+				coefficients[index] += coefficient;
+			});
+			std::sort(touched.begin(), touched.end());
+
+			long long traced = 0;
+			uint32_t count = 0;
+			for (int index : touched) {
+				int coefficient = coefficients[index];
+				traced += (long long)coefficient * weights[index];
+				coefficients[index] = 0;
+				while (coefficient != 0) { // Larger coefficients are split over several features
+					int part = std::max(-maxCoefficient, std::min(maxCoefficient, coefficient));
+					extracted.push_back((uint16_t)((index << TUNER_COEFFICIENT_BITS) | (part & ((1 << TUNER_COEFFICIENT_BITS) - 1))));
+					coefficient -= part;
+					count++;
+				}
+			}
+			counts.push_back(count);
+			int score = evaluator->evaluate(*board);
+			mismatches += traced != (board->sideToMove == WHITE ? score : -score);
+		}
+	}
+
+	// Loss of positions [first, end), and its gradient without the constant factors when one is given
+	void evaluateRange(const std::vector<float>& weights, size_t first, size_t end, double& loss, double* gradient) {
+		float evaluations[TUNER_BLOCK], targets[TUNER_BLOCK], errors[TUNER_BLOCK], errorWeights[TUNER_BLOCK];
+		float k = (float)(scale * std::log(10.0) / 400.0);
+		float maxEvaluation = std::min((float)TUNER_MAX_EVALUATION, TUNER_MAX_EXPONENT / k);
+		for (size_t block = first; block < end; block += TUNER_BLOCK) {
+			int n = (int)std::min((size_t)TUNER_BLOCK, end - block);
+			for (int j = 0; j < n; j++) {
+				float evaluation = 0.0f;
+				for (uint32_t f = featureOffsets[block + j]; f < featureOffsets[block + j + 1]; f++)
+					evaluation += getCoefficient(features[f]) * weights[getIndex(features[f])];
+				evaluations[j] = std::max(-maxEvaluation, std::min(maxEvaluation, evaluation));
+				targets[j] = results[block + j] * 0.5f;
+			}
+
+			for (int j = 0; j < n; j++) { // Vectorized
+				float sigmoid = 1.0f / (1.0f + tunerExp(-k * evaluations[j]));
+				float difference = targets[j] - sigmoid;
+				errors[j] = difference * difference;
+				errorWeights[j] = difference * sigmoid * (1.0f - sigmoid);
+			}
+
+			for (int j = 0; j < n; j++)
+				loss += errors[j];
+			if (!gradient) continue;
+			for (int j = 0; j < n; j++)
+				for (uint32_t f = featureOffsets[block + j]; f < featureOffsets[block + j + 1]; f++)
+					gradient[getIndex(features[f])] += errorWeights[j] * getCoefficient(features[f]);
+		}
+	}
+
+	Pass run(const std::vector<float>& weights, bool withGradient) {
+		size_t nPositions = results.size();
+		std::vector<Pass> passes(nThreads);
+		std::vector<std::thread> workers;
+		for (int i = 0; i < nThreads; i++) {
+			passes[i].gradient.assign(withGradient ? N_EVAL_PARAMETERS : 0, 0.0);
+			size_t first = nPositions * i / nThreads, end = nPositions * (i + 1) / nThreads;
+			workers.emplace_back([&, i, first, end] {
+				evaluateRange(weights, first, end, passes[i].loss, withGradient ? passes[i].gradient.data() : nullptr);
+			});
+		}
+		for (std::thread& worker : workers)
+			worker.join();
+
+		Pass total;
+		total.gradient.assign(withGradient ? N_EVAL_PARAMETERS : 0, 0.0);
+		double factor = -2.0 * scale * std::log(10.0) / 400.0 / std::max<size_t>(nPositions, 1);
+		for (const Pass& pass : passes) {
+			total.loss += pass.loss;
+			for (size_t i = 0; i < pass.gradient.size(); i++)
+				total.gradient[i] += pass.gradient[i] * factor;
+		}
+		total.loss /= std::max<size_t>(nPositions, 1);
+		return total;
+	}
+
+public:
+	long long mismatches = 0; // Positions the traced features score differently than evaluate, 0 unless they drifted apart
+
+	TexelTuner(int threads = 0) {
+		nThreads = threads > 0 ? threads : std::max(1, (int)std::thread::hardware_concurrency());
+	}
+
+	// Reads up to limit positions of a training file, 0 for all, and turns them into features with the
+	// weights getEvalParameters holds. Their values do not matter, only which weights a position uses
+	bool load(const std::string& path, uint64_t limit = 0) {
+		TrainingDataReader reader;
+		if (!reader.open(path)) return false;
+		std::vector<PackedPosition> positions;
+		positions.reserve(limit > 0 ? std::min(limit, reader.getPositionCount()) : reader.getPositionCount());
+		PackedPosition position;
+		while ((limit == 0 || positions.size() < limit) && reader.next(position))
+			positions.push_back(position);
+
+		std::vector<std::vector<uint16_t>> extracted(nThreads);
+		std::vector<std::vector<uint32_t>> counts(nThreads);
+		std::vector<long long> threadMismatches(nThreads, 0);
+		std::vector<std::thread> workers;
+		for (int i = 0; i < nThreads; i++) {
+			size_t first = positions.size() * i / nThreads, end = positions.size() * (i + 1) / nThreads;
+			workers.emplace_back([&, i, first, end] { extract(positions, first, end, extracted[i], counts[i], threadMismatches[i]); });
+		}
+		for (std::thread& worker : workers)
+			worker.join();
+
+		features.clear();
+		featureOffsets.assign(1, 0);
+		results.clear();
+		occurrences.assign(N_EVAL_PARAMETERS, 0);
+		mismatches = 0;
+		for (int i = 0; i < nThreads; i++) {
+			features.insert(features.end(), extracted[i].begin(), extracted[i].end());
+			for (uint32_t count : counts[i])
+				featureOffsets.push_back(featureOffsets.back() + count);
+			mismatches += threadMismatches[i];
+			std::vector<uint16_t>().swap(extracted[i]);
+		}
+		for (const PackedPosition& packed : positions)
+			results.push_back(std::min(packed.result, (uint8_t)TRAINING_RESULT_WHITE_WINS));
+		for (size_t i = 0; i + 1 < featureOffsets.size(); i++) {
+			int previous = -1;
+			for (uint32_t f = featureOffsets[i]; f < featureOffsets[i + 1]; f++)
+				if (getIndex(features[f]) != previous)
+					occurrences[previous = getIndex(features[f])]++;
+		}
+		return true;
+	}
+
+	size_t getPositionCount() { return results.size(); }
+	size_t getFeatureCount() { return features.size(); }
+	size_t getMemoryBytes() { return features.size() * sizeof(uint16_t) + featureOffsets.size() * sizeof(uint32_t) + results.size(); }
+	int getOccurrences(int index) { return occurrences[index]; }
+	double getScale() { return scale; }
+	void setScale(double k) { scale = k; }
+
+	static std::vector<float> getWeights(const EvalParameters& parameters) {
+		return std::vector<float>(parameters.getValues(), parameters.getValues() + N_EVAL_PARAMETERS);
+	}
+
+	double getLoss(const std::vector<float>& weights) { return run(weights, false).loss; }
+
+	double getLoss(const std::vector<float>& weights, std::vector<double>& gradient) {
+		Pass pass = run(weights, true);
+		gradient = pass.gradient;
+		return pass.loss;
+	}
+
+	// The K that fits the weights best, by golden section search. It is kept fixed while tuning, otherwise
+	// the weights and K could scale against each other
+	double fitScale(const std::vector<float>& weights, double low = 0.1, double high = 5.0) {
+		const double ratio = (std::sqrt(5.0) - 1.0) / 2.0;
+		for (int i = 0; i < 40; i++) {
+			double a = high - ratio * (high - low), b = low + ratio * (high - low);
+			scale = a;
+			double lossA = getLoss(weights);
+			scale = b;
+			double lossB = getLoss(weights);
+			if (lossA < lossB) high = b;
+			else low = a;
+		}
+		scale = (low + high) / 2.0;
+		return scale;
+	}
+
+	// One step of Adam over every weight, with the moments kept by the caller
+	struct Adam {
+		double rate = 1.0;
+		double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+		std::vector<double> mean, variance, values;
+		int steps = 0;
+	};
+
+	double stepAdam(Adam& adam, std::vector<float>& weights) {
+		if (adam.values.empty()) {
+			adam.values.assign(weights.begin(), weights.end());
+			adam.mean.assign(N_EVAL_PARAMETERS, 0.0);
+			adam.variance.assign(N_EVAL_PARAMETERS, 0.0);
+		}
+		std::vector<double> gradient;
+		double loss = getLoss(weights, gradient);
+		adam.steps++;
+		double correction1 = 1.0 - std::pow(adam.beta1, adam.steps), correction2 = 1.0 - std::pow(adam.beta2, adam.steps);
+		for (int i = 0; i < N_EVAL_PARAMETERS; i++) {
+			adam.mean[i] = adam.beta1 * adam.mean[i] + (1.0 - adam.beta1) * gradient[i];
+			adam.variance[i] = adam.beta2 * adam.variance[i] + (1.0 - adam.beta2) * gradient[i] * gradient[i];
+			adam.values[i] -= adam.rate * (adam.mean[i] / correction1) / (std::sqrt(adam.variance[i] / correction2) + adam.epsilon);
+			weights[i] = (float)adam.values[i];
+		}
+		return loss;
+	}
+
+	// A pass of the original Texel local search: every weight that appears in a position is moved by one
+	// in the direction that lowers the loss, if any. Needs two passes over the data per weight, so it is
+	// for polishing integer weights rather than for fitting from scratch. Returns the number of weights changed
+	int stepLocalSearch(std::vector<float>& weights, double& loss) {
+		int changed = 0;
+		for (int i = 0; i < N_EVAL_PARAMETERS; i++) {
+			if (occurrences[i] == 0) continue;
+			for (int delta : { 1, -1 }) {
+				weights[i] += delta;
+				double trial = getLoss(weights);
+				if (trial < loss) {
+					loss = trial;
+					changed++;
+					break;
+				}
+				weights[i] -= delta;
+			}
+		}
+		return changed;
+	}
+
+	static EvalParameters getParameters(const std::vector<float>& weights) {
+		EvalParameters parameters;
+		for (int i = 0; i < N_EVAL_PARAMETERS; i++)
+			parameters.getValues()[i] = (int)std::lround(weights[i]);
+		return parameters;
+	}
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <cstdint>
+
+#include "index_model/piece.h"
+
+class ZobristKeys {
+
+	uint64_t seed = 0x9E3779B97F4A7C15ULL;
+
+	uint64_t nextRandom() { //xorshift64*, fixed seed so keys are equal between runs
+		seed ^= seed >> 12;
+		seed ^= seed << 25;
+		seed ^= seed >> 27;
+		return seed * 0x2545F4914F6CDD1DULL;
+	}
+
+public:
+	uint64_t pieceKeys[2][7][64];
+	uint64_t sideKey;
+	uint64_t castleKeys[16];
+	uint64_t epKeys[8];
+
+	ZobristKeys() {
+		for (int color = 0; color < 2; color++)
+			for (int type = 0; type < 7; type++)
+				for (int square = 0; square < 64; square++)
+					pieceKeys[color][type][square] = type == EMPTY ? 0 : nextRandom();
+		sideKey = nextRandom();
+		for (int i = 0; i < 16; i++)
+			castleKeys[i] = i == 0 ? 0 : nextRandom();
+		for (int i = 0; i < 8; i++)
+			epKeys[i] = nextRandom();
+	}
+
+	uint64_t getPieceKey(int color, int type, int square) const { return pieceKeys[color][type][square]; }
+};
+
+inline const ZobristKeys zobristKeys;
+
+#endif
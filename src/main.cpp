@@ -11,6 +11,8 @@
 #include <string>
 #include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
 #include <thread>
 
 #include "model/animation.h"
@@ -21,8 +23,14 @@
 
 #include "index_model/board.h"
 #include "index_model/move.h"
+#include "index_model/game_analysis.h"
+#include "index_model/bench.h"
+#include "index_model/notation.h"
+
+#include "server/client_session.h"
 
 #include "util/camera.h"
+#include "util/logger.h"
 #include "util/shader.h"
 #include "util/model.h"
 #include "util/read_files.h"
@@ -38,6 +46,16 @@ void processInput(GLFWwindow* window);
 void configureShader(Shader& shader, glm::mat4& projection, glm::mat4& view);
 void processMenuEvent(GLFWwindow* window);
 void updateGameEnding(int gameEnding);
+void startGameAnalysis();
+void updateGameAnalysis();
+void updateAnalysisText();
+std::string getStatisticsText(const SearchStatistics& statistics);
+void jumpToPly(int ply);
+void updatePlyText();
+const MoveLookup& getPlayableMoves();
+void sendNetworkMove(Move move);
+void updateNetworkSession();
+void updateNetworkText();
 
 int SCR_WIDTH;
 int SCR_HEIGHT;
@@ -53,15 +71,34 @@ float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
 std::map<int, bool> pressedKeys;
-std::array<int, 3> keysUsedInProgram = { GLFW_KEY_C };
+std::array<int, 4> keysUsedInProgram = { GLFW_KEY_C, GLFW_KEY_I, GLFW_KEY_HOME, GLFW_KEY_END };
+const float FAST_SCROLL_DELAY = 0.35f; // Seconds an arrow key is held before it starts repeating
+const float FAST_SCROLL_RATE = 30.0f;  // Plies per second while repeating
+const char* ANALYSIS_CACHE_PATH = "analysis_cache.bin"; // Search results kept between sessions
+const char* EVAL_PARAMETERS_PATH = "eval.txt"; // Evaluation weights written by chess-tune, loaded if present
+float arrowHeldTime = 0.0f;
+int scrolledPlies = 0;
 
 ChessNameStore chessNameStore;
 ChessBoardModel chessModel;
 ChessBoardIndex chessIndex;
+GameAnalyzer gameAnalyzer;
+AnalysisCache analysisCache;
+std::thread analysisThread;
+bool analysisRunning = false;
+bool showAnalysis = false;
+bool showSearchStatistics = false;
+bool showBestLine = false; // Show Best Move, the whole principal variation instead of the first move
+
+NetworkSession networkSession;
+MoveLookup noPlayableMoves; // Given to the board model while the player may not move in a network game
+int networkSide = WHITE;
+int networkDepth = DEFAULT_ENGINE_DEPTH;
+int networkTextID = -1;
 
 ItemMenu rightButtonMenu, leftButtonMenu;
 int evaluationTextID, lastMoveTextID, sideToMoveTextID, depthTextID, moveTextID, blackTextButtonID, 
-    whiteTextButtonID, moveTextButtonID, quitButtonID, resetBoardID, flipBoardID, goBackMoveID, goForthMoveID;
+    whiteTextButtonID, moveTextButtonID, quitButtonID, resetBoardID, flipBoardID, goBackMoveID, goForthMoveID, analyzeGameID, switchVariationID, plyTextID;
 TextRenderer textRenderer;
 
 const char* sideToMoveText[2] = { "Black to Move", "White to Move" };
@@ -74,7 +111,37 @@ std::array<glm::vec3, 4> pointLightPositions = {
     glm::vec3(-6.0f,  2.0f, -6.0f)
 };
 
-int main() {
+int main(int argc, char** argv) {
+
+    // --bench [depth] prints the node signature of the bench positions and exits without a window
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        runBench(argc > 2 ? std::atoi(argv[2]) : BENCH_DEPTH, &std::cout);
+        return 0;
+    }
+    // --log <path> writes log records to a file instead of stderr. --server <host:port|socket path> plays
+    // against a chess-server as --side white|black, its engine searching --depth plies. --cache <path>
+    // moves the persistent analysis cache, an empty path turns it off. --eval <path> loads evaluation
+    // weights from another parameter file than eval.txt
+    std::string serverAddress;
+    std::string cachePath = ANALYSIS_CACHE_PATH;
+    std::string evalPath = EVAL_PARAMETERS_PATH;
+    bool hasEvalOption = false;
+    for (int i = 1; i + 1 < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--log") Logger::get().setOutputFile(argv[++i]);
+        else if (option == "--server") serverAddress = argv[++i];
+        else if (option == "--side") networkSide = std::string(argv[++i]) == "black" ? BLACK : WHITE;
+        else if (option == "--depth") networkDepth = std::max(1, std::min(std::atoi(argv[++i]), MAX_ENGINE_DEPTH));
+        else if (option == "--cache") cachePath = argv[++i];
+        else if (option == "--eval") {
+            evalPath = argv[++i];
+            hasEvalOption = true;
+        }
+    }
+    if (getEvalParameters().load(evalPath)) LOG_INFO("Evaluation parameters loaded from %s", evalPath.c_str());
+    else if (hasEvalOption) LOG_ERROR("Failed to load evaluation parameters from %s", evalPath.c_str());
+    if (!cachePath.empty() && analysisCache.open(cachePath))
+        gameAnalyzer.setAnalysisCache(&analysisCache);
 
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -88,7 +155,7 @@ int main() {
 
     GLFWmonitor* primaryMonitor = glfwGetPrimaryMonitor();
     if (primaryMonitor == nullptr) {
-        std::cerr << "Failed to get primary monitor" << std::endl;
+        LOG_ERROR("Failed to get primary monitor");
         glfwTerminate();
         return -1;
     }
@@ -100,7 +167,7 @@ int main() {
 
     GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Chess 3D", NULL, NULL);
     if (window == NULL) {
-        std::cout << "Failed to create GLFW window" << std::endl;
+        LOG_ERROR("Failed to create GLFW window");
         glfwTerminate();
         return -1;
     }
@@ -111,7 +178,7 @@ int main() {
     glfwSetScrollCallback(window, scroll_callback);
 
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        std::cout << "Failed to initialize GLAD" << std::endl;
+        LOG_ERROR("Failed to initialize GLAD");
         return -1;
     }
 
@@ -134,7 +201,7 @@ int main() {
 
     chessIndex.changeBoardState("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
     chessModel.initialize(chessBoardVAO, SCR_WIDTH, SCR_HEIGHT);
-    chessModel.updateGameData(chessIndex.mailbox, chessIndex.availableMoves, chessIndex.sideToMove);
+    chessModel.updateGameData(chessIndex.mailbox, getPlayableMoves(), chessIndex.sideToMove);
 
     leftButtonMenu = ItemMenu(3, 6, glm::vec3(-5.3f, 6.0f, 2.0f), -15.0f, SCR_WIDTH, SCR_HEIGHT);
     sideToMoveTextID =  leftButtonMenu.addItem(TEXT, 0.0f, -0.7f, 2.8f, 0.5f, sideToMoveText[WHITE], false, ORANGE, 0.9f);
@@ -150,10 +217,21 @@ int main() {
     lastMoveTextID =    rightButtonMenu.addItem(TEXT, 0.1f, -0.6f, 2.8f, 0.5f, "Last Move: ---", false, GREY, 0.9f);
     goBackMoveID =      rightButtonMenu.addItem(ICON_BUTTON, -0.35f, -0.35f, 0.5f, 0.5f, "src/resources/textures/leftArrow.png", true, LIGHT_GREY, 1.0f);
     goForthMoveID =     rightButtonMenu.addItem(ICON_BUTTON, 0.35f, -0.35f, 0.5f, 0.5f, "src/resources/textures/rightArrow.png", true, LIGHT_GREY, 1.0f);
+    plyTextID =         rightButtonMenu.addItem(TEXT, 0.0f, -0.35f, 0.5f, 0.5f, "0/0", true, LIGHT_GREY, 1.0f);
+    switchVariationID = rightButtonMenu.addItem(TEXT_BUTTON, 0.0f, -0.15f, 1.5f, 0.5f, "Next Variation", true, LIGHT_GREY, 1.0f);
+    analyzeGameID =     rightButtonMenu.addItem(TEXT_BUTTON, 0.0f, 0.05f, 1.5f, 0.5f, "Analyze Game", true, LIGHT_GREY, 1.0f);
     moveTextButtonID =  rightButtonMenu.addItem(TEXT_BUTTON, 0.0f, 0.25f, 1.5f, 0.5f, "Show Best Move", true, LIGHT_GREY, 1.0f);
     flipBoardID =       rightButtonMenu.addItem(TEXT_BUTTON, 0.0f, 0.45f, 1.5f, 0.5f, "Flip Board", true, LIGHT_GREY, 1.0f);
     resetBoardID =      rightButtonMenu.addItem(TEXT_BUTTON, 0.0f, 0.75f, 1.5f, 0.5f, "Reset Board", true, LIGHT_GREY, 1.0f);
 
+    if (!serverAddress.empty()) {
+        networkTextID = leftButtonMenu.addItem(TEXT, 0.0f, 0.0f, 2.8f, 0.5f, "Server: connecting", false, LIGHT_GREY, 0.3f);
+        if (networkSession.connect(serverAddress))
+            networkSession.startGame(networkSide, networkDepth);
+        chessModel.updateAvailableMoves(getPlayableMoves());
+        updateNetworkText();
+    }
+
     textRenderer.initializeFont("src/resources/fonts/Antonio-Regular.ttf");
 
     standardLightShader.use();
@@ -167,6 +245,8 @@ int main() {
         std::this_thread::sleep_for(std::chrono::milliseconds(std::max((int)((1.0f / FPS - deltaTime) * 1000), 0)));
        
         processInput(window);
+        updateGameAnalysis();
+        updateNetworkSession();
 
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -187,6 +267,8 @@ int main() {
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
+    if (analysisThread.joinable())
+        analysisThread.join();
     glfwTerminate();
     return 0;
 }
@@ -244,6 +326,39 @@ void processInput(GLFWwindow* window) {
         glfwSetInputMode(window, GLFW_CURSOR, freeCameraFlight ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL);
     }
 
+    if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS && !pressedKeys[GLFW_KEY_I]) {
+        pressedKeys[GLFW_KEY_I] = true;
+        showSearchStatistics ^= 1;
+        updateAnalysisText();
+    }
+
+    // Left and right step through the line, repeating quickly while held, Home and End jump to its ends
+    int arrowDirection = (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) - (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS);
+    if (arrowDirection == 0)
+        arrowHeldTime = 0.0f;
+    else {
+        float previousHeldTime = arrowHeldTime;
+        arrowHeldTime += deltaTime;
+        int steps = previousHeldTime == 0.0f ? 1 : 0;
+        if (arrowHeldTime > FAST_SCROLL_DELAY)
+            steps += (int)((arrowHeldTime - FAST_SCROLL_DELAY) * FAST_SCROLL_RATE) -
+                (int)(std::max(0.0f, previousHeldTime - FAST_SCROLL_DELAY) * FAST_SCROLL_RATE);
+        if (steps > 0)
+            jumpToPly(chessIndex.gameTree.getPly() + arrowDirection * steps);
+    }
+    if (scrolledPlies != 0) {
+        jumpToPly(chessIndex.gameTree.getPly() + scrolledPlies);
+        scrolledPlies = 0;
+    }
+    if (glfwGetKey(window, GLFW_KEY_HOME) == GLFW_PRESS && !pressedKeys[GLFW_KEY_HOME]) {
+        pressedKeys[GLFW_KEY_HOME] = true;
+        jumpToPly(0);
+    }
+    if (glfwGetKey(window, GLFW_KEY_END) == GLFW_PRESS && !pressedKeys[GLFW_KEY_END]) {
+        pressedKeys[GLFW_KEY_END] = true;
+        jumpToPly(chessIndex.gameTree.getLineLength());
+    }
+
     for (int& key : keysUsedInProgram)
         if (glfwGetKey(window, key) == GLFW_RELEASE)
             pressedKeys[key] = false;
@@ -304,18 +419,21 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
             if (gameEnding) updateGameEnding(gameEnding);
             else leftButtonMenu.updateItemText(sideToMoveTextID, sideToMoveText[chessIndex.sideToMove]);
 
-            chessIndex.madeMoves.maxMadeMoves = chessIndex.madeMoves.nMadeMoves;
+            showAnalysis = false;
             if (chessIndex.promotedPawnSquare != -1)
                 chessModel.isPromotingPawn = true;
 
-            chessModel.doMove(move, chessIndex.mailbox);
-            chessModel.updateAvailableMoves(chessIndex.availableMoves);
+            chessModel.doMove(move, chessIndex.mailbox); // Shown right away, taken back if the server rejects it
+            if (chessIndex.promotedPawnSquare == -1) sendNetworkMove(move);
+            chessModel.updateAvailableMoves(getPlayableMoves());
+            updatePlyText();
         } 
         else if (moveInfo.second != -1) { //Pawn promotion has been selected
             chessModel.updatePromotion(chessIndex.promotedPawnSquare, moveInfo.second);
             int gameEnding = chessIndex.updatePromotion(moveInfo.second);
             if (gameEnding) updateGameEnding(gameEnding);
-            chessModel.updateAvailableMoves(chessIndex.availableMoves);
+            sendNetworkMove(chessIndex.gameTree.getLastMove().move);
+            chessModel.updateAvailableMoves(getPlayableMoves());
         }
     }
 }
@@ -327,7 +445,7 @@ void updateGameEnding(int gameEnding) {
         else gameEndingDesc += "White wins";
     }
     leftButtonMenu.updateItemText(sideToMoveTextID, gameEndingDesc);
-    chessIndex.availableMoves.resetMoves();
+    chessIndex.clearAvailableMoves();
 }
 
 void processMenuEvent(GLFWwindow* window) {
@@ -336,24 +454,46 @@ void processMenuEvent(GLFWwindow* window) {
 
         if (ID == moveTextButtonID) {
             rightButtonMenu.invertTextButtonColor(ID, GREEN, LIGHT_GREY);
+            showBestLine = !showBestLine;
+            updateAnalysisText();
         }
         else if (ID == goBackMoveID) {
-            chessIndex.unmakeLastMove(true);
+            chessIndex.unmakeLastMove();
             leftButtonMenu.updateItemText(sideToMoveTextID, sideToMoveText[chessIndex.sideToMove]);
-            chessModel.updateGameData(chessIndex.mailbox, chessIndex.availableMoves, chessIndex.sideToMove);
+            chessModel.updateGameData(chessIndex.mailbox, getPlayableMoves(), chessIndex.sideToMove);
+            updateAnalysisText();
+            updatePlyText();
         }
         else if (ID == goForthMoveID) {
             chessIndex.goForthMadeMoves();
             leftButtonMenu.updateItemText(sideToMoveTextID, sideToMoveText[chessIndex.sideToMove]);
-            chessModel.updateGameData(chessIndex.mailbox, chessIndex.availableMoves, chessIndex.sideToMove);
+            chessModel.updateGameData(chessIndex.mailbox, getPlayableMoves(), chessIndex.sideToMove);
+            updateAnalysisText();
+            updatePlyText();
+        }
+        else if (ID == switchVariationID) {
+            int gameEnding = chessIndex.switchVariation();
+            showAnalysis = false;
+            chessModel.updateGameData(chessIndex.mailbox, getPlayableMoves(), chessIndex.sideToMove);
+            if (gameEnding) updateGameEnding(gameEnding);
+            else leftButtonMenu.updateItemText(sideToMoveTextID, sideToMoveText[chessIndex.sideToMove]);
+            updatePlyText();
+        }
+        else if (ID == analyzeGameID) {
+            startGameAnalysis();
         }
         else if (ID == flipBoardID) {
             chessModel.doFlipBoardAnimation();
         }
         else if (ID == resetBoardID) {
             leftButtonMenu.updateItemText(sideToMoveTextID, sideToMoveText[WHITE]);
+            showAnalysis = false;
             chessIndex.changeBoardState("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
-            chessModel.updateGameData(chessIndex.mailbox, chessIndex.availableMoves, chessIndex.sideToMove);
+            if (networkSession.state == SESSION_CLOSED) networkSession.close(); // Play locally from now on
+            else if (networkSession.state != SESSION_OFFLINE) networkSession.startGame(networkSide, networkDepth);
+            chessModel.updateGameData(chessIndex.mailbox, getPlayableMoves(), chessIndex.sideToMove);
+            updatePlyText();
+            updateNetworkText();
         }
     }
     else if (leftButtonMenu.getHoveredItemID() != -1) {
@@ -370,6 +510,177 @@ void processMenuEvent(GLFWwindow* window) {
     }
 }
 
+void startGameAnalysis() {
+    if (analysisRunning || chessIndex.promotedPawnSquare != -1)
+        return;
+
+    std::vector<Move> moves = chessIndex.gameTree.getLineMoves();
+    if (moves.empty())
+        return;
+
+    analysisRunning = true;
+    showAnalysis = false;
+    gameAnalyzer.finished = false;
+    gameAnalyzer.positionCount = (int)moves.size() + 1;
+    analysisThread = std::thread(&GameAnalyzer::analyzeGame, &gameAnalyzer, chessIndex.initialState, moves, ANALYSIS_DEPTH, 0);
+}
+
+void updateGameAnalysis() {
+    if (!analysisRunning)
+        return;
+
+    if (!gameAnalyzer.finished) {
+        rightButtonMenu.updateItemText(analyzeGameID, "Analyzing " + std::to_string(gameAnalyzer.analyzedPositions) + 
+            "/" + std::to_string(gameAnalyzer.getPositionCount()));
+        return;
+    }
+    analysisThread.join();
+    analysisRunning = false;
+    showAnalysis = true;
+    gameAnalyzer.writeAnnotatedPGN("analysis.pgn");
+    gameAnalyzer.writeStatisticsLog("search_stats.jsonl");
+    rightButtonMenu.updateItemText(analyzeGameID, "Analyze Game");
+    updateAnalysisText();
+}
+
+// Shows the annotation of the move leading to the current position of the analyzed game
+void updateAnalysisText() {
+    int ply = chessIndex.gameTree.getPly();
+    if (!showAnalysis || ply >= (int)gameAnalyzer.positionEvaluations.size())
+        return;
+
+    leftButtonMenu.updateItemText(evaluationTextID, "Evaluation: " + formatEvaluation(gameAnalyzer.positionEvaluations[ply]));
+    std::string depthText = "Depth: " + std::to_string(gameAnalyzer.analysisDepth);
+    if (showSearchStatistics)
+        depthText += "  " + getStatisticsText(gameAnalyzer.positionStatistics[ply]);
+    leftButtonMenu.updateItemText(depthTextID, depthText);
+    if (ply < (int)gameAnalyzer.annotations.size())
+        leftButtonMenu.updateItemText(moveTextID, "Move: " + (showBestLine ? gameAnalyzer.annotations[ply].bestLineSan :
+            gameAnalyzer.annotations[ply].bestMoveSan));
+    else
+        leftButtonMenu.updateItemText(moveTextID, "Move: --");
+    if (ply > 0)
+        rightButtonMenu.updateItemText(lastMoveTextID, "Last Move: " + gameAnalyzer.getMoveText(ply - 1));
+    else
+        rightButtonMenu.updateItemText(lastMoveTextID, "Last Move: ---");
+}
+
+// Overlay next to the depth label, toggled with I
+std::string getStatisticsText(const SearchStatistics& statistics) {
+    char text[128];
+    snprintf(text, sizeof(text), "Sel: %d  Nodes: %lld  NPS: %lldk  EBF: %.1f  TT: %.0f%%  1st cut: %.0f%%",
+        statistics.selDepth, statistics.nodes, statistics.getNPS() / 1000, statistics.getBranchingFactor(),
+        statistics.getTTHitRate() * 100.0, statistics.getFirstMoveCutoffRate() * 100.0);
+    return text;
+}
+
+// Scrubs through the current line, the jump is made once per frame however many steps were scrolled
+void jumpToPly(int ply) {
+    ply = std::max(0, std::min(ply, chessIndex.gameTree.getLineLength()));
+    if (ply == chessIndex.gameTree.getPly() || chessIndex.promotedPawnSquare != -1)
+        return;
+
+    int gameEnding = chessIndex.goToPly(ply);
+    chessModel.updateGameData(chessIndex.mailbox, getPlayableMoves(), chessIndex.sideToMove);
+    if (gameEnding) updateGameEnding(gameEnding);
+    else leftButtonMenu.updateItemText(sideToMoveTextID, sideToMoveText[chessIndex.sideToMove]);
+    updateAnalysisText();
+    updatePlyText();
+}
+
+void updatePlyText() {
+    rightButtonMenu.updateItemText(plyTextID, std::to_string(chessIndex.gameTree.getPly()) + "/" + 
+        std::to_string(chessIndex.gameTree.getLineLength()));
+}
+
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
     //camera.ProcessMouseScroll(static_cast<float>(yoffset));
-}
\ No newline at end of file
+    if (!freeCameraFlight && yoffset != 0.0)
+        scrolledPlies += yoffset > 0.0 ? -1 : 1;
+}
+
+// In a network game the player moves only their own side, at the end of the game and not while a move is
+// waiting for the server
+const MoveLookup& getPlayableMoves() {
+    if (networkSession.state == SESSION_OFFLINE)
+        return chessIndex.getMoveLookup();
+    if (!networkSession.isPlaying() || networkSession.hasPendingMove() || chessIndex.sideToMove != networkSession.side ||
+        chessIndex.gameTree.getPly() != chessIndex.gameTree.getLineLength())
+        return noPlayableMoves;
+    return chessIndex.getMoveLookup();
+}
+
+void sendNetworkMove(Move move) {
+    if (networkSession.isPlaying())
+        networkSession.sendMove(getMoveUCI(move));
+}
+
+// Called every frame. Replies are applied once the last move has finished sliding, moves of the server are
+// played from the end of the game even when the player is looking at an earlier position
+void updateNetworkSession() {
+    if (networkSession.state == SESSION_OFFLINE)
+        return;
+    int state = networkSession.state;
+    networkSession.poll();
+    if (state != networkSession.state)
+        updateNetworkText();
+    if (chessModel.isAnimatingMove() || chessModel.isPromotingPawn)
+        return;
+
+    SessionEvent event;
+    while (networkSession.nextEvent(event)) {
+        if (event.type == SESSION_OPPONENT_MOVE) {
+            chessIndex.goToPly(chessIndex.gameTree.getLineLength());
+            Move move = parseMoveUCI(chessIndex, event.move);
+            if (move == Move()) {
+                LOG_ERROR("Server sent the impossible move %s", event.move.c_str());
+                networkSession.disconnect("closed after an impossible move");
+                continue;
+            }
+            chessModel.updateGameData(chessIndex.mailbox, getPlayableMoves(), chessIndex.sideToMove);
+            int gameEnding = chessIndex.makeMove(move);
+            if (gameEnding) updateGameEnding(gameEnding);
+            else leftButtonMenu.updateItemText(sideToMoveTextID, sideToMoveText[chessIndex.sideToMove]);
+            if (move.isPromotion()) chessModel.updateGameData(chessIndex.mailbox, getPlayableMoves(), chessIndex.sideToMove);
+            else chessModel.doAnimatedMove(move, chessIndex.mailbox);
+            showAnalysis = false;
+            updatePlyText();
+        }
+        else if (event.type == SESSION_MOVE_REJECTED) {
+            LOG_WARNING("Server rejected %s, taking it back", event.move.c_str());
+            chessIndex.goToPly(chessIndex.gameTree.getLineLength());
+            chessIndex.takeBackLastMove();
+            chessModel.updateGameData(chessIndex.mailbox, getPlayableMoves(), chessIndex.sideToMove);
+            leftButtonMenu.updateItemText(sideToMoveTextID, sideToMoveText[chessIndex.sideToMove]);
+            updatePlyText();
+        }
+        updateNetworkText();
+        if (chessModel.isAnimatingMove())
+            break;
+    }
+    chessModel.updateAvailableMoves(getPlayableMoves());
+}
+
+// Connection state, game and the time the server takes to confirm a move, in the left menu
+void updateNetworkText() {
+    if (networkTextID == -1)
+        return;
+    char text[160];
+    const LatencyStatistics& latency = networkSession.latency;
+    if (networkSession.state == SESSION_CONNECTING)
+        snprintf(text, sizeof(text), "Server: connecting");
+    else if (networkSession.state == SESSION_CLOSED)
+        snprintf(text, sizeof(text), "Server: disconnected, Reset Board to play locally");
+    else if (networkSession.state == SESSION_OFFLINE)
+        snprintf(text, sizeof(text), "Local game");
+    else if (!networkSession.isPlaying() && networkSession.endReason.empty())
+        snprintf(text, sizeof(text), "Server: starting a game");
+    else if (!networkSession.isPlaying())
+        snprintf(text, sizeof(text), "Server: game over (%s), Reset Board for a new one", networkSession.endReason.c_str());
+    else if (latency.count == 0)
+        snprintf(text, sizeof(text), "Server game %u", networkSession.gameId);
+    else
+        snprintf(text, sizeof(text), "Server game %u  Ping: %.1f ms  Avg: %.1f  p99: %.1f  Max: %.1f", networkSession.gameId,
+            latency.last, latency.getAverage(), latency.getPercentile(0.99), latency.max);
+    leftButtonMenu.updateItemText(networkTextID, text);
+}
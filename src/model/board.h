@@ -10,7 +10,6 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <vector>
-#include <bitset>
 
 #include "model/piece.h"
 #include "model/world_object.h"
@@ -50,7 +49,7 @@ class ChessBoardModel {
 
 public:
     PieceModel piecesOnBoard[64];
-    std::bitset<64> availableMoves[64];
+    const MoveLookup* legalMoves = nullptr; // Owned by the index board, filled once per position
     int sideToMove;
     int selectedPieceSquare = -1;
     bool isPromotingPawn = false;
@@ -90,7 +89,7 @@ public:
         selectedSquareIndicatorShader.setInt("diffuseMap", 0);
     }
 
-    void updateGameData(Mailbox& mailbox, ChessMoves& generatedMoves, bool sideToMove) {
+    void updateGameData(Mailbox& mailbox, const MoveLookup& moveLookup, bool sideToMove) {
         for (int i = 0; i < 64; i++) {
             if (mailbox[i].getType() != EMPTY) {
 
@@ -105,15 +104,15 @@ public:
         selectedPieceSquare = -1;
         isPromotingPawn = false;
 
-        updateAvailableMoves(generatedMoves);
+        updateAvailableMoves(moveLookup);
     }
 
-    void updateAvailableMoves(ChessMoves& generatedMoves) {
-        for (int i = 0; i < 64; i++)
-            availableMoves[i].reset();
-        for (int i = 0; i < generatedMoves.nMoves; i++) {
-            availableMoves[generatedMoves[i].getFrom()][generatedMoves[i].getTo()] = 1;
-        }
+    void updateAvailableMoves(const MoveLookup& moveLookup) {
+        legalMoves = &moveLookup;
+    }
+
+    bool isAvailableMove(int fromSquare, int toSquare) {
+        return legalMoves && legalMoves->isLegal(fromSquare, toSquare);
     }
 
     int getClickedSquare(int clickedScreenX, int clickedScreenY, glm::mat4& projection, glm::mat4& view) {
@@ -149,7 +148,7 @@ public:
 
             // If piece of same color as already selected piece is clicked
             if (piecesOnBoard[square].drawn && (piecesOnBoard[square].color == sideToMove) &&
-                (selectedPieceSquare == -1 || !availableMoves[selectedPieceSquare][square])) {
+                (selectedPieceSquare == -1 || !isAvailableMove(selectedPieceSquare, square))) {
 
                 selectedPieceSquare = square;
                 piecesOnBoard[square].followingMouse = true;
@@ -161,7 +160,7 @@ public:
                 return { -1, -1 };
 
             // If none of the above and the requested move is possible, animate a move to given square
-            if (availableMoves[selectedPieceSquare][square]) {
+            if (isAvailableMove(selectedPieceSquare, square)) {
                 animateMove = true;
                 return { selectedPieceSquare, square };
             }
@@ -178,7 +177,7 @@ public:
 
         piecesOnBoard[selectedPieceSquare].followingMouse = false;
 
-        if (square != -1 && availableMoves[selectedPieceSquare][square]) {
+        if (square != -1 && isAvailableMove(selectedPieceSquare, square)) {
             animateMove = false;
             return { selectedPieceSquare, square };
         }
@@ -217,6 +216,19 @@ public:
             sideToMove ^= WHITE;
     }
     
+    // Slides a move that was not made with the mouse, such as the opponent's move in a network game
+    void doAnimatedMove(Move move, Mailbox& mailbox) {
+        animateMove = true;
+        selectedPieceSquare = move.getFrom();
+        doMove(move, mailbox);
+    }
+
+    bool isAnimatingMove() {
+        for (int i = 0; i < 64; i++)
+            if (piecesOnBoard[i].movingToSquare != -1) return true;
+        return false;
+    }
+
     void finishMove(int fromPos, int toPos) {
         piecesOnBoard[fromPos].drawn = false;
         piecesOnBoard[toPos].drawn = true;
@@ -262,7 +274,7 @@ public:
             selectedSquareIndicatorShader.setVec3("color", glm::vec3(0.1f, 0.4f, 1.0f));
             selectedSquareIndicatorShader.setFloat("alpha", 0.3f);
             for (int i = 0; i < 64; i++)
-                if (availableMoves[selectedPieceSquare][i]) {
+                if (isAvailableMove(selectedPieceSquare, i)) {
 
                     glm::mat4 model(1.0f);
                     model = glm::rotate(model, glm::radians(180.0f * isFlipped + animationRotation), glm::vec3(0.0f, 1.0f, 0.0f));
@@ -0,0 +1,356 @@
+#ifndef ANALYSIS_POOL_H
+#define ANALYSIS_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "index_model/analysis_cache.h"
+#include "index_model/board.h"
+#include "index_model/epd.h"
+#include "index_model/move.h"
+#include "index_model/search.h"
+#include "index_model/transposition.h"
+
+#define ANALYSIS_PRIORITY_LOW 0
+#define ANALYSIS_PRIORITY_NORMAL 1
+#define ANALYSIS_PRIORITY_HIGH 2
+
+const int ANALYSIS_PRIORITIES = 3;
+const int ANALYSIS_TIMING_WINDOW = 4096; // Recent jobs the latency percentiles are taken over
+
+using AnalysisClock = std::chrono::steady_clock;
+
+struct AnalysisJob {
+	std::string tag;  // Name chosen by the submitter, returned with the result
+	std::string fen;
+	SearchLimits limits;
+	int priority = ANALYSIS_PRIORITY_NORMAL;
+	uint64_t client = 0; // Connection of the socket front-end that submitted it
+	uint64_t id = 0;  // Set by submit
+	AnalysisClock::time_point submitted;
+};
+
+struct AnalysisResult {
+	std::string tag;
+	uint64_t client = 0;
+	uint64_t id = 0;
+	bool valid = false; // False when the FEN could not be read
+	Move bestMove;
+	int score = 0;      // Centipawns from the side to move
+	int depth = 0;
+	long long nodes = 0;
+	std::vector<Move> pv;
+	double queueMilliseconds = 0.0;
+	double searchMilliseconds = 0.0;
+	bool stolen = false; // Run by another worker than the one it was queued on
+};
+
+// Checks a FEN before it reaches changeBoardState, which trusts its input: eight ranks of eight squares,
+// one king per side, no pawns on the back ranks and well formed side, castling, en passant and clocks
+inline bool isValidFEN(const std::string& fen) {
+	std::istringstream fields(fen);
+	std::string placement, side, castling, enPassant, clock;
+	if (!(fields >> placement >> side >> castling >> enPassant))
+		return false;
+	int rank = 0, file = 0, whiteKings = 0, blackKings = 0;
+	for (char c : placement) {
+		if (c == '/') {
+			if (file != 8 || ++rank > 7) return false;
+			file = 0;
+		}
+		else if (c >= '1' && c <= '8') file += c - '0';
+		else if (std::string("pnbrqkPNBRQK").find(c) != std::string::npos) {
+			if ((c == 'p' || c == 'P') && (rank == 0 || rank == 7)) return false;
+			whiteKings += c == 'K';
+			blackKings += c == 'k';
+			file++;
+		}
+		else return false;
+		if (file > 8) return false;
+	}
+	if (rank != 7 || file != 8 || whiteKings != 1 || blackKings != 1) return false;
+	if (side != "w" && side != "b") return false;
+	if (castling != "-" && castling.find_first_not_of("KQkq") != std::string::npos) return false;
+	if (enPassant != "-" && (enPassant.size() != 2 || enPassant[0] < 'a' || enPassant[0] > 'h'
+		|| (enPassant[1] != '3' && enPassant[1] != '6')))
+		return false;
+	while (fields >> clock)
+		if (clock.find_first_not_of("0123456789") != std::string::npos || clock.size() > 5) return false;
+	return true;
+}
+
+// Recent samples for percentiles, and totals since the start
+struct TimingWindow {
+	std::vector<float> recent;
+	int next = 0;
+	double total = 0.0;
+	double max = 0.0;
+	long long count = 0;
+
+	void add(double milliseconds) {
+		if ((int)recent.size() < ANALYSIS_TIMING_WINDOW) recent.push_back((float)milliseconds);
+		else recent[next] = (float)milliseconds;
+		next = (next + 1) % ANALYSIS_TIMING_WINDOW;
+		total += milliseconds;
+		max = std::max(max, milliseconds);
+		count++;
+	}
+
+	double getAverage() const { return count ? total / count : 0.0; }
+
+	double getPercentile(double percentile) const {
+		if (recent.empty()) return 0.0;
+		std::vector<float> sorted = recent;
+		size_t index = std::min(sorted.size() - 1, (size_t)(sorted.size() * percentile));
+		std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+		return sorted[index];
+	}
+};
+
+struct AnalysisMetrics {
+	long long submitted = 0;
+	long long completed = 0;
+	long long invalid = 0;
+	long long stolen = 0;
+	long long nodes = 0;
+	int queued = 0;
+	double seconds = 0.0; // Since the pool started
+	TimingWindow queueTime;
+	TimingWindow searchTime;
+
+	double getJobsPerSecond() const { return seconds > 0.0 ? completed / seconds : 0.0; }
+	double getNodesPerSecond() const { return seconds > 0.0 ? nodes / seconds : 0.0; }
+};
+
+inline std::string formatAnalysisMetrics(const AnalysisMetrics& metrics) {
+	std::ostringstream text;
+	text.setf(std::ios::fixed);
+	text.precision(2);
+	text << "jobs " << metrics.completed << " queued " << metrics.queued << " invalid " << metrics.invalid
+		<< " stolen " << metrics.stolen << " jobs/s " << metrics.getJobsPerSecond()
+		<< " knps " << metrics.getNodesPerSecond() / 1000.0
+		<< " queue_ms p50 " << metrics.queueTime.getPercentile(0.5) << " p99 " << metrics.queueTime.getPercentile(0.99)
+		<< " max " << metrics.queueTime.max
+		<< " search_ms p50 " << metrics.searchTime.getPercentile(0.5) << " p99 " << metrics.searchTime.getPercentile(0.99);
+	return text.str();
+}
+
+// Runs many short searches at once. Every worker owns a queue with one deque per priority and its own
+// searcher, and all of them share one transposition table. Submitted jobs are spread over the queues
+// round robin. A worker takes the oldest job of the highest priority it can find, from its own queue
+// first and otherwise from another worker's, so no worker idles while a job is waiting and higher
+// priorities always go first. Finished results are collected like those of the EnginePool, an
+// eventfd tells a front-end's event loop that there are some
+class AnalysisPool {
+
+	struct WorkerQueue {
+		std::mutex mutex;
+		std::deque<AnalysisJob> jobs[ANALYSIS_PRIORITIES];
+		std::atomic<int> sizes[ANALYSIS_PRIORITIES]; // Read without the lock to skip empty queues
+		WorkerQueue() {
+			for (std::atomic<int>& size : sizes) size = 0;
+		}
+	};
+
+	TranspositionTable transpositionTable;
+	AnalysisCache* analysisCache;
+	std::vector<std::unique_ptr<WorkerQueue>> queues;
+	std::vector<std::thread> workers;
+	std::atomic<uint32_t> nextQueue{ 0 };
+	std::atomic<uint64_t> nextId{ 1 };
+
+	std::mutex sleepMutex;
+	std::condition_variable jobsReady;
+	std::condition_variable jobsDone;
+	std::atomic<int> queuedJobs{ 0 };
+	int runningJobs = 0; // Guarded by sleepMutex
+	bool stopping = false;
+
+	std::mutex resultsMutex;
+	std::vector<AnalysisResult> results;
+	AnalysisMetrics metrics; // Guarded by resultsMutex
+	AnalysisClock::time_point started = AnalysisClock::now();
+	int notifyFd = -1;
+
+	bool takeFrom(WorkerQueue& queue, int priority, AnalysisJob& job) {
+		if (queue.sizes[priority].load(std::memory_order_relaxed) == 0) return false;
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		std::deque<AnalysisJob>& jobs = queue.jobs[priority];
+		if (jobs.empty()) return false;
+		job = std::move(jobs.front());
+		jobs.pop_front();
+		queue.sizes[priority]--;
+		return true;
+	}
+
+	bool findJob(int worker, AnalysisJob& job, bool& stolen) {
+		int nQueues = (int)queues.size();
+		for (int priority = ANALYSIS_PRIORITIES - 1; priority >= 0; priority--) {
+			if (takeFrom(*queues[worker], priority, job)) {
+				stolen = false;
+				return true;
+			}
+			for (int i = 1; i < nQueues; i++)
+				if (takeFrom(*queues[(worker + i) % nQueues], priority, job)) {
+					stolen = true;
+					return true;
+				}
+		}
+		return false;
+	}
+
+	AnalysisResult runJob(Searcher& searcher, AnalysisJob& job) {
+		AnalysisResult result;
+		result.tag = std::move(job.tag);
+		result.client = job.client;
+		result.id = job.id;
+		AnalysisClock::time_point start = AnalysisClock::now();
+		result.queueMilliseconds = std::chrono::duration<double, std::milli>(start - job.submitted).count();
+		result.valid = isValidFEN(job.fen);
+		if (!result.valid) return result;
+
+		EPDRecord position; // Fills in missing clocks, which changeBoardState needs
+		parseEPD(job.fen, position);
+		std::vector<Move> noMoves;
+		searcher.setPosition(position.state, noMoves, 0);
+		SearchResult search = searcher.search(job.limits);
+		result.bestMove = search.bestMove;
+		result.score = search.score;
+		result.depth = search.depth;
+		result.nodes = search.nodes;
+		result.pv = search.principalVariation;
+		result.searchMilliseconds = std::chrono::duration<double, std::milli>(AnalysisClock::now() - start).count();
+		return result;
+	}
+
+	void work(int worker) {
+		std::unique_ptr<Searcher> searcher(new Searcher(transpositionTable));
+		searcher->setAnalysisCache(analysisCache);
+		while (true) {
+			AnalysisJob job;
+			bool stolen = false;
+			{
+				std::unique_lock<std::mutex> lock(sleepMutex);
+				jobsReady.wait(lock, [this]() { return stopping || queuedJobs > 0; });
+				if (stopping) return;
+				runningJobs++;
+			}
+			bool found = findJob(worker, job, stolen);
+			if (found) queuedJobs--;
+
+			if (found) {
+				AnalysisResult result = runJob(*searcher, job);
+				result.stolen = stolen;
+				{
+					std::lock_guard<std::mutex> lock(resultsMutex);
+					metrics.completed++;
+					metrics.invalid += !result.valid;
+					metrics.stolen += stolen;
+					metrics.nodes += result.nodes;
+					metrics.queueTime.add(result.queueMilliseconds);
+					metrics.searchTime.add(result.searchMilliseconds);
+					results.push_back(std::move(result));
+				}
+				uint64_t one = 1;
+				ssize_t written = write(notifyFd, &one, sizeof(one));
+				(void)written;
+			}
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				runningJobs--;
+			}
+			jobsDone.notify_all();
+		}
+	}
+
+public:
+
+	// The cache, if any, is shared by the workers like the transposition table and has to outlive the pool
+	AnalysisPool(int nThreads, int hashMB, AnalysisCache* cache = nullptr) : transpositionTable(hashMB), analysisCache(cache) {
+		notifyFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		nThreads = std::max(1, nThreads);
+		for (int i = 0; i < nThreads; i++)
+			queues.emplace_back(new WorkerQueue());
+		for (int i = 0; i < nThreads; i++)
+			workers.emplace_back(&AnalysisPool::work, this, i);
+	}
+
+	~AnalysisPool() {
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			stopping = true;
+		}
+		jobsReady.notify_all();
+		for (std::thread& worker : workers)
+			worker.join();
+		close(notifyFd);
+	}
+
+	int getNotifyFd() { return notifyFd; }
+	int getThreadCount() { return (int)workers.size(); }
+
+	// Returns the id given to the job
+	uint64_t submit(AnalysisJob&& job) {
+		job.id = nextId++;
+		job.submitted = AnalysisClock::now();
+		job.priority = std::max(0, std::min(ANALYSIS_PRIORITIES - 1, job.priority));
+		uint64_t id = job.id;
+		WorkerQueue& queue = *queues[nextQueue++ % queues.size()];
+		{
+			std::lock_guard<std::mutex> lock(resultsMutex);
+			metrics.submitted++;
+		}
+		{
+			// Counted before it is queued, a worker could otherwise take it and count it down first
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			queuedJobs++;
+		}
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.sizes[job.priority]++;
+			queue.jobs[job.priority].push_back(std::move(job));
+		}
+		jobsReady.notify_one();
+		return id;
+	}
+
+	// Swaps the finished results into the given vector, which is cleared first
+	void takeResults(std::vector<AnalysisResult>& taken) {
+		uint64_t count;
+		ssize_t received = read(notifyFd, &count, sizeof(count));
+		(void)received;
+		taken.clear();
+		std::lock_guard<std::mutex> lock(resultsMutex);
+		std::swap(taken, results);
+	}
+
+	// Blocks until every submitted job has finished
+	void waitIdle() {
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		jobsDone.wait(lock, [this]() { return queuedJobs == 0 && runningJobs == 0; });
+	}
+
+	AnalysisMetrics getMetrics() {
+		std::lock_guard<std::mutex> lock(resultsMutex);
+		AnalysisMetrics copy = metrics;
+		copy.queued = queuedJobs;
+		copy.seconds = std::chrono::duration<double>(AnalysisClock::now() - started).count();
+		return copy;
+	}
+};
+
+#endif
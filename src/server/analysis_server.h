@@ -0,0 +1,283 @@
+#ifndef ANALYSIS_SERVER_H
+#define ANALYSIS_SERVER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "index_model/epd.h"
+#include "index_model/notation.h"
+#include "index_model/search.h"
+#include "server/analysis_pool.h"
+#include "server/socket.h"
+#include "util/logger.h"
+
+// Line protocol of chess-analysis --serve, over a Unix domain socket. Jobs are answered when they finish,
+// which need not be the order they were sent in, the tag tells them apart.
+//
+// Client to server:
+//   analyze <EPD>      The position followed by optional operations: id "tag"; depth N; nodes N;
+//                      movetime ms; priority low|normal|high. Missing limits take the server's defaults
+//   stats
+//
+// Server to client:
+//   result <tag> bestmove <move> score <cp N|mate N> depth N nodes N queue_ms X search_ms X pv <moves>
+//   error <tag> <message>
+//   stats <metrics as in formatAnalysisMetrics>
+#define DEFAULT_ANALYSIS_SOCKET "/tmp/chess-analysis.sock"
+#define DEFAULT_ANALYSIS_DEPTH 6
+
+const int MAX_ANALYSIS_EVENTS = 256;
+const uint64_t ANALYSIS_LISTEN_EVENT = 0;  // epoll data of the listening socket
+const uint64_t ANALYSIS_RESULTS_EVENT = 1; // and of the pool's eventfd, connections are numbered from 2
+
+struct AnalysisOptions {
+	std::string unixPath = DEFAULT_ANALYSIS_SOCKET;
+	int threads = 0; // Hardware threads when 0
+	int hashMB = 64;
+	std::string cachePath; // Persistent analysis cache, none when empty
+	int cacheMB = DEFAULT_ANALYSIS_CACHE_MB;
+	SearchLimits limits;
+	AnalysisOptions() { limits.depth = DEFAULT_ANALYSIS_DEPTH; }
+};
+
+inline int parseAnalysisPriority(const std::string& text) {
+	if (text == "low") return ANALYSIS_PRIORITY_LOW;
+	if (text == "high") return ANALYSIS_PRIORITY_HIGH;
+	if (!text.empty() && text.find_first_not_of("0123456789") == std::string::npos) return std::atoi(text.c_str());
+	return ANALYSIS_PRIORITY_NORMAL;
+}
+
+// Limits of the record's operations override the defaults. A depth alone drops the default node and time
+// limits, like go depth in UCI
+inline AnalysisJob makeAnalysisJob(const EPDRecord& record, const SearchLimits& defaults, const std::string& fallbackTag) {
+	AnalysisJob job;
+	job.tag = record.getOperation("id", fallbackTag);
+	std::replace(job.tag.begin(), job.tag.end(), ' ', '_'); // Replies are split at spaces
+	job.fen = record.state;
+	job.limits = defaults;
+	std::string depth = record.getOperation("depth"), nodes = record.getOperation("nodes"), time = record.getOperation("movetime");
+	if (!depth.empty()) {
+		job.limits.depth = std::max(1, std::atoi(depth.c_str()));
+		job.limits.nodes = 0;
+		job.limits.milliseconds = 0.0;
+	}
+	if (!nodes.empty()) job.limits.nodes = std::atoll(nodes.c_str());
+	if (!time.empty()) job.limits.milliseconds = std::atof(time.c_str());
+	job.priority = parseAnalysisPriority(record.getOperation("priority"));
+	return job;
+}
+
+inline std::string formatAnalysisResult(const AnalysisResult& result) {
+	if (!result.valid) return "error " + result.tag + " invalid position";
+	std::string line = "result " + result.tag + " bestmove " + (result.bestMove == Move() ? "none" : getMoveUCI(result.bestMove));
+	if (isMateScore(result.score))
+		line += " score mate " + std::to_string(result.score > 0 ? (MATE_SCORE - result.score + 1) / 2 : -(MATE_SCORE + result.score) / 2);
+	else
+		line += " score cp " + std::to_string(result.score);
+	char timing[64];
+	std::snprintf(timing, sizeof(timing), " queue_ms %.2f search_ms %.2f", result.queueMilliseconds, result.searchMilliseconds);
+	line += " depth " + std::to_string(result.depth) + " nodes " + std::to_string(result.nodes) + timing + " pv";
+	for (Move move : result.pv)
+		line += " " + getMoveUCI(move);
+	return line;
+}
+
+struct AnalysisClient : LineConnection {
+	bool waitingForWrite = false;
+	bool queuedForFlush = false;
+};
+
+// Accepts jobs from any number of local clients and hands them to an AnalysisPool. One thread runs the
+// epoll loop, results are picked up through the pool's eventfd and sent back to the connection that
+// submitted the job if it is still open. Connections are numbered instead of using their descriptors,
+// so a result cannot reach a later connection that got the same descriptor
+class AnalysisServer {
+
+	AnalysisOptions options;
+	AnalysisCache analysisCache;
+	AnalysisPool pool;
+	int epollFd = -1;
+	int unixFd = -1;
+	std::unordered_map<uint64_t, AnalysisClient> clients;
+	uint64_t nextClient = 2;
+	std::vector<uint64_t> clientsToFlush;
+	std::vector<AnalysisResult> results;
+	std::string line;
+
+	AnalysisCache* openCache() {
+		if (options.cachePath.empty() || !analysisCache.open(options.cachePath, options.cacheMB)) return nullptr;
+		return &analysisCache;
+	}
+
+	static int getThreads(int requested) {
+		return requested > 0 ? requested : std::max(1, (int)std::thread::hardware_concurrency());
+	}
+
+	void watch(int fd, uint64_t data, uint32_t events, int operation = EPOLL_CTL_ADD) {
+		epoll_event event = {};
+		event.events = events;
+		event.data.u64 = data;
+		epoll_ctl(epollFd, operation, fd, &event);
+	}
+
+	void send(uint64_t id, const std::string& message) {
+		auto found = clients.find(id);
+		if (found == clients.end()) return;
+		found->second.send(message);
+		if (!found->second.queuedForFlush) {
+			found->second.queuedForFlush = true;
+			clientsToFlush.push_back(id);
+		}
+	}
+
+	void acceptClients() {
+		while (true) {
+			int fd = accept4(unixFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if (fd == -1) {
+				if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+					LOG_ERROR("accept failed: %s", std::strerror(errno));
+				return;
+			}
+			uint64_t id = nextClient++;
+			clients[id].fd = fd;
+			watch(fd, id, EPOLLIN);
+		}
+	}
+
+	void closeClient(uint64_t id) {
+		auto found = clients.find(id);
+		if (found == clients.end()) return;
+		epoll_ctl(epollFd, EPOLL_CTL_DEL, found->second.fd, nullptr);
+		close(found->second.fd);
+		clients.erase(found); // Its queued jobs still run, their results are dropped
+	}
+
+	void handleLine(uint64_t id) {
+		size_t split = line.find(' ');
+		std::string command = line.substr(0, split);
+		if (command == "stats") {
+			send(id, "stats " + formatAnalysisMetrics(pool.getMetrics()));
+			return;
+		}
+		EPDRecord record;
+		if (command != "analyze" || split == std::string::npos || !parseEPD(line.substr(split + 1), record)) {
+			send(id, "error - unknown command or missing position");
+			return;
+		}
+		AnalysisJob job = makeAnalysisJob(record, options.limits, std::to_string(jobsReceived + 1));
+		job.client = id;
+		jobsReceived++;
+		pool.submit(std::move(job));
+	}
+
+	void readClient(uint64_t id) {
+		auto found = clients.find(id);
+		if (found == clients.end()) return;
+		bool open = found->second.receive();
+		while (found->second.nextLine(line))
+			handleLine(id);
+		if (!open) {
+			if (found->second.lineTooLong) { // Best effort, the connection is closed right after
+				found->second.send("error - line too long");
+				found->second.flush();
+			}
+			closeClient(id);
+		}
+	}
+
+	void handleResults() {
+		pool.takeResults(results);
+		for (const AnalysisResult& result : results)
+			send(result.client, formatAnalysisResult(result));
+	}
+
+	void flushClients() {
+		for (uint64_t id : clientsToFlush) {
+			auto found = clients.find(id);
+			if (found == clients.end()) continue;
+			AnalysisClient& client = found->second;
+			client.queuedForFlush = false;
+			if (!client.flush()) {
+				closeClient(id);
+				continue;
+			}
+			if (client.hasPendingOutput() != client.waitingForWrite) {
+				client.waitingForWrite = client.hasPendingOutput();
+				watch(client.fd, id, client.waitingForWrite ? EPOLLIN | EPOLLOUT : EPOLLIN, EPOLL_CTL_MOD);
+			}
+		}
+		clientsToFlush.clear();
+	}
+
+public:
+
+	std::atomic<bool> running{ false };
+	long long jobsReceived = 0;
+
+	AnalysisServer(const AnalysisOptions& options) : options(options), pool(getThreads(options.threads), options.hashMB, openCache()) {}
+
+	~AnalysisServer() {
+		for (auto& client : clients)
+			close(client.second.fd);
+		if (unixFd != -1) {
+			close(unixFd);
+			unlink(options.unixPath.c_str());
+		}
+		if (epollFd != -1) close(epollFd);
+	}
+
+	AnalysisPool& getPool() { return pool; }
+
+	bool start() {
+		raiseFileLimit();
+		epollFd = epoll_create1(EPOLL_CLOEXEC);
+		if (epollFd == -1) return false;
+		unixFd = listenUnix(options.unixPath);
+		if (unixFd == -1) {
+			LOG_ERROR("Failed to listen on %s: %s", options.unixPath.c_str(), std::strerror(errno));
+			return false;
+		}
+		watch(unixFd, ANALYSIS_LISTEN_EVENT, EPOLLIN);
+		watch(pool.getNotifyFd(), ANALYSIS_RESULTS_EVENT, EPOLLIN);
+		LOG_INFO("Analysing with %d threads on %s", pool.getThreadCount(), options.unixPath.c_str());
+		running = true;
+		return true;
+	}
+
+	// Returns when running is cleared, checked at least every timeout
+	void run(int timeoutMs = 200) {
+		epoll_event events[MAX_ANALYSIS_EVENTS];
+		while (running) {
+			int nEvents = epoll_wait(epollFd, events, MAX_ANALYSIS_EVENTS, timeoutMs);
+			for (int i = 0; i < nEvents; i++) {
+				uint64_t id = events[i].data.u64;
+				if (id == ANALYSIS_LISTEN_EVENT) acceptClients();
+				else if (id == ANALYSIS_RESULTS_EVENT) handleResults();
+				else {
+					auto found = clients.find(id);
+					if ((events[i].events & EPOLLOUT) && found != clients.end() && !found->second.queuedForFlush) {
+						found->second.queuedForFlush = true;
+						clientsToFlush.push_back(id);
+					}
+					if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) readClient(id);
+				}
+			}
+			flushClients();
+		}
+	}
+
+	int getClientCount() { return (int)clients.size(); }
+};
+
+#endif
@@ -0,0 +1,214 @@
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "index_model/game_tree.h"
+#include "index_model/move.h"
+
+// Binary stream sent to spectators after "watch <game|all>". Every frame starts with its type byte and the
+// game id as a varint (7 bits per byte, low bits first), multi-byte fields are little endian:
+//   BROADCAST_MOVE      move (2 bytes, the 16 bit Move)                              4 to 8 bytes
+//   BROADCAST_KEYFRAME  ply (varint), PositionSnapshot fields: 64 pieces, side to move,
+//                       en passant square, half move clock (2), hash key (8), pawn key (8)
+//   BROADCAST_END       reason (1 byte, as in getEndingName)
+//   BROADCAST_MESSAGE   length (varint) and a protocol line, game 0. Replies to commands sent after watch
+// A keyframe is the position after the given ply. Watchers get one for every game they watch when they
+// start, one for each new game and one every BROADCAST_KEYFRAME_INTERVAL plies after the move frame
+#define BROADCAST_MOVE 1
+#define BROADCAST_KEYFRAME 2
+#define BROADCAST_END 3
+#define BROADCAST_MESSAGE 4
+
+const int BROADCAST_KEYFRAME_INTERVAL = 32;
+const size_t KEYFRAME_FIELDS_SIZE = 64 + 1 + 1 + 2 + 8 + 8;
+const size_t MAX_SPECTATOR_BACKLOG = 4 << 20; // Bytes queued for a spectator before it is dropped as too slow
+const int MAX_WRITE_BUFFERS = 64;             // Buffers passed to one writev
+
+// Frames are serialized once per batch into one of these and the same buffer is queued for every watcher
+typedef std::shared_ptr<const std::string> SharedBuffer;
+
+inline void writeVarint(std::string& out, uint32_t value) {
+	while (value >= 0x80) {
+		out += (char)(value | 0x80);
+		value >>= 7;
+	}
+	out += (char)value;
+}
+
+inline void writeLittleEndian(std::string& out, uint64_t value, int bytes) {
+	for (int i = 0; i < bytes; i++)
+		out += (char)(value >> (8 * i));
+}
+
+inline void appendMoveFrame(std::string& out, uint32_t game, Move move) {
+	out += (char)BROADCAST_MOVE;
+	writeVarint(out, game);
+	writeLittleEndian(out, (move.getFlags() << 12) | (move.getFrom() << 6) | move.getTo(), 2);
+}
+
+inline void appendKeyframe(std::string& out, uint32_t game, uint32_t ply, const PositionSnapshot& position) {
+	out += (char)BROADCAST_KEYFRAME;
+	writeVarint(out, game);
+	writeVarint(out, ply);
+	out.append((const char*)position.pieces, 64);
+	out += (char)position.sideToMove;
+	out += (char)position.possibleEpCapture;
+	writeLittleEndian(out, position.halfMoveClock, 2);
+	writeLittleEndian(out, position.hashKey, 8);
+	writeLittleEndian(out, position.pawnKey, 8);
+}
+
+inline void appendEndFrame(std::string& out, uint32_t game, int reason) {
+	out += (char)BROADCAST_END;
+	writeVarint(out, game);
+	out += (char)reason;
+}
+
+inline void appendMessageFrame(std::string& out, const std::string& message) {
+	out += (char)BROADCAST_MESSAGE;
+	writeVarint(out, 0);
+	writeVarint(out, (uint32_t)message.size());
+	out += message;
+}
+
+struct BroadcastFrame {
+	int type = 0;
+	uint32_t game = 0;
+	Move move;
+	uint32_t ply = 0;
+	PositionSnapshot position;
+	int reason = 0;
+	std::string message;
+};
+
+class BroadcastReader {
+
+	const uint8_t* data;
+	size_t size;
+	size_t offset = 0;
+
+	bool readVarint(uint32_t& value) {
+		value = 0;
+		for (int shift = 0; shift < 35; shift += 7) {
+			if (offset >= size) return false;
+			uint8_t byte = data[offset++];
+			value |= (uint32_t)(byte & 0x7f) << shift;
+			if (!(byte & 0x80)) return true;
+		}
+		return false;
+	}
+
+	bool readLittleEndian(uint64_t& value, int bytes) {
+		if (offset + bytes > size) return false;
+		value = 0;
+		for (int i = 0; i < bytes; i++)
+			value |= (uint64_t)data[offset++] << (8 * i);
+		return true;
+	}
+
+public:
+	bool malformed = false;
+
+	BroadcastReader(const void* data, size_t size) : data((const uint8_t*)data), size(size) {}
+
+	size_t getOffset() { return offset; }
+
+	// False at the end of the data or in front of an incomplete frame, which stays unread
+	bool next(BroadcastFrame& frame) {
+		size_t start = offset;
+		uint64_t value = 0;
+		bool complete = offset < size;
+		if (complete) {
+			frame.type = data[offset++];
+			complete = readVarint(frame.game);
+		}
+		if (complete && frame.type == BROADCAST_MOVE) {
+			complete = readLittleEndian(value, 2);
+			frame.move = Move((int)(value >> 6) & 0x3f, (int)value & 0x3f, (int)(value >> 12));
+		}
+		else if (complete && frame.type == BROADCAST_KEYFRAME) {
+			complete = readVarint(frame.ply) && offset + KEYFRAME_FIELDS_SIZE <= size;
+			if (complete) {
+				std::memcpy(frame.position.pieces, data + offset, 64);
+				frame.position.sideToMove = data[offset + 64];
+				frame.position.possibleEpCapture = (int8_t)data[offset + 65];
+				offset += 66;
+				readLittleEndian(value, 2);
+				frame.position.halfMoveClock = (uint16_t)value;
+				readLittleEndian(frame.position.hashKey, 8);
+				readLittleEndian(frame.position.pawnKey, 8);
+			}
+		}
+		else if (complete && frame.type == BROADCAST_END) {
+			complete = offset < size;
+			if (complete) frame.reason = data[offset++];
+		}
+		else if (complete && frame.type == BROADCAST_MESSAGE) {
+			uint32_t length;
+			complete = readVarint(length) && offset + length <= size;
+			if (complete) {
+				frame.message.assign((const char*)data + offset, length);
+				offset += length;
+			}
+		}
+		else if (complete) {
+			malformed = true;
+			complete = false;
+		}
+		if (!complete) offset = start;
+		return complete;
+	}
+};
+
+// Output of one spectator: references to shared buffers, gathered by one sendmsg (writev that cannot raise
+// SIGPIPE) without copying them
+struct BroadcastQueue {
+	std::deque<SharedBuffer> buffers;
+	size_t offset = 0;      // Bytes of the front buffer already sent
+	size_t queuedBytes = 0;
+
+	void push(const SharedBuffer& buffer) {
+		buffers.push_back(buffer);
+		queuedBytes += buffer->size();
+	}
+
+	bool hasPendingOutput() { return !buffers.empty(); }
+
+	// Sends as much as the socket takes, false if it failed
+	bool flush(int fd) {
+		iovec vectors[MAX_WRITE_BUFFERS];
+		while (!buffers.empty()) {
+			int nVectors = 0;
+			for (size_t i = 0; i < buffers.size() && nVectors < MAX_WRITE_BUFFERS; i++) {
+				size_t skip = i == 0 ? offset : 0;
+				vectors[nVectors].iov_base = (void*)(buffers[i]->data() + skip);
+				vectors[nVectors].iov_len = buffers[i]->size() - skip;
+				nVectors++;
+			}
+			msghdr message = {};
+			message.msg_iov = vectors;
+			message.msg_iovlen = nVectors;
+			ssize_t sent = sendmsg(fd, &message, MSG_NOSIGNAL);
+			if (sent == -1) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+			queuedBytes -= sent;
+			size_t remaining = (size_t)sent + offset;
+			while (!buffers.empty() && remaining >= buffers.front()->size()) {
+				remaining -= buffers.front()->size();
+				buffers.pop_front();
+			}
+			offset = remaining;
+		}
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,218 @@
+#ifndef CLIENT_SESSION_H
+#define CLIENT_SESSION_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+
+#include <unistd.h>
+
+#include "server/protocol.h"
+#include "server/socket.h"
+#include "util/logger.h"
+
+#define SESSION_OFFLINE 0
+#define SESSION_CONNECTING 1
+#define SESSION_CONNECTED 2
+#define SESSION_CLOSED 3 // The connection failed or the server closed it
+
+#define SESSION_GAME_STARTED 1
+#define SESSION_MOVE_CONFIRMED 2
+#define SESSION_MOVE_REJECTED 3
+#define SESSION_OPPONENT_MOVE 4
+#define SESSION_GAME_ENDED 5
+#define SESSION_DISCONNECTED 6
+
+const int LATENCY_WINDOW = 64; // Recent confirmations the percentiles are taken over
+
+// Time from sending a move to the server's ok, in milliseconds
+struct LatencyStatistics {
+	float recent[LATENCY_WINDOW];
+	int nRecent = 0;
+	int next = 0;
+	float last = 0.0f;
+	float max = 0.0f;
+	double total = 0.0;
+	long long count = 0;
+
+	void add(float milliseconds) {
+		recent[next] = milliseconds;
+		next = (next + 1) % LATENCY_WINDOW;
+		nRecent = std::min(nRecent + 1, LATENCY_WINDOW);
+		last = milliseconds;
+		max = std::max(max, milliseconds);
+		total += milliseconds;
+		count++;
+	}
+
+	float getAverage() const { return count ? (float)(total / count) : 0.0f; }
+
+	float getPercentile(double percentile) const {
+		if (nRecent == 0) return 0.0f;
+		float sorted[LATENCY_WINDOW];
+		std::copy(recent, recent + nRecent, sorted);
+		std::sort(sorted, sorted + nRecent);
+		return sorted[std::min(nRecent - 1, (int)(nRecent * percentile))];
+	}
+};
+
+struct SessionEvent {
+	int type = 0;
+	std::string move;   // UCI move of the confirmation, rejection or opponent move
+	int side = 0;       // Color played, for SESSION_GAME_STARTED
+	std::string reason; // Ending name, for SESSION_GAME_ENDED
+};
+
+// Client side of the chess-server protocol for a single game. Nothing blocks except resolving the host
+// name in connect: poll is called once per frame, sends what is queued, reads what has arrived and turns
+// the replies into events. Only one move is in flight at a time, the player has to wait for the opponent
+class NetworkSession {
+
+	LineConnection connection;
+	std::deque<SessionEvent> events;
+	std::chrono::steady_clock::time_point moveSentAt;
+	std::string pendingMove;
+	std::string line;
+
+	void handleLine() {
+		char command[16] = {}, idText[16] = {}, argument[64] = {};
+		std::sscanf(line.c_str(), "%15s %15s %63s", command, idText, argument);
+		uint32_t id = (uint32_t)std::strtoul(idText, nullptr, 10);
+		SessionEvent event;
+
+		if (!std::strcmp(command, "game")) {
+			gameId = id;
+			side = std::strcmp(argument, "black") ? WHITE : BLACK;
+			event.type = SESSION_GAME_STARTED;
+			event.side = side;
+		}
+		else if (!std::strcmp(command, "error")) {
+			LOG_WARNING("Server: %s", line.c_str());
+			if (pendingMove.empty()) return;
+			event.type = SESSION_MOVE_REJECTED; // Replies come in order, so it answers the move
+			event.move = pendingMove;
+			pendingMove.clear();
+		}
+		else if (id != gameId || gameId == 0)
+			return; // Left over from a game that was left
+		else if (!std::strcmp(command, "ok") || !std::strcmp(command, "illegal")) {
+			bool confirmed = command[0] == 'o';
+			if (confirmed)
+				latency.add(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - moveSentAt).count());
+			event.type = confirmed ? SESSION_MOVE_CONFIRMED : SESSION_MOVE_REJECTED;
+			event.move = argument;
+			pendingMove.clear();
+		}
+		else if (!std::strcmp(command, "move")) {
+			event.type = SESSION_OPPONENT_MOVE;
+			event.move = argument;
+		}
+		else if (!std::strcmp(command, "end")) {
+			event.type = SESSION_GAME_ENDED;
+			event.reason = argument;
+			endReason = argument;
+			gameId = 0;
+		}
+		else return;
+		events.push_back(event);
+	}
+
+public:
+	int state = SESSION_OFFLINE;
+	uint32_t gameId = 0; // 0 while no game is being played
+	int side = WHITE;
+	std::string endReason; // Why the last game ended, empty while it is played
+	LatencyStatistics latency;
+
+	~NetworkSession() { close(); }
+
+	// Address is host:port, or the path of a Unix socket
+	bool connect(const std::string& address) {
+		close();
+		size_t colon = address.rfind(':');
+		if (address.find('/') != std::string::npos || colon == std::string::npos)
+			connection.fd = startConnectUnix(address);
+		else
+			connection.fd = startConnect(address.substr(0, colon), std::atoi(address.c_str() + colon + 1));
+		if (connection.fd == -1) {
+			LOG_ERROR("Failed to connect to %s", address.c_str());
+			state = SESSION_CLOSED;
+			return false;
+		}
+		state = SESSION_CONNECTING;
+		return true;
+	}
+
+	void close() {
+		if (connection.fd != -1) ::close(connection.fd);
+		connection = LineConnection();
+		events.clear();
+		pendingMove.clear();
+		endReason.clear();
+		gameId = 0;
+		state = SESSION_OFFLINE;
+	}
+
+	// Closes the connection but keeps reporting it as closed, for failures and a server that cannot be trusted
+	void disconnect(const char* reason) {
+		LOG_WARNING("Server connection %s", reason);
+		if (connection.fd != -1) ::close(connection.fd);
+		connection = LineConnection();
+		state = SESSION_CLOSED;
+		gameId = 0;
+		pendingMove.clear();
+		SessionEvent event;
+		event.type = SESSION_DISCONNECTED;
+		events.push_back(event);
+	}
+
+	bool isPlaying() { return state == SESSION_CONNECTED && gameId != 0; }
+	bool hasPendingMove() { return !pendingMove.empty(); }
+
+	// Leaves the current game. Requests are queued while connecting and sent once connected
+	void startGame(int side, int depth) {
+		if (gameId != 0) connection.send("leave " + std::to_string(gameId));
+		gameId = 0;
+		pendingMove.clear();
+		endReason.clear();
+		connection.send(std::string("new ") + (side == WHITE ? "white " : "black ") + std::to_string(depth));
+	}
+
+	void sendMove(const std::string& uci) {
+		if (gameId == 0) return;
+		pendingMove = uci;
+		moveSentAt = std::chrono::steady_clock::now();
+		connection.send("move " + std::to_string(gameId) + " " + uci);
+	}
+
+	void poll() {
+		if (state == SESSION_CONNECTING) {
+			int connected = finishConnect(connection.fd);
+			if (connected == -1) return disconnect("failed");
+			if (connected == 0) return;
+			state = SESSION_CONNECTED;
+			LOG_INFO("Connected to the game server");
+		}
+		if (state != SESSION_CONNECTED) return;
+
+		if (!connection.flush()) return disconnect("failed");
+		bool open = connection.receive();
+		while (connection.nextLine(line))
+			handleLine();
+		if (!open) disconnect("was closed by the server");
+	}
+
+	bool nextEvent(SessionEvent& event) {
+		if (events.empty()) return false;
+		event = std::move(events.front());
+		events.pop_front();
+		return true;
+	}
+};
+
+#endif
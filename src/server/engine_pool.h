@@ -0,0 +1,111 @@
+#ifndef ENGINE_POOL_H
+#define ENGINE_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "index_model/move.h"
+#include "index_model/search.h"
+#include "index_model/transposition.h"
+#include "server/protocol.h"
+
+struct EngineJob {
+	uint32_t gameId;
+	std::vector<Move> moves; // Played from SERVER_START_POSITION
+	int depth;
+};
+
+struct EngineResult {
+	uint32_t gameId;
+	Move move;
+};
+
+// Searches engine moves for every game of the server. Each worker has its own searcher and they share
+// one transposition table. Finished moves are collected until the event loop takes them, an eventfd
+// readable in the loop's epoll set tells it that there are some
+class EnginePool {
+
+	TranspositionTable transpositionTable;
+	std::vector<std::thread> workers;
+
+	std::mutex jobsMutex;
+	std::condition_variable jobsReady;
+	std::deque<EngineJob> jobs;
+	bool stopping = false;
+
+	std::mutex resultsMutex;
+	std::vector<EngineResult> results;
+	int notifyFd = -1;
+
+	void work() {
+		std::unique_ptr<Searcher> searcher(new Searcher(transpositionTable));
+		while (true) {
+			EngineJob job;
+			{
+				std::unique_lock<std::mutex> lock(jobsMutex);
+				jobsReady.wait(lock, [this]() { return stopping || !jobs.empty(); });
+				if (stopping) return;
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+			searcher->setPosition(SERVER_START_POSITION, job.moves, (int)job.moves.size());
+			SearchResult result = searcher->search(job.depth);
+			{
+				std::lock_guard<std::mutex> lock(resultsMutex);
+				results.push_back({ job.gameId, result.bestMove });
+			}
+			uint64_t one = 1;
+			ssize_t written = write(notifyFd, &one, sizeof(one));
+			(void)written;
+		}
+	}
+
+public:
+
+	EnginePool(int nThreads, int hashMB) : transpositionTable(hashMB) {
+		notifyFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		for (int i = 0; i < nThreads; i++)
+			workers.emplace_back(&EnginePool::work, this);
+	}
+
+	~EnginePool() {
+		{
+			std::lock_guard<std::mutex> lock(jobsMutex);
+			stopping = true;
+		}
+		jobsReady.notify_all();
+		for (std::thread& worker : workers)
+			worker.join();
+		close(notifyFd);
+	}
+
+	int getNotifyFd() { return notifyFd; }
+
+	void submit(EngineJob&& job) {
+		{
+			std::lock_guard<std::mutex> lock(jobsMutex);
+			jobs.push_back(std::move(job));
+		}
+		jobsReady.notify_one();
+	}
+
+	// Swaps the finished moves into the given vector, which is cleared first
+	void takeResults(std::vector<EngineResult>& taken) {
+		uint64_t count;
+		ssize_t received = read(notifyFd, &count, sizeof(count));
+		(void)received;
+		taken.clear();
+		std::lock_guard<std::mutex> lock(resultsMutex);
+		std::swap(taken, results);
+	}
+};
+
+#endif
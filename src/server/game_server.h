@@ -0,0 +1,529 @@
+#ifndef GAME_SERVER_H
+#define GAME_SERVER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "index_model/board.h"
+#include "index_model/game_tree.h"
+#include "index_model/move.h"
+#include "index_model/notation.h"
+#include "server/broadcast.h"
+#include "server/engine_pool.h"
+#include "server/protocol.h"
+#include "server/socket.h"
+#include "util/logger.h"
+
+const int MAX_EPOLL_EVENTS = 1024;
+const int MAX_MESSAGE_TOKENS = 4;
+
+struct ServerOptions {
+	int port = DEFAULT_SERVER_PORT;     // 0 for no TCP listener
+	std::string unixPath = DEFAULT_SERVER_SOCKET; // Empty for no Unix socket
+	int engineThreads = 0;              // Hardware threads minus one when 0
+	int hashMB = 64;
+};
+
+// A game is only its current position and the moves that led to it, positions are set up on a scratch
+// board when a move has to be checked
+struct ServerGame {
+	PositionSnapshot position;
+	std::vector<Move> moves;
+	int players[2] = { -1, -1 };       // Connection playing each color, indexed by color, -1 for none
+	bool engineSide[2] = { false, false };
+	bool open = false;                 // Waiting for a second player to join as black
+	bool engineThinking = false;
+	int engineDepth = DEFAULT_ENGINE_DEPTH;
+	std::vector<int> spectators;       // Connections watching only this game
+	std::string frames;                // Broadcast frames of the current batch for them
+};
+
+struct ServerClient : LineConnection {
+	std::vector<uint32_t> games;
+	bool waitingForWrite = false; // EPOLLOUT is in the epoll set
+	bool queuedForFlush = false;
+	bool spectating = false;      // Everything is sent through broadcast once a watch was accepted
+	bool watchingAll = false;
+	uint32_t watchedGame = 0;     // 0 for none
+	BroadcastQueue broadcast;
+};
+
+// Hosts games for any number of clients over TCP and a Unix domain socket. A single thread runs the
+// epoll loop and owns every game, engine moves are searched by the EnginePool and picked up through
+// its eventfd. Replies are collected while a batch of events is handled and written at the end of it.
+// Spectators get the binary stream of broadcast.h, the frames of a batch are serialized once into a
+// shared buffer that is queued for every watcher of the game or of all games
+class GameServer {
+
+	ServerOptions options;
+	int epollFd = -1;
+	int tcpFd = -1;
+	int unixFd = -1;
+	EnginePool enginePool;
+	std::unordered_map<int, ServerClient> clients;
+	std::unordered_map<uint32_t, ServerGame> games;
+	uint32_t nextGameId = 1;
+	ChessBoardIndex scratchBoard;
+	PositionSnapshot startPosition;
+	std::vector<int> clientsToFlush;
+	std::vector<int> flushBatch;
+	std::vector<EngineResult> engineResults;
+	std::string line;
+
+	std::vector<int> allSpectators;        // Connections watching every game
+	std::string allFrames;                 // Broadcast frames of the current batch for them
+	std::vector<uint32_t> gamesWithFrames;
+	std::vector<int> slowSpectators;       // Dropped at the end of the batch
+
+	int getEngineThreads(int requested) {
+		if (requested > 0) return requested;
+		return std::max(1, (int)std::thread::hardware_concurrency() - 1);
+	}
+
+	void watch(int fd, uint32_t events, int operation = EPOLL_CTL_ADD) {
+		epoll_event event = {};
+		event.events = events;
+		event.data.fd = fd;
+		epoll_ctl(epollFd, operation, fd, &event);
+	}
+
+	void send(int fd, const std::string& message) {
+		auto client = clients.find(fd);
+		if (client == clients.end()) return;
+		if (client->second.spectating) {
+			std::string frame;
+			appendMessageFrame(frame, message);
+			client->second.broadcast.push(std::make_shared<const std::string>(std::move(frame)));
+		}
+		else client->second.send(message);
+		if (!client->second.queuedForFlush) {
+			client->second.queuedForFlush = true;
+			clientsToFlush.push_back(fd);
+		}
+	}
+
+	void sendToPlayers(ServerGame& game, const std::string& message, int except = -1) {
+		for (int color = 0; color < 2; color++) {
+			int fd = game.players[color];
+			if (fd != -1 && fd != except && (color == 0 || fd != game.players[0]))
+				send(fd, message);
+		}
+	}
+
+	void acceptClients(int listenFd) {
+		while (true) {
+			int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if (fd == -1) {
+				if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+					LOG_ERROR("accept failed: %s", std::strerror(errno));
+				return;
+			}
+			if (listenFd == tcpFd) setNoDelay(fd);
+			ServerClient& client = clients[fd];
+			client.fd = fd;
+			watch(fd, EPOLLIN);
+		}
+	}
+
+	void closeClient(int fd) {
+		auto found = clients.find(fd);
+		if (found == clients.end()) return;
+		std::vector<uint32_t> clientGames = found->second.games;
+		for (uint32_t id : clientGames)
+			endGame(id, GAME_ABANDONED, fd);
+		if (found->second.spectating) stopWatching(found->second);
+		epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+		close(fd);
+		clients.erase(fd);
+	}
+
+	void endGame(uint32_t id, int reason, int except = -1) {
+		auto found = games.find(id);
+		if (found == games.end()) return;
+		ServerGame& game = found->second;
+		sendToPlayers(game, "end " + std::to_string(id) + " " + getEndingName(reason), except);
+		if (!allSpectators.empty()) appendEndFrame(allFrames, id, reason);
+		if (!game.spectators.empty()) {
+			appendEndFrame(game.frames, id, reason);
+			publishGameFrames(game);
+			for (int fd : game.spectators) // They stay connected and may watch something else
+				clients[fd].watchedGame = 0;
+		}
+		for (int fd : game.players) {
+			auto client = clients.find(fd);
+			if (client == clients.end()) continue;
+			std::vector<uint32_t>& clientGames = client->second.games;
+			clientGames.erase(std::remove(clientGames.begin(), clientGames.end(), id), clientGames.end());
+		}
+		games.erase(found);
+	}
+
+	// Plays a legal move on the game, returns the ending it caused if any
+	int playMove(uint32_t id, ServerGame& game, Move move) {
+		scratchBoard.restoreSnapshot(game.position);
+		scratchBoard.makeMove(move, false, false, false);
+		int ending = scratchBoard.checkGameEnded();
+		game.position = scratchBoard.getSnapshot();
+		game.moves.push_back(move);
+		movesPlayed++;
+		broadcastMove(id, game, move);
+		return ending;
+	}
+
+	void broadcastMove(uint32_t id, ServerGame& game, Move move) {
+		bool keyframe = game.moves.size() % BROADCAST_KEYFRAME_INTERVAL == 0;
+		if (!allSpectators.empty()) {
+			appendMoveFrame(allFrames, id, move);
+			if (keyframe) appendKeyframe(allFrames, id, (uint32_t)game.moves.size(), game.position);
+		}
+		if (!game.spectators.empty()) {
+			if (game.frames.empty()) gamesWithFrames.push_back(id);
+			appendMoveFrame(game.frames, id, move);
+			if (keyframe) appendKeyframe(game.frames, id, (uint32_t)game.moves.size(), game.position);
+		}
+		broadcastFrames += (keyframe ? 2 : 1) * (long long)(allSpectators.size() + game.spectators.size());
+	}
+
+	void queueBroadcast(int fd, const SharedBuffer& buffer) {
+		auto found = clients.find(fd);
+		if (found == clients.end()) return;
+		ServerClient& client = found->second;
+		client.broadcast.push(buffer);
+		if (client.broadcast.queuedBytes > MAX_SPECTATOR_BACKLOG) {
+			slowSpectators.push_back(fd);
+			return;
+		}
+		if (!client.queuedForFlush) {
+			client.queuedForFlush = true;
+			clientsToFlush.push_back(fd);
+		}
+	}
+
+	void publishGameFrames(ServerGame& game) {
+		if (game.frames.empty()) return;
+		SharedBuffer buffer = std::make_shared<const std::string>(std::move(game.frames));
+		game.frames.clear();
+		for (int fd : game.spectators)
+			queueBroadcast(fd, buffer);
+	}
+
+	// Turns the frames of the batch into one buffer per audience. Spectators that fall too far behind are only
+	// noted, the caller may still hold references to them or their games
+	void publishBroadcast() {
+		if (!allFrames.empty()) {
+			SharedBuffer buffer = std::make_shared<const std::string>(std::move(allFrames));
+			allFrames.clear();
+			for (int fd : allSpectators)
+				queueBroadcast(fd, buffer);
+		}
+		for (uint32_t id : gamesWithFrames) {
+			auto found = games.find(id);
+			if (found != games.end()) publishGameFrames(found->second);
+		}
+		gamesWithFrames.clear();
+	}
+
+	// At the end of the batch, when no client or game is in use any more
+	void dropSlowSpectators() {
+		for (size_t i = 0; i < slowSpectators.size(); i++) { // Closing may end games, which can add more
+			auto found = clients.find(slowSpectators[i]);
+			if (found == clients.end()) continue;
+			LOG_WARNING("Dropping a spectator %zu bytes behind", found->second.broadcast.queuedBytes);
+			closeClient(slowSpectators[i]);
+			spectatorsDropped++;
+		}
+		slowSpectators.clear();
+	}
+
+	void stopWatching(ServerClient& client) {
+		if (client.watchingAll)
+			allSpectators.erase(std::find(allSpectators.begin(), allSpectators.end(), client.fd));
+		auto game = games.find(client.watchedGame);
+		if (game != games.end()) {
+			std::vector<int>& spectators = game->second.spectators;
+			spectators.erase(std::find(spectators.begin(), spectators.end(), client.fd));
+		}
+		client.watchingAll = false;
+		client.watchedGame = 0;
+	}
+
+	// The frames so far are published first, so that the keyframes of the new spectator are not followed by
+	// moves they already contain
+	void watchGames(ServerClient& client, const std::string& target) {
+		uint32_t id = target == "all" ? 0 : (uint32_t)std::strtoul(target.c_str(), nullptr, 10);
+		auto found = games.find(id);
+		if (id != 0 && found == games.end()) {
+			send(client.fd, "error unknown game " + target);
+			return;
+		}
+		publishBroadcast();
+		if (client.spectating) stopWatching(client);
+		else {
+			client.spectating = true;
+			if (client.hasPendingOutput()) // Replies sent before, still in order
+				client.broadcast.push(std::make_shared<const std::string>(client.output.substr(client.outputOffset)));
+			client.output.clear();
+			client.outputOffset = 0;
+		}
+
+		std::string keyframes;
+		if (id == 0) {
+			client.watchingAll = true;
+			allSpectators.push_back(client.fd);
+			for (auto& game : games)
+				appendKeyframe(keyframes, game.first, (uint32_t)game.second.moves.size(), game.second.position);
+		}
+		else {
+			client.watchedGame = id;
+			found->second.spectators.push_back(client.fd);
+			appendKeyframe(keyframes, id, (uint32_t)found->second.moves.size(), found->second.position);
+		}
+		if (!keyframes.empty()) queueBroadcast(client.fd, std::make_shared<const std::string>(std::move(keyframes)));
+	}
+
+	void requestEngineMove(uint32_t id, ServerGame& game) {
+		game.engineThinking = true;
+		enginePool.submit({ id, game.moves, game.engineDepth });
+	}
+
+	void afterMove(uint32_t id, ServerGame& game, int ending) {
+		if (ending) endGame(id, ending);
+		else if (game.engineSide[game.position.sideToMove]) requestEngineMove(id, game);
+	}
+
+	void newGame(ServerClient& client, const std::string* tokens, int nTokens) {
+		const std::string& mode = nTokens > 1 ? tokens[1] : "white";
+		if (mode != "white" && mode != "black" && mode != "both" && mode != "human") {
+			send(client.fd, "error unknown mode " + mode);
+			return;
+		}
+		uint32_t id = nextGameId++;
+		ServerGame& game = games[id];
+		game.position = startPosition;
+		game.engineDepth = nTokens > 2 ? std::max(1, std::min(MAX_ENGINE_DEPTH, std::atoi(tokens[2].c_str()))) : DEFAULT_ENGINE_DEPTH;
+		if (mode == "white" || mode == "human" || mode == "both") game.players[WHITE] = client.fd;
+		if (mode == "black" || mode == "both") game.players[BLACK] = client.fd;
+		game.engineSide[WHITE] = mode == "black";
+		game.engineSide[BLACK] = mode == "white";
+		game.open = mode == "human";
+		client.games.push_back(id);
+		if (!allSpectators.empty()) appendKeyframe(allFrames, id, 0, game.position);
+
+		send(client.fd, "game " + std::to_string(id) + " " + (mode == "human" ? "white" : mode));
+		if (game.engineSide[WHITE]) requestEngineMove(id, game);
+	}
+
+	void joinGame(ServerClient& client, uint32_t id) {
+		auto found = games.find(id);
+		if (found == games.end() || !found->second.open || found->second.players[WHITE] == client.fd) {
+			send(client.fd, "error cannot join " + std::to_string(id));
+			return;
+		}
+		ServerGame& game = found->second;
+		game.players[BLACK] = client.fd;
+		game.open = false;
+		client.games.push_back(id);
+		send(client.fd, "game " + std::to_string(id) + " black");
+		send(game.players[WHITE], "joined " + std::to_string(id));
+	}
+
+	void clientMove(ServerClient& client, uint32_t id, const std::string& uci) {
+		auto found = games.find(id);
+		if (found == games.end()) {
+			send(client.fd, "error unknown game " + std::to_string(id));
+			return;
+		}
+		ServerGame& game = found->second;
+		if (game.players[game.position.sideToMove] != client.fd || game.engineThinking) {
+			send(client.fd, "error " + std::to_string(id) + " not your turn");
+			return;
+		}
+		scratchBoard.restoreSnapshot(game.position);
+		Move move = parseMoveUCI(scratchBoard, uci);
+		if (move == Move()) {
+			send(client.fd, "illegal " + std::to_string(id) + " " + uci);
+			return;
+		}
+		int ending = playMove(id, game, move);
+		send(client.fd, "ok " + std::to_string(id) + " " + uci);
+		int opponent = game.players[game.position.sideToMove];
+		if (opponent != -1 && opponent != client.fd)
+			send(opponent, "move " + std::to_string(id) + " " + uci);
+		afterMove(id, game, ending);
+	}
+
+	void handleLine(ServerClient& client, const std::string& message) {
+		std::string tokens[MAX_MESSAGE_TOKENS];
+		int nTokens = 0;
+		size_t position = 0;
+		while (nTokens < MAX_MESSAGE_TOKENS) {
+			size_t start = message.find_first_not_of(' ', position);
+			if (start == std::string::npos) break;
+			size_t end = message.find(' ', start);
+			tokens[nTokens++] = message.substr(start, end == std::string::npos ? std::string::npos : end - start);
+			if (end == std::string::npos) break;
+			position = end;
+		}
+		if (nTokens == 0) return;
+
+		const std::string& command = tokens[0];
+		uint32_t id = nTokens > 1 ? (uint32_t)std::strtoul(tokens[1].c_str(), nullptr, 10) : 0;
+		if (command == "move" && nTokens > 2) clientMove(client, id, tokens[2]);
+		else if (command == "new") newGame(client, tokens, nTokens);
+		else if (command == "join" && nTokens > 1) joinGame(client, id);
+		else if (command == "watch" && nTokens > 1) watchGames(client, tokens[1]);
+		else if (command == "leave" && nTokens > 1) {
+			auto found = games.find(id);
+			if (found != games.end() && (found->second.players[WHITE] == client.fd || found->second.players[BLACK] == client.fd))
+				endGame(id, GAME_LEFT);
+		}
+		else send(client.fd, "error unknown command " + command);
+	}
+
+	void readClient(int fd) {
+		auto found = clients.find(fd);
+		if (found == clients.end()) return;
+		ServerClient& client = found->second;
+		bool open = client.receive();
+		while (client.nextLine(line))
+			handleLine(client, line);
+		if (!open) {
+			if (client.lineTooLong) { // Best effort, the connection is closed right after
+				send(fd, "error line too long");
+				if (client.spectating) client.broadcast.flush(fd);
+				else client.flush();
+			}
+			closeClient(fd);
+		}
+	}
+
+	void handleEngineResults() {
+		enginePool.takeResults(engineResults);
+		for (const EngineResult& result : engineResults) {
+			auto found = games.find(result.gameId);
+			if (found == games.end()) continue; // Ended while the engine was thinking
+			ServerGame& game = found->second;
+			game.engineThinking = false;
+			int ending = playMove(result.gameId, game, result.move);
+			sendToPlayers(game, "move " + std::to_string(result.gameId) + " " + getMoveUCI(result.move));
+			afterMove(result.gameId, game, ending);
+		}
+	}
+
+	// Closing a client whose socket failed ends its games, which queues messages for its opponents
+	void flushClients() {
+		publishBroadcast();
+		dropSlowSpectators();
+		while (!clientsToFlush.empty()) {
+			flushBatch.swap(clientsToFlush);
+			for (int fd : flushBatch) {
+				auto found = clients.find(fd);
+				if (found == clients.end()) continue;
+				ServerClient& client = found->second;
+				client.queuedForFlush = false;
+				if (!(client.spectating ? client.broadcast.flush(fd) : client.flush())) {
+					closeClient(fd);
+					continue;
+				}
+				bool waitForWrite = client.spectating ? client.broadcast.hasPendingOutput() : client.hasPendingOutput();
+				if (waitForWrite != client.waitingForWrite) {
+					client.waitingForWrite = waitForWrite;
+					watch(fd, waitForWrite ? EPOLLIN | EPOLLOUT : EPOLLIN, EPOLL_CTL_MOD);
+				}
+			}
+			flushBatch.clear();
+		}
+	}
+
+public:
+
+	std::atomic<bool> running{ false };
+	long long movesPlayed = 0;
+	long long broadcastFrames = 0; // Frames queued for spectators, counted once per spectator
+	long long spectatorsDropped = 0;
+
+	GameServer(const ServerOptions& options) : options(options), enginePool(getEngineThreads(options.engineThreads), options.hashMB) {
+		scratchBoard.changeBoardState(SERVER_START_POSITION);
+		startPosition = scratchBoard.getSnapshot();
+	}
+
+	~GameServer() {
+		for (auto& client : clients)
+			close(client.first);
+		if (tcpFd != -1) close(tcpFd);
+		if (unixFd != -1) {
+			close(unixFd);
+			unlink(options.unixPath.c_str());
+		}
+		if (epollFd != -1) close(epollFd);
+	}
+
+	bool start() {
+		raiseFileLimit();
+		epollFd = epoll_create1(EPOLL_CLOEXEC);
+		if (epollFd == -1) return false;
+		if (options.port > 0) {
+			tcpFd = listenTCP(options.port);
+			if (tcpFd == -1) {
+				LOG_ERROR("Failed to listen on TCP port %d: %s", options.port, std::strerror(errno));
+				return false;
+			}
+			watch(tcpFd, EPOLLIN);
+			LOG_INFO("Listening on TCP port %d", options.port);
+		}
+		if (!options.unixPath.empty()) {
+			unixFd = listenUnix(options.unixPath);
+			if (unixFd == -1) {
+				LOG_ERROR("Failed to listen on %s: %s", options.unixPath.c_str(), std::strerror(errno));
+				return false;
+			}
+			watch(unixFd, EPOLLIN);
+			LOG_INFO("Listening on %s", options.unixPath.c_str());
+		}
+		watch(enginePool.getNotifyFd(), EPOLLIN);
+		running = true;
+		return true;
+	}
+
+	// Returns when running is cleared, checked at least every timeout
+	void run(int timeoutMs = 200) {
+		epoll_event events[MAX_EPOLL_EVENTS];
+		while (running) {
+			int nEvents = epoll_wait(epollFd, events, MAX_EPOLL_EVENTS, timeoutMs);
+			for (int i = 0; i < nEvents; i++) {
+				int fd = events[i].data.fd;
+				if (fd == tcpFd || fd == unixFd) acceptClients(fd);
+				else if (fd == enginePool.getNotifyFd()) handleEngineResults();
+				else {
+					auto found = clients.find(fd);
+					if ((events[i].events & EPOLLOUT) && found != clients.end() && !found->second.queuedForFlush) {
+						found->second.queuedForFlush = true;
+						clientsToFlush.push_back(fd);
+					}
+					if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) readClient(fd);
+				}
+			}
+			flushClients();
+		}
+	}
+
+	int getClientCount() { return (int)clients.size(); }
+	int getGameCount() { return (int)games.size(); }
+	int getSpectatorCount() {
+		int count = 0;
+		for (auto& client : clients)
+			count += client.second.spectating;
+		return count;
+	}
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <string>
+
+#include "index_model/board.h"
+
+// Text protocol of chess-server, one message per line and moves in UCI coordinate notation. Lines longer
+// than MAX_LINE_LENGTH (server/socket.h) are answered with error line too long and the connection is closed.
+//
+// Client to server:
+//   new <white|black|both|human> [depth]   Play white or black against the engine, both sides, or open a
+//                                          game for a second player. depth sets the engine's search depth
+//   join <game>                            Take the black side of an open game
+//   move <game> <move>
+//   leave <game>
+//   watch <game|all>                       Switches the connection to the binary spectator stream of
+//                                          server/broadcast.h, for one game or for every game
+//
+// Server to client:
+//   game <game> <white|black|both>         The game was created or joined, and the side played
+//   joined <game>                          Someone took the other side of an open game
+//   ok <game> <move>                       The move was legal and has been played
+//   illegal <game> <move>
+//   move <game> <move>                     Move of the engine or of the other player
+//   end <game> <reason>                    Sent to the players after the move that ended the game
+//   error <message>
+#define DEFAULT_SERVER_PORT 7777
+#define DEFAULT_SERVER_SOCKET "/tmp/chess-server.sock"
+#define DEFAULT_ENGINE_DEPTH 4
+#define MAX_ENGINE_DEPTH 12
+
+#define GAME_ABANDONED 6 // Ending reasons after those of checkGameEnded
+#define GAME_LEFT 7
+
+const std::string SERVER_START_POSITION = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+inline const char* getEndingName(int ending) {
+	const char* names[8] = { "none", "checkmate", "stalemate", "insufficient", "repetition", "moverule", "abandoned", "left" };
+	return ending >= 0 && ending < 8 ? names[ending] : "unknown";
+}
+
+#endif
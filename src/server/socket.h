@@ -0,0 +1,236 @@
+#ifndef SOCKET_H
+#define SOCKET_H
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+const int LISTEN_BACKLOG = 4096;
+const size_t READ_CHUNK_SIZE = 16384;
+const size_t MAX_LINE_LENGTH = 4096; // Longer partial lines close the connection, bounding the memory of a peer
+
+inline bool setNonBlocking(int fd) {
+	int flags = fcntl(fd, F_GETFL, 0);
+	return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+// Lines are short and answered one at a time, so Nagle's delay would only add latency
+inline void setNoDelay(int fd) {
+	int on = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+// Many thousand connections need more descriptors than the usual soft limit
+inline void raiseFileLimit() {
+	rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+}
+
+// Non-blocking listening sockets, -1 on failure
+inline int listenTCP(int port) {
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd == -1) return -1;
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons((uint16_t)port);
+	if (bind(fd, (sockaddr*)&address, sizeof(address)) == -1 || listen(fd, LISTEN_BACKLOG) == -1) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+inline int listenUnix(const std::string& path) {
+	sockaddr_un address = {};
+	if (path.size() >= sizeof(address.sun_path)) return -1;
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd == -1) return -1;
+	address.sun_family = AF_UNIX;
+	std::strcpy(address.sun_path, path.c_str());
+	unlink(path.c_str()); // Left behind by a server that did not shut down
+	if (bind(fd, (sockaddr*)&address, sizeof(address)) == -1 || listen(fd, LISTEN_BACKLOG) == -1) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// Blocking connects, the socket is made non-blocking afterwards by the caller if needed
+inline int connectTCP(const std::string& host, int port) {
+	addrinfo hints = {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo* addresses = nullptr;
+	if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+		return -1;
+	int fd = -1;
+	for (addrinfo* address = addresses; address; address = address->ai_next) {
+		fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+		if (fd == -1) continue;
+		if (connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+			setNoDelay(fd);
+			break;
+		}
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(addresses);
+	return fd;
+}
+
+inline int connectUnix(const std::string& path) {
+	sockaddr_un address = {};
+	if (path.size() >= sizeof(address.sun_path)) return -1;
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd == -1) return -1;
+	address.sun_family = AF_UNIX;
+	std::strcpy(address.sun_path, path.c_str());
+	if (connect(fd, (sockaddr*)&address, sizeof(address)) == -1) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// Non-blocking connect for clients that cannot wait, such as a render loop. The socket is returned while
+// the connection is still being set up, finishConnect tells when it is done. Only name resolution blocks
+inline int startConnect(const std::string& host, int port) {
+	addrinfo hints = {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo* addresses = nullptr;
+	if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+		return -1;
+	int fd = -1;
+	for (addrinfo* address = addresses; address; address = address->ai_next) {
+		fd = socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, address->ai_protocol);
+		if (fd == -1) continue;
+		if (connect(fd, address->ai_addr, address->ai_addrlen) == 0 || errno == EINPROGRESS) {
+			setNoDelay(fd);
+			break;
+		}
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(addresses);
+	return fd;
+}
+
+inline int startConnectUnix(const std::string& path) {
+	sockaddr_un address = {};
+	if (path.size() >= sizeof(address.sun_path)) return -1;
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd == -1) return -1;
+	address.sun_family = AF_UNIX;
+	std::strcpy(address.sun_path, path.c_str());
+	if (connect(fd, (sockaddr*)&address, sizeof(address)) == -1 && errno != EINPROGRESS && errno != EAGAIN) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// 1 once a started connect succeeded, 0 while it is in progress, -1 if it failed
+inline int finishConnect(int fd) {
+	pollfd request = { fd, POLLOUT, 0 };
+	int ready = poll(&request, 1, 0);
+	if (ready == 0) return 0;
+	if (ready == -1) return errno == EINTR ? 0 : -1;
+	int error = 0;
+	socklen_t length = sizeof(error);
+	if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == -1 || error != 0) return -1;
+	return 1;
+}
+
+// Buffers of one non-blocking stream socket carrying newline separated messages
+struct LineConnection {
+	int fd = -1;
+	std::string input;
+	size_t inputOffset = 0;  // Start of the first line not handled yet
+	size_t lineStart = 0;    // Start of the line still missing its newline
+	bool lineTooLong = false;
+	std::string output;
+	size_t outputOffset = 0; // Start of the bytes not sent yet
+
+	// Reads what is available, false once the peer closed, the socket failed or a line grew longer than
+	// MAX_LINE_LENGTH, which sets lineTooLong. The complete lines before it can still be taken
+	bool receive() {
+		if (inputOffset > 0) {
+			input.erase(0, inputOffset);
+			lineStart -= inputOffset;
+			inputOffset = 0;
+		}
+		while (true) {
+			size_t size = input.size();
+			input.resize(size + READ_CHUNK_SIZE);
+			ssize_t received = recv(fd, &input[size], READ_CHUNK_SIZE, 0);
+			input.resize(size + (received > 0 ? received : 0));
+			if (received > 0) {
+				size_t end = input.rfind('\n');
+				if (end != std::string::npos && end >= size) lineStart = end + 1;
+				if (input.size() - lineStart > MAX_LINE_LENGTH) {
+					lineTooLong = true;
+					input.resize(lineStart);
+					return false;
+				}
+				continue;
+			}
+			if (received == 0) return false;
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+		}
+	}
+
+	// Next complete line without the newline, false when only a partial line is left
+	bool nextLine(std::string& line) {
+		size_t end = input.find('\n', inputOffset);
+		if (end == std::string::npos) return false;
+		line.assign(input, inputOffset, end - inputOffset);
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+		inputOffset = end + 1;
+		return true;
+	}
+
+	void send(const std::string& line) {
+		output += line;
+		output += '\n';
+	}
+
+	bool hasPendingOutput() { return outputOffset < output.size(); }
+
+	// Sends as much as the socket takes, false if it failed
+	bool flush() {
+		while (outputOffset < output.size()) {
+			ssize_t sent = ::send(fd, output.data() + outputOffset, output.size() - outputOffset, MSG_NOSIGNAL);
+			if (sent > 0) {
+				outputOffset += sent;
+				continue;
+			}
+			if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) break;
+			return false;
+		}
+		if (outputOffset == output.size()) {
+			output.clear();
+			outputOffset = 0;
+		}
+		return true;
+	}
+};
+
+#endif
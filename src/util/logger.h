@@ -0,0 +1,200 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_NONE 4
+
+// Calls below this level are removed by the preprocessor, set with -DLOG_MIN_LEVEL=...
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_LEVEL_INFO
+#endif
+
+const int LOG_MESSAGE_SIZE = 1024;        // Longer messages are cut off, shader info logs fit
+const uint32_t LOG_RING_SIZE = 256;       // Records per thread, a power of two
+const int LOG_DRAIN_INTERVAL_MS = 20;
+
+struct LogRecord {
+	int level;
+	double milliseconds; // Since the logger started
+	char message[LOG_MESSAGE_SIZE];
+};
+
+// Single producer single consumer queue of one thread's records. The writing thread only moves head
+// and the draining thread only moves tail, so neither has to lock
+struct LogRing {
+	LogRecord records[LOG_RING_SIZE];
+	std::atomic<uint32_t> head{ 0 };
+	std::atomic<uint32_t> tail{ 0 };
+	std::atomic<bool> inUse{ true };
+
+	LogRecord* beginWrite() {
+		uint32_t position = head.load(std::memory_order_relaxed);
+		if (position - tail.load(std::memory_order_acquire) == LOG_RING_SIZE)
+			return nullptr;
+		return &records[position & (LOG_RING_SIZE - 1)];
+	}
+
+	void endWrite() { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+	bool isEmpty() { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_relaxed); }
+};
+
+// Log calls format into the calling thread's ring and return, a background thread writes the records
+// to stderr or a file. Nothing is allocated per call, only the first call of a thread sets up its ring.
+// When a ring is full the record is dropped and counted instead of waiting for the writer
+class Logger {
+
+	std::vector<std::unique_ptr<LogRing>> rings;
+	std::mutex ringsMutex;      // Guards the list of rings, and lets one thread drain at a time
+	std::condition_variable wakeUp;
+	std::thread writer;
+	bool stopping = false;
+	FILE* output = stderr;
+	std::atomic<long long> droppedRecords{ 0 };
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	struct RingHandle {
+		LogRing* ring = nullptr;
+		~RingHandle() { if (ring) ring->inUse.store(false, std::memory_order_release); }
+	};
+
+	Logger() { writer = std::thread(&Logger::run, this); }
+
+	~Logger() {
+		{
+			std::lock_guard<std::mutex> lock(ringsMutex);
+			stopping = true;
+		}
+		wakeUp.notify_one();
+		writer.join();
+		if (output != stderr) std::fclose(output);
+	}
+
+	// Rings of threads that have exited are handed to new threads once they have been written out
+	LogRing* acquireRing() {
+		std::lock_guard<std::mutex> lock(ringsMutex);
+		for (auto& ring : rings)
+			if (!ring->inUse.load(std::memory_order_acquire) && ring->isEmpty()) {
+				ring->inUse.store(true, std::memory_order_relaxed);
+				return ring.get();
+			}
+		rings.emplace_back(new LogRing());
+		return rings.back().get();
+	}
+
+	LogRing* getThreadRing() {
+		thread_local RingHandle handle;
+		if (!handle.ring) handle.ring = acquireRing();
+		return handle.ring;
+	}
+
+	// Called with ringsMutex held
+	void drainRings() {
+		for (auto& ring : rings) {
+			uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+			uint32_t head = ring->head.load(std::memory_order_acquire);
+			for (; tail != head; tail++) {
+				const LogRecord& record = ring->records[tail & (LOG_RING_SIZE - 1)];
+				std::fprintf(output, "[%10.3f] %s %s\n", record.milliseconds / 1000.0, getLevelName(record.level), record.message);
+			}
+			ring->tail.store(tail, std::memory_order_release);
+		}
+		long long dropped = droppedRecords.exchange(0, std::memory_order_relaxed);
+		if (dropped > 0) std::fprintf(output, "[logger] %lld records dropped, buffers were full\n", dropped);
+		std::fflush(output);
+	}
+
+	void run() {
+		std::unique_lock<std::mutex> lock(ringsMutex);
+		while (!stopping) {
+			wakeUp.wait_for(lock, std::chrono::milliseconds(LOG_DRAIN_INTERVAL_MS));
+			drainRings();
+		}
+		drainRings();
+	}
+
+public:
+
+	static Logger& get() {
+		static Logger logger;
+		return logger;
+	}
+
+	static const char* getLevelName(int level) {
+		const char* names[4] = { "DEBUG", "INFO", "WARNING", "ERROR" };
+		return level >= 0 && level < 4 ? names[level] : "";
+	}
+
+	// Records already queued are written to the new output, stderr if the file can not be opened
+	bool setOutputFile(const char* path) {
+		FILE* file = std::fopen(path, "a");
+		std::lock_guard<std::mutex> lock(ringsMutex);
+		drainRings();
+		if (output != stderr) std::fclose(output);
+		output = file ? file : stderr;
+		return file != nullptr;
+	}
+
+	void log(int level, const char* format, ...) {
+		LogRing* ring = getThreadRing();
+		LogRecord* record = ring->beginWrite();
+		if (!record) {
+			droppedRecords.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		record->level = level;
+		record->milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		va_list args;
+		va_start(args, format);
+		std::vsnprintf(record->message, LOG_MESSAGE_SIZE, format, args);
+		va_end(args);
+		ring->endWrite();
+		if (level >= LOG_LEVEL_ERROR) wakeUp.notify_one();
+	}
+
+	// Blocks until everything logged so far has been written
+	void flush() {
+		std::lock_guard<std::mutex> lock(ringsMutex);
+		drainRings();
+	}
+};
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) Logger::get().log(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(...) Logger::get().log(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) ((void)0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_WARNING
+#define LOG_WARNING(...) Logger::get().log(LOG_LEVEL_WARNING, __VA_ARGS__)
+#else
+#define LOG_WARNING(...) ((void)0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) Logger::get().log(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) ((void)0)
+#endif
+
+#endif
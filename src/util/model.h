@@ -13,6 +13,7 @@
 
 #include "util/mesh.h"
 #include "util/shader.h"
+#include "util/logger.h"
 
 #include <string>
 #include <iostream>
@@ -44,7 +45,7 @@ private:
         const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
 
         if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+            LOG_ERROR("ERROR::ASSIMP:: %s", importer.GetErrorString());
             return;
         }
         directory = path.substr(0, path.find_last_of('/'));
@@ -189,10 +190,10 @@ unsigned int TextureFromFile(const char* path, const string& directory, bool gam
         stbi_image_free(data);
     }
     else {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
+        LOG_ERROR("Texture failed to load at path: %s", path);
         stbi_image_free(data);
     }
 
     return textureID;
 }
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -13,6 +13,8 @@
 #include <vector>
 #include <fstream>
 
+#include "util/logger.h"
+
 unsigned int loadTexture(char const* path) {
     unsigned int textureID;
     glGenTextures(1, &textureID);
@@ -42,7 +44,7 @@ unsigned int loadTexture(char const* path) {
     }
     else
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
+        LOG_ERROR("Texture failed to load at path: %s", path);
         stbi_image_free(data);
     }
 
@@ -63,10 +65,10 @@ std::vector<float> loadVertexData(std::string filepath) {
         return data;
     }
     else {
-        std::cout << "Failed to read vertex data at path: " << filepath << std::endl;
+        LOG_ERROR("Failed to read vertex data at path: %s", filepath.c_str());
         return {};
     }
     vertexFile.close();
 }
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -13,6 +13,7 @@
 #include FT_FREETYPE_H
 
 #include "shader.h"
+#include "util/logger.h"
 
 #include <map>
 #include <string>
@@ -41,12 +42,12 @@ public:
     int initializeFont(const char* path) {
         FT_Library ft;
         if (FT_Init_FreeType(&ft)) {
-            std::cout << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
+            LOG_ERROR("ERROR::FREETYPE: Could not init FreeType Library");
             return -1;
         }
         FT_Face face;
         if (FT_New_Face(ft, path, 0, &face)) {
-            std::cout << "ERROR::FREETYPE: Failed to load font" << std::endl;
+            LOG_ERROR("ERROR::FREETYPE: Failed to load font");
             return -1;
         }
         FT_Set_Pixel_Sizes(face, 0, 60);
@@ -54,7 +55,7 @@ public:
         glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
         for (unsigned char c = 32; c < 128; c++) {
             if (FT_Load_Char(face, c, FT_LOAD_RENDER)) {
-                std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
+                LOG_ERROR("ERROR::FREETYPE: Failed to load glyph %d", c);
                 continue;
             }
             unsigned int texture;
@@ -154,4 +155,4 @@ public:
 
 
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "index_model/epd.h"
+#include "server/analysis_pool.h"
+#include "server/analysis_server.h"
+#include "util/logger.h"
+
+AnalysisServer* server = nullptr;
+
+void stopServer(int) {
+	if (server) server->running = false;
+}
+
+// Usage: chess-analysis [options] <file.epd>      Analyses every position of the file and prints the results
+//        chess-analysis [options] --serve [path]  Takes jobs over a Unix socket, see server/analysis_server.h
+// Options: --threads N, --hash MB, and the default limits --depth N, --nodes N, --movetime ms. EPD
+// operations of a position override the defaults, as do those of an analyze command. --cache <path> keeps
+// deep results in a persistent analysis cache of --cache-size MB that later runs start from
+int main(int argc, char** argv) {
+
+	AnalysisOptions options;
+	std::string batchPath;
+	bool serve = false, hasDepth = false;
+	for (int i = 1; i < argc; i++) {
+		bool hasValue = i + 1 < argc;
+		if (!std::strcmp(argv[i], "--serve")) {
+			serve = true;
+			if (hasValue && argv[i + 1][0] != '-') options.unixPath = argv[++i];
+		}
+		else if (!std::strcmp(argv[i], "--threads") && hasValue) options.threads = std::atoi(argv[++i]);
+		else if (!std::strcmp(argv[i], "--hash") && hasValue) options.hashMB = std::max(1, std::atoi(argv[++i]));
+		else if (!std::strcmp(argv[i], "--depth") && hasValue) {
+			options.limits.depth = std::max(1, std::atoi(argv[++i]));
+			hasDepth = true;
+		}
+		else if (!std::strcmp(argv[i], "--nodes") && hasValue) options.limits.nodes = std::atoll(argv[++i]);
+		else if (!std::strcmp(argv[i], "--movetime") && hasValue) options.limits.milliseconds = std::atof(argv[++i]);
+		else if (!std::strcmp(argv[i], "--cache") && hasValue) options.cachePath = argv[++i];
+		else if (!std::strcmp(argv[i], "--cache-size") && hasValue) options.cacheMB = std::max(1, std::atoi(argv[++i]));
+		else if (!std::strcmp(argv[i], "--log") && hasValue) Logger::get().setOutputFile(argv[++i]);
+		else batchPath = argv[i];
+	}
+	if (!hasDepth && (options.limits.nodes > 0 || options.limits.milliseconds > 0.0))
+		options.limits.depth = MAX_SEARCH_PLY - 1;
+
+	if (serve) {
+		AnalysisServer analysisServer(options);
+		if (!analysisServer.start())
+			return 1;
+		server = &analysisServer;
+		std::signal(SIGINT, stopServer);
+		std::signal(SIGTERM, stopServer);
+		std::signal(SIGPIPE, SIG_IGN);
+		analysisServer.run();
+		LOG_INFO("Stopped after %lld jobs: %s", analysisServer.jobsReceived, formatAnalysisMetrics(analysisServer.getPool().getMetrics()).c_str());
+		return 0;
+	}
+
+	if (batchPath.empty()) {
+		std::cout << "Usage: chess-analysis [--threads N] [--hash MB] [--depth N] [--nodes N] [--movetime ms] [--cache <path>] "
+			"[--cache-size MB] <file.epd | --serve [path]>\n";
+		return 1;
+	}
+	std::vector<EPDRecord> records = loadEPDFile(batchPath);
+	if (records.empty()) {
+		std::cout << "No positions in " << batchPath << "\n";
+		return 1;
+	}
+
+	// Results are printed in the order of the file, the pool finishes them in any order
+	AnalysisCache analysisCache;
+	bool hasCache = !options.cachePath.empty() && analysisCache.open(options.cachePath, options.cacheMB);
+	AnalysisPool pool(options.threads > 0 ? options.threads : std::max(1, (int)std::thread::hardware_concurrency()), options.hashMB,
+		hasCache ? &analysisCache : nullptr);
+	for (size_t i = 0; i < records.size(); i++)
+		pool.submit(makeAnalysisJob(records[i], options.limits, std::to_string(i + 1)));
+	pool.waitIdle();
+
+	std::vector<AnalysisResult> results;
+	pool.takeResults(results);
+	std::sort(results.begin(), results.end(), [](const AnalysisResult& a, const AnalysisResult& b) { return a.id < b.id; });
+	for (const AnalysisResult& result : results)
+		std::cout << formatAnalysisResult(result) << "\n";
+	std::cout << formatAnalysisMetrics(pool.getMetrics()) << "\n";
+	return 0;
+}
@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "index_model/batch_evaluation.h"
+#include "index_model/board.h"
+#include "index_model/evaluation.h"
+#include "index_model/move.h"
+#include "index_model/move_gen.h"
+#include "index_model/perft.h"
+
+const int DEFAULT_REPETITIONS = 50;
+const double WARMUP_MILLISECONDS = 100.0;
+const double REPETITION_MILLISECONDS = 5.0; // Long enough that the clock resolution does not matter
+
+struct BenchmarkResult {
+	std::string name;
+	long long opsPerRepetition;
+	int repetitions;
+	double median; // Nanoseconds per operation
+	double p99;
+	double mean;
+	double min;
+};
+
+long long sink = 0; // Keeps results alive so the compiler can not drop the measured work
+
+// Runs one pass over the positions per call and returns the number of operations it did.
+// Passes are batched until a repetition takes REPETITION_MILLISECONDS, after a warmup
+BenchmarkResult runBenchmark(const std::string& name, int repetitions, const std::function<long long()>& pass) {
+	using Clock = std::chrono::steady_clock;
+
+	long long warmupPasses = 0;
+	auto start = Clock::now();
+	while (std::chrono::duration<double, std::milli>(Clock::now() - start).count() < WARMUP_MILLISECONDS) {
+		pass();
+		warmupPasses++;
+	}
+	double passMilliseconds = WARMUP_MILLISECONDS / warmupPasses;
+	long long passesPerRepetition = std::max(1LL, (long long)(REPETITION_MILLISECONDS / passMilliseconds));
+
+	std::vector<double> samples;
+	long long ops = 0;
+	for (int i = 0; i < repetitions; i++) {
+		ops = 0;
+		auto repetitionStart = Clock::now();
+		for (long long j = 0; j < passesPerRepetition; j++)
+			ops += pass();
+		double nanoseconds = std::chrono::duration<double, std::nano>(Clock::now() - repetitionStart).count();
+		samples.push_back(nanoseconds / ops);
+	}
+	std::sort(samples.begin(), samples.end());
+
+	BenchmarkResult result;
+	result.name = name;
+	result.opsPerRepetition = ops;
+	result.repetitions = repetitions;
+	result.median = samples[samples.size() / 2];
+	result.p99 = samples[std::min(samples.size() - 1, (size_t)(samples.size() * 0.99))];
+	result.min = samples[0];
+	result.mean = 0.0;
+	for (double sample : samples)
+		result.mean += sample / samples.size();
+	return result;
+}
+
+std::string formatJSON(const std::vector<BenchmarkResult>& results) {
+	std::ostringstream json;
+	json << "{\"benchmarks\":[";
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchmarkResult& result = results[i];
+		json << (i > 0 ? "," : "") << "\n  {\"name\":\"" << result.name << "\",\"repetitions\":" << result.repetitions
+			<< ",\"opsPerRepetition\":" << result.opsPerRepetition << ",\"medianNs\":" << result.median
+			<< ",\"p99Ns\":" << result.p99 << ",\"meanNs\":" << result.mean << ",\"minNs\":" << result.min << "}";
+	}
+	json << "\n]}\n";
+	return json.str();
+}
+
+// Usage: chess-bench [--json] [--repetitions N] [--filter <name part>]
+// Times the board primitives over the perft reference positions, results are nanoseconds per operation
+int main(int argc, char** argv) {
+
+	bool json = false;
+	int repetitions = DEFAULT_REPETITIONS;
+	std::string filter;
+	for (int i = 1; i < argc; i++) {
+		if (!std::strcmp(argv[i], "--json")) json = true;
+		else if (!std::strcmp(argv[i], "--repetitions") && i + 1 < argc) repetitions = std::max(1, std::atoi(argv[++i]));
+		else if (!std::strcmp(argv[i], "--filter") && i + 1 < argc) filter = argv[++i];
+	}
+
+	std::vector<std::string> states;
+	for (const PerftPosition& position : perftPositions)
+		states.push_back(position.state);
+
+	std::vector<ChessBoardIndex> boards(states.size());
+	std::vector<ChessMoves> legalMoves(states.size());
+	std::vector<ChessMoves> pseudoLegalMoves(states.size());
+	MoveGenerator moveGenerator;
+	for (size_t i = 0; i < states.size(); i++) {
+		boards[i].changeBoardState(states[i]);
+		boards[i].generateLegalMoves(legalMoves[i]);
+		moveGenerator.updatePossibleMoves(boards[i].mailbox, boards[i].pieceList, pseudoLegalMoves[i], boards[i].sideToMove);
+	}
+
+	// The positions after every legal move, enough to fill batches. The batch evaluator has to score each
+	// of them exactly like the evaluator
+	std::vector<ChessBoardIndex> evalBoards;
+	for (size_t i = 0; i < states.size(); i++)
+		for (int j = 0; j < legalMoves[i].nMoves; j++) {
+			evalBoards.emplace_back();
+			evalBoards.back().changeBoardState(states[i]);
+			evalBoards.back().makeMove(legalMoves[i][j], false, false, false);
+		}
+	std::unique_ptr<Evaluator> evaluator(new Evaluator());
+	std::unique_ptr<BatchEvaluator> batchEvaluator(new BatchEvaluator());
+	std::vector<EvalBatch> batches((evalBoards.size() + EVAL_BATCH_SIZE - 1) / EVAL_BATCH_SIZE);
+	int batchScores[EVAL_BATCH_SIZE];
+	int mismatches = 0;
+	for (size_t i = 0; i < evalBoards.size(); i++)
+		batches[i / EVAL_BATCH_SIZE].add(evalBoards[i]);
+	for (size_t i = 0; i < batches.size(); i++) {
+		batchEvaluator->evaluate(batches[i], batchScores);
+		for (int lane = 0; lane < batches[i].nPositions; lane++)
+			mismatches += batchScores[lane] != evaluator->evaluate(evalBoards[i * EVAL_BATCH_SIZE + lane]);
+	}
+	if (mismatches > 0) {
+		std::printf("Batch evaluation (%s) differs from evaluate in %d of %zu positions\n", batchEvaluator->getInstructionSet(),
+			mismatches, evalBoards.size());
+		return 1;
+	}
+
+	std::vector<std::pair<std::string, std::function<long long()>>> benchmarks = {
+		{ "makeMove/unmakeMove", [&]() {
+			long long ops = 0;
+			for (size_t i = 0; i < boards.size(); i++)
+				for (int j = 0; j < legalMoves[i].nMoves; j++) {
+					MadeMove madeMove = boards[i].getMadeMove(legalMoves[i][j]);
+					boards[i].makeMove(legalMoves[i][j], false, false, false);
+					boards[i].unmakeMove(madeMove);
+					ops++;
+				}
+			return ops;
+		} },
+		{ "updatePossibleMoves", [&]() {
+			ChessMoves moves;
+			for (ChessBoardIndex& board : boards) {
+				moveGenerator.updatePossibleMoves(board.mailbox, board.pieceList, moves, board.sideToMove);
+				sink += moves.nMoves;
+			}
+			return (long long)boards.size();
+		} },
+		{ "squareIsAttacked", [&]() {
+			for (ChessBoardIndex& board : boards)
+				for (int square = 0; square < 64; square++)
+					sink += moveGenerator.squareIsAttacked(square, board.mailbox, board.sideToMove);
+			return (long long)boards.size() * 64;
+		} },
+		{ "filterPseudoLegalMoves", [&]() { // Includes copying the pseudo-legal list it filters
+			ChessMoves moves;
+			for (size_t i = 0; i < boards.size(); i++) {
+				moves = pseudoLegalMoves[i];
+				boards[i].filterPseudoLegalMoves(moves);
+				sink += moves.nMoves;
+			}
+			return (long long)boards.size();
+		} },
+		{ "checkGameEnded", [&]() { // Generates and filters the moves every time, not only the first
+			for (ChessBoardIndex& board : boards) {
+				board.invalidateAvailableMoves();
+				sink += board.checkGameEnded();
+			}
+			return (long long)boards.size();
+		} },
+		{ "changeBoardState", [&]() {
+			for (size_t i = 0; i < boards.size(); i++)
+				boards[i].changeBoardState(states[i]);
+			return (long long)boards.size();
+		} },
+		{ "evaluate", [&]() { // Hits the pawn hash table after the first pass, as the search mostly does
+			for (ChessBoardIndex& board : evalBoards)
+				sink += evaluator->evaluate(board);
+			return (long long)evalBoards.size();
+		} },
+		{ "evaluateBatch", [&]() {
+			for (EvalBatch& batch : batches) {
+				batchEvaluator->evaluate(batch, batchScores);
+				for (int lane = 0; lane < batch.nPositions; lane++)
+					sink += batchScores[lane];
+			}
+			return (long long)evalBoards.size();
+		} },
+		{ "getMove", [&]() {
+			long long ops = 0;
+			for (size_t i = 0; i < boards.size(); i++)
+				for (int j = 0; j < legalMoves[i].nMoves; j++) {
+					sink += boards[i].getMove(legalMoves[i][j].getFrom(), legalMoves[i][j].getTo()).getTo();
+					ops++;
+				}
+			return ops;
+		} }
+	};
+
+	std::vector<BenchmarkResult> results;
+	for (auto& benchmark : benchmarks) {
+		if (!filter.empty() && benchmark.first.find(filter) == std::string::npos)
+			continue;
+		results.push_back(runBenchmark(benchmark.first, repetitions, benchmark.second));
+		if (!json) {
+			const BenchmarkResult& result = results.back();
+			std::printf("%-24s median %9.1f ns/op   p99 %9.1f ns/op   mean %9.1f ns/op   min %9.1f ns/op\n",
+				result.name.c_str(), result.median, result.p99, result.mean, result.min);
+		}
+	}
+	if (json) std::cout << formatJSON(results);
+	return sink == -1 ? 1 : 0;
+}
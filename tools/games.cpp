@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "index_model/board.h"
+#include "index_model/game_record.h"
+#include "index_model/pgn.h"
+
+const int DEFAULT_BENCH_GAMES = 20000;
+const int MAX_RANDOM_GAME_PLIES = 160;
+const int RANDOM_ACCESS_READS = 10000;
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Games of random legal moves with a realistic set of tags, for benchmarking without a PGN collection
+static std::string makeRandomPGN(int nGames) {
+	std::mt19937 random(12345);
+	std::string pgn;
+	ChessBoardIndex board;
+	for (int i = 0; i < nGames; i++) {
+		GameRecord game;
+		game.tags = { { "Event", "Random games" }, { "Site", "?" }, { "Date", "2024.01.01" },
+			{ "Round", std::to_string(i + 1) }, { "White", "Player " + std::to_string(random() % 1000) },
+			{ "Black", "Player " + std::to_string(random() % 1000) }, { "Result", "*" } };
+		board.changeBoardState(PGN_START_POSITION);
+		int ending = 0;
+		int plies = 20 + random() % (MAX_RANDOM_GAME_PLIES - 20);
+		while (ending == 0 && (int)game.moves.size() < plies) {
+			const ChessMoves& moves = board.getAvailableMoves();
+			Move move = moves[random() % moves.nMoves];
+			ending = board.makeMove(move, false, true, false);
+			game.moves.push_back(move);
+		}
+		if (ending == CHECKMATE) game.result = board.sideToMove == WHITE ? GAME_RESULT_BLACK_WINS : GAME_RESULT_WHITE_WINS;
+		else if (ending != 0) game.result = GAME_RESULT_DRAW;
+		game.tags[6].second = getResultText(game.result);
+		pgn += getGamePGN(game);
+	}
+	return pgn;
+}
+
+static bool readFile(const std::string& path, std::string& contents) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) return false;
+	std::ostringstream text;
+	text << file.rdbuf();
+	contents = text.str();
+	return true;
+}
+
+static int convert(const std::string& pgnPath, const std::string& gamesPath) {
+	std::ifstream input(pgnPath);
+	GameFileWriter writer;
+	if (!input.is_open() || !writer.open(gamesPath)) {
+		std::cout << "Failed to open " << (input.is_open() ? gamesPath : pgnPath) << "\n";
+		return 1;
+	}
+	PGNReader reader(input);
+	GameRecord game;
+	int malformed = 0;
+	while (reader.next(game)) {
+		malformed += reader.malformed;
+		writer.write(game);
+	}
+	uint64_t nGames = writer.getGameCount();
+	writer.close();
+	std::cout << "Wrote " << nGames << " games, " << malformed << " cut off at a move that could not be read\n";
+	return 0;
+}
+
+static int exportGames(const std::string& gamesPath, uint64_t first, uint64_t count) {
+	GameFileReader reader;
+	if (!reader.open(gamesPath)) {
+		std::cout << "Failed to read " << gamesPath << "\n";
+		return 1;
+	}
+	GameRecord game;
+	uint64_t end = std::min(reader.getGameCount(), count == 0 ? reader.getGameCount() : first + count);
+	for (uint64_t i = first; i < end; i++) {
+		if (!reader.readGame(i, game)) {
+			std::cout << "Game " << i << " is damaged\n";
+			return 1;
+		}
+		std::cout << getGamePGN(game);
+	}
+	return 0;
+}
+
+// Compares the size of a collection as PGN and as a game file, and how many games per second each is
+// read at. Both are read from memory so only parsing is measured, the game file also by random access
+static int bench(const std::string& pgnPath, int nRandomGames) {
+	std::string pgn;
+	if (!pgnPath.empty() && !readFile(pgnPath, pgn)) {
+		std::cout << "Failed to read " << pgnPath << "\n";
+		return 1;
+	}
+	if (pgnPath.empty()) pgn = makeRandomPGN(nRandomGames);
+
+	std::istringstream pgnInput(pgn);
+	PGNReader pgnReader(pgnInput);
+	std::vector<GameRecord> games;
+	GameRecord game;
+	long long nMoves = 0;
+	Clock::time_point start = Clock::now();
+	while (pgnReader.next(game)) {
+		nMoves += game.moves.size();
+		games.push_back(game);
+	}
+	double pgnSeconds = secondsSince(start);
+	if (games.empty()) {
+		std::cout << "No games\n";
+		return 1;
+	}
+
+	GameRecordCodec codec;
+	std::string encoded;
+	std::vector<size_t> offsets;
+	for (const GameRecord& record : games) {
+		offsets.push_back(encoded.size());
+		codec.encode(record, encoded);
+	}
+	offsets.push_back(encoded.size());
+	size_t fileSize = GAME_RECORD_HEADER_SIZE + encoded.size() + offsets.size() * 8;
+
+	int mismatches = 0;
+	start = Clock::now();
+	for (size_t i = 0; i + 1 < offsets.size(); i++) {
+		codec.decode(encoded.data() + offsets[i], offsets[i + 1] - offsets[i], game);
+		mismatches += game.moves != games[i].moves;
+	}
+	double binarySeconds = secondsSince(start);
+
+	std::string tempPath = "chess-games-bench.tmp";
+	GameFileWriter writer;
+	writer.open(tempPath);
+	for (const GameRecord& record : games)
+		writer.write(record);
+	writer.close();
+	GameFileReader fileReader;
+	fileReader.open(tempPath);
+	std::mt19937 random(54321);
+	start = Clock::now();
+	for (int i = 0; i < RANDOM_ACCESS_READS; i++) {
+		uint64_t index = random() % fileReader.getGameCount();
+		fileReader.readGame(index, game);
+		mismatches += game.moves != games[index].moves;
+	}
+	double randomSeconds = secondsSince(start);
+	std::remove(tempPath.c_str());
+
+	std::printf("Games            : %zu, %lld moves\n", games.size(), nMoves);
+	std::printf("PGN              : %10zu bytes  %8.1f bytes/game  %10.0f games/s\n", pgn.size(),
+		(double)pgn.size() / games.size(), games.size() / pgnSeconds);
+	std::printf("Game file        : %10zu bytes  %8.1f bytes/game  %10.0f games/s  (%.1fx smaller, %.1fx faster)\n", fileSize,
+		(double)fileSize / games.size(), games.size() / binarySeconds, (double)pgn.size() / fileSize, pgnSeconds / binarySeconds);
+	std::printf("Random access    : %10.0f games/s\n", RANDOM_ACCESS_READS / randomSeconds);
+	std::printf("Mismatches       : %d\n", mismatches);
+	return mismatches == 0 ? 0 : 1;
+}
+
+// Usage: chess-games convert <in.pgn> <out.games>   stores a PGN collection as a game file
+//        chess-games export <in.games> [first] [count]  prints games of a game file as PGN
+//        chess-games bench [<file.pgn> | --random N]  compares size and read speed of PGN and game files
+// The game file format is described in index_model/game_record.h
+int main(int argc, char** argv) {
+
+	std::string command = argc > 1 ? argv[1] : "";
+	if (command == "convert" && argc >= 4)
+		return convert(argv[2], argv[3]);
+	if (command == "export" && argc >= 3)
+		return exportGames(argv[2], argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 0, argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 0);
+	if (command == "bench") {
+		if (argc >= 4 && std::string(argv[2]) == "--random")
+			return bench("", std::max(1, std::atoi(argv[3])));
+		return bench(argc >= 3 ? argv[2] : "", DEFAULT_BENCH_GAMES);
+	}
+	std::cout << "Usage: chess-games convert <in.pgn> <out.games>\n"
+		"       chess-games export <in.games> [first] [count]\n"
+		"       chess-games bench [<file.pgn> | --random N]\n";
+	return 1;
+}
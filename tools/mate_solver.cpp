@@ -0,0 +1,82 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "index_model/epd.h"
+#include "index_model/mate_solver.h"
+#include "index_model/notation.h"
+
+static std::string stripCheckSymbols(std::string san) {
+	while (!san.empty() && (san.back() == '+' || san.back() == '#' || san.back() == '!' || san.back() == '?'))
+		san.pop_back();
+	return san;
+}
+
+// Usage: chess-mate <file.epd> [max nodes] [mate in]
+// Solves each position for the mate in its dm operation, or the mate in given here when it has none.
+// A solution is checked against the bm operation when there is one
+int main(int argc, char** argv) {
+
+	if (argc < 2) {
+		std::cout << "Usage: chess-mate <file.epd> [max nodes] [mate in]\n";
+		return 1;
+	}
+	std::vector<EPDRecord> records = loadEPDFile(argv[1]);
+	int maxNodes = argc >= 3 ? std::atoi(argv[2]) : DEFAULT_MATE_NODES;
+	int defaultMateIn = argc >= 4 ? std::atoi(argv[3]) : 3;
+	if (records.empty()) {
+		std::cout << "No positions in " << argv[1] << "\n";
+		return 1;
+	}
+
+	MateSolver solver(maxNodes);
+	int nProven = 0, nDisproven = 0, nUnknown = 0, nWrongMove = 0;
+	long long totalNodes = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < records.size(); i++) {
+		const EPDRecord& record = records[i];
+		std::string operand = record.getOperation("dm");
+		int mateIn = operand.empty() ? defaultMateIn : std::atoi(operand.c_str());
+
+		auto positionStart = std::chrono::steady_clock::now();
+		MateResult result = solver.solve(record.state, mateIn);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - positionStart).count();
+		totalNodes += result.nodes;
+
+		std::cout << record.getOperation("id", std::to_string(i + 1)) << "  ";
+		if (result.result == MATE_PROVEN) {
+			nProven++;
+			std::string san = getMoveSAN(solver.getBoard(), result.line[0]);
+			std::cout << "mate in " << result.mateIn << "  " << san;
+
+			std::istringstream bestMoves(record.getOperation("bm"));
+			std::string bestMove;
+			bool hasBestMoves = false, matched = false;
+			while (bestMoves >> bestMove) {
+				hasBestMoves = true;
+				matched |= stripCheckSymbols(bestMove) == stripCheckSymbols(san);
+			}
+			if (hasBestMoves && !matched) {
+				nWrongMove++;
+				std::cout << " (expected " << record.getOperation("bm") << ")";
+			}
+		}
+		else if (result.result == MATE_DISPROVEN) {
+			nDisproven++;
+			std::cout << "no mate in " << mateIn;
+		}
+		else {
+			nUnknown++;
+			std::cout << "unknown, node limit reached";
+		}
+		std::cout << "  nodes " << result.nodes << "  " << seconds << "s\n";
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Proven: " << nProven << "  Disproven: " << nDisproven << "  Unknown: " << nUnknown << "  Wrong move: " << nWrongMove << "\n";
+	std::cout << records.size() << " positions in " << seconds << "s, " << records.size() / seconds << " positions/s, "
+		<< (long long)(totalNodes / seconds) << " nodes/s\n";
+	return 0;
+}
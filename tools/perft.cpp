@@ -0,0 +1,42 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "index_model/board.h"
+#include "index_model/perft.h"
+
+// Usage: chess-perft                 runs the reference positions and checks their node counts
+//        chess-perft "<FEN>" <depth>  counts the leaf nodes of a single position
+int main(int argc, char** argv) {
+
+	ChessBoardIndex board;
+	if (argc >= 3) {
+		board.changeBoardState(argv[1]);
+		auto start = std::chrono::steady_clock::now();
+		long long nodes = perft(board, std::atoi(argv[2]));
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "Nodes: " << nodes << "  Time: " << seconds << "s  NPS: " << (long long)(nodes / seconds) << "\n";
+		return 0;
+	}
+
+	long long totalNodes = 0;
+	double totalSeconds = 0.0;
+	bool allPassed = true;
+	for (const PerftPosition& position : perftPositions) {
+		board.changeBoardState(position.state);
+		auto start = std::chrono::steady_clock::now();
+		long long nodes = perft(board, position.depth);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		bool passed = nodes == position.nodes;
+		allPassed &= passed;
+		totalNodes += nodes;
+		totalSeconds += seconds;
+		std::cout << (passed ? "OK   " : "FAIL ") << position.state << "  depth " << position.depth << "  nodes " << nodes;
+		if (!passed) std::cout << " (expected " << position.nodes << ")";
+		std::cout << "  " << (long long)(nodes / seconds) << " nps\n";
+	}
+	std::cout << "Total: " << totalNodes << " nodes in " << totalSeconds << "s, " << (long long)(totalNodes / totalSeconds) << " nps\n";
+	return allPassed ? 0 : 1;
+}
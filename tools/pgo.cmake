@@ -0,0 +1,110 @@
+# Profile guided build of the tools, run from the source directory with
+#   cmake -P tools/pgo.cmake
+# or make pgo. An instrumented build runs perft and the search bench, the profile is fed back into an
+# optimized build and the NPS of a plain build and the optimized one are compared in build-pgo/report.txt.
+# The optimized binaries are left in build/ like a normal build.
+#
+# -DPGO_BENCH_DEPTH=<n> changes the bench depth, -DPGO_CMAKE_ARGS="..." passes more options to the builds,
+# for example "-DCMAKE_CXX_COMPILER=clang++" (Clang also needs llvm-profdata on the path)
+
+if(NOT DEFINED PGO_BENCH_DEPTH)
+    set(PGO_BENCH_DEPTH 6)
+endif()
+separate_arguments(PGO_EXTRA_ARGS UNIX_COMMAND "${PGO_CMAKE_ARGS}")
+
+set(SOURCE_DIR ${CMAKE_CURRENT_LIST_DIR}/..)
+get_filename_component(SOURCE_DIR ${SOURCE_DIR} ABSOLUTE)
+set(WORK_DIR ${SOURCE_DIR}/build-pgo)
+set(PROFILE_DIR ${WORK_DIR}/profile)
+set(BIN_DIR ${SOURCE_DIR}/build)
+
+function(run_checked)
+    execute_process(COMMAND ${ARGN} RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "Failed: ${ARGN}")
+    endif()
+endfunction()
+
+function(run_quiet)
+    execute_process(COMMAND ${ARGN} RESULT_VARIABLE result OUTPUT_QUIET)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "Failed: ${ARGN}")
+    endif()
+endfunction()
+
+function(build_tools build_dir pgo_mode)
+    run_checked(${CMAKE_COMMAND} -S ${SOURCE_DIR} -B ${build_dir} -DCMAKE_BUILD_TYPE=Release -DCHESS_BUILD_GUI=OFF
+        -DCHESS_PGO=${pgo_mode} -DCHESS_PGO_DIR=${PROFILE_DIR} ${PGO_EXTRA_ARGS})
+    run_checked(${CMAKE_COMMAND} --build ${build_dir} --clean-first --parallel)
+endfunction()
+
+# Sets <prefix>_BENCH_NPS, <prefix>_PERFT_NPS and <prefix>_SIGNATURE from the tools in build/
+function(measure prefix)
+    execute_process(COMMAND ${BIN_DIR}/chess-uci bench ${PGO_BENCH_DEPTH} OUTPUT_VARIABLE bench RESULT_VARIABLE result)
+    execute_process(COMMAND ${BIN_DIR}/chess-perft OUTPUT_VARIABLE perft)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "chess-uci bench failed")
+    endif()
+    string(REGEX MATCH "Nodes/second +: ([0-9]+)" unused "${bench}")
+    set(${prefix}_BENCH_NPS ${CMAKE_MATCH_1} PARENT_SCOPE)
+    string(REGEX MATCH "Nodes searched +: ([0-9]+)" unused "${bench}")
+    set(${prefix}_SIGNATURE ${CMAKE_MATCH_1} PARENT_SCOPE)
+    string(REGEX MATCH "Total: [0-9]+ nodes in [0-9.e+-]+s, ([0-9]+) nps" unused "${perft}")
+    set(${prefix}_PERFT_NPS ${CMAKE_MATCH_1} PARENT_SCOPE)
+endfunction()
+
+function(percent_change before after result)
+    if(before GREATER 0)
+        math(EXPR change "(${after} - ${before}) * 1000 / ${before}")
+        math(EXPR whole "${change} / 10")
+        math(EXPR tenth "${change} % 10")
+        if(tenth LESS 0)
+            math(EXPR tenth "-${tenth}")
+            if(whole EQUAL 0)
+                set(whole "-0")
+            endif()
+        endif()
+        set(${result} "${whole}.${tenth}%" PARENT_SCOPE)
+    else()
+        set(${result} "n/a" PARENT_SCOPE)
+    endif()
+endfunction()
+
+file(REMOVE_RECURSE ${PROFILE_DIR})
+
+message(STATUS "Plain build")
+build_tools(${WORK_DIR}/plain OFF)
+measure(PLAIN)
+
+message(STATUS "Instrumented build")
+build_tools(${WORK_DIR}/optimized GENERATE)
+message(STATUS "Training run: perft and bench depth ${PGO_BENCH_DEPTH}")
+run_quiet(${BIN_DIR}/chess-perft)
+run_quiet(${BIN_DIR}/chess-uci bench ${PGO_BENCH_DEPTH})
+
+# Clang writes raw profiles that have to be merged, GCC reads its .gcda files directly
+file(GLOB_RECURSE RAW_PROFILES ${PROFILE_DIR}/*.profraw)
+if(RAW_PROFILES)
+    find_program(LLVM_PROFDATA NAMES llvm-profdata llvm-profdata-19 llvm-profdata-18 llvm-profdata-17 llvm-profdata-16 llvm-profdata-15 llvm-profdata-14)
+    if(NOT LLVM_PROFDATA)
+        message(FATAL_ERROR "llvm-profdata is needed to merge the Clang profiles")
+    endif()
+    run_checked(${LLVM_PROFDATA} merge -output=${PROFILE_DIR}/default.profdata ${RAW_PROFILES})
+endif()
+
+# Same build directory as the instrumented build, GCC finds the profile of an object by its path
+message(STATUS "Optimized build")
+build_tools(${WORK_DIR}/optimized USE)
+measure(PGO)
+
+if(NOT PLAIN_SIGNATURE STREQUAL PGO_SIGNATURE)
+    message(WARNING "Bench signatures differ: ${PLAIN_SIGNATURE} plain, ${PGO_SIGNATURE} optimized")
+endif()
+
+percent_change("${PLAIN_BENCH_NPS}" "${PGO_BENCH_NPS}" BENCH_CHANGE)
+percent_change("${PLAIN_PERFT_NPS}" "${PGO_PERFT_NPS}" PERFT_CHANGE)
+set(REPORT "PGO report, bench depth ${PGO_BENCH_DEPTH}, signature ${PGO_SIGNATURE}\n")
+string(APPEND REPORT "bench nps: plain ${PLAIN_BENCH_NPS}, pgo ${PGO_BENCH_NPS}, change ${BENCH_CHANGE}\n")
+string(APPEND REPORT "perft nps: plain ${PLAIN_PERFT_NPS}, pgo ${PGO_PERFT_NPS}, change ${PERFT_CHANGE}\n")
+file(WRITE ${WORK_DIR}/report.txt "${REPORT}")
+message("${REPORT}")
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "index_model/board.h"
+#include "index_model/self_play.h"
+#include "index_model/training_data.h"
+
+static void printProgress(const SelfPlayProgress& progress) {
+	std::printf("%lld games, %lld plies, %lld positions, %.0f positions/s, +%lld =%lld -%lld\n", progress.games, progress.plies,
+		progress.positions, progress.positions / std::max(progress.seconds, 0.001), progress.results[TRAINING_RESULT_WHITE_WINS],
+		progress.results[TRAINING_RESULT_DRAW], progress.results[TRAINING_RESULT_BLACK_WINS]);
+	std::fflush(stdout);
+}
+
+static int generate(const std::string& path, const SelfPlayOptions& options, bool append) {
+	TrainingDataWriter writer;
+	if (!writer.open(path, append)) {
+		std::cout << "Failed to open " << path << "\n";
+		return 1;
+	}
+	SelfPlayGenerator generator(options, writer);
+	generator.run(printProgress);
+	bool written = writer.close();
+	printProgress(generator.getProgress());
+	if (!written) std::cout << "Failed to write " << path << "\n";
+	return written ? 0 : 1;
+}
+
+// Reads the whole file the way a trainer would and checks every position can be set up on a board
+static int stats(const std::string& path) {
+	TrainingDataReader reader;
+	if (!reader.open(path)) {
+		std::cout << "Failed to read " << path << "\n";
+		return 1;
+	}
+	PackedPosition position;
+	long long nPositions = 0, nResults[3] = { 0, 0, 0 }, invalid = 0;
+	double absoluteScores = 0.0;
+	auto start = std::chrono::steady_clock::now();
+	while (reader.next(position)) {
+		nPositions++;
+		absoluteScores += std::abs(position.score);
+		if (position.result <= TRAINING_RESULT_WHITE_WINS) nResults[position.result]++;
+		else invalid++;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	ChessBoardIndex board;
+	reader.rewind();
+	while (reader.next(position)) {
+		board.changeBoardState(getPackedFEN(position));
+		if (board.pieceList.nSpecPieces[WHITE][KING - 1] != 1 || board.pieceList.nSpecPieces[BLACK][KING - 1] != 1)
+			invalid++;
+	}
+
+	std::printf("Positions     : %lld (%.1f MB)\n", nPositions, nPositions * sizeof(PackedPosition) / (1024.0 * 1024.0));
+	std::printf("Results       : +%lld =%lld -%lld\n", nResults[TRAINING_RESULT_WHITE_WINS], nResults[TRAINING_RESULT_DRAW],
+		nResults[TRAINING_RESULT_BLACK_WINS]);
+	std::printf("Mean |score|  : %.1f\n", nPositions > 0 ? absoluteScores / nPositions : 0.0);
+	std::printf("Read speed    : %.0f positions/s\n", nPositions / std::max(seconds, 1e-9));
+	std::printf("Invalid       : %lld\n", invalid);
+	return invalid == 0 ? 0 : 1;
+}
+
+static int show(const std::string& path, long long first, long long count) {
+	TrainingDataReader reader;
+	if (!reader.open(path)) {
+		std::cout << "Failed to read " << path << "\n";
+		return 1;
+	}
+	PackedPosition position;
+	const char* resultTexts[3] = { "0-1", "1/2-1/2", "1-0" };
+	for (long long i = 0; reader.next(position) && (count == 0 || i < first + count); i++)
+		if (i >= first)
+			std::printf("%s | %d | %s | depth %d\n", getPackedFEN(position).c_str(), position.score,
+				resultTexts[std::min((int)position.result, 2)], position.depth);
+	return 0;
+}
+
+// Usage: chess-selfplay generate <out.bin> [options]  plays games and writes their quiet positions
+//        chess-selfplay stats <file.bin>              reads a training file and checks its positions
+//        chess-selfplay show <file.bin> [first] [count]  prints positions as FEN | score | result
+// Options of generate: --games N, --threads N, --nodes N per move, --hash MB per thread, --random-plies N,
+// --margin cp for the quiet position filter, --seed N, --append to add to an existing file, --eval <path>
+// to play with the weights of a parameter file. The file format is described in index_model/training_data.h
+int main(int argc, char** argv) {
+
+	std::string command = argc > 1 ? argv[1] : "";
+	if (command == "generate" && argc >= 3) {
+		SelfPlayOptions options;
+		bool append = false;
+		for (int i = 3; i < argc; i++) {
+			bool hasValue = i + 1 < argc;
+			if (!std::strcmp(argv[i], "--games") && hasValue) options.games = std::max(1, std::atoi(argv[++i]));
+			else if (!std::strcmp(argv[i], "--threads") && hasValue) options.threads = std::atoi(argv[++i]);
+			else if (!std::strcmp(argv[i], "--nodes") && hasValue) options.nodes = std::max(1LL, std::atoll(argv[++i]));
+			else if (!std::strcmp(argv[i], "--hash") && hasValue) options.hashMB = std::max(1, std::atoi(argv[++i]));
+			else if (!std::strcmp(argv[i], "--random-plies") && hasValue) options.randomPlies = std::max(0, std::atoi(argv[++i]));
+			else if (!std::strcmp(argv[i], "--margin") && hasValue) options.quietMargin = std::max(0, std::atoi(argv[++i]));
+			else if (!std::strcmp(argv[i], "--seed") && hasValue) options.seed = std::strtoull(argv[++i], nullptr, 10);
+			else if (!std::strcmp(argv[i], "--eval") && hasValue) {
+				if (!getEvalParameters().load(argv[++i])) {
+					std::cout << "Failed to read " << argv[i] << "\n";
+					return 1;
+				}
+			}
+			else if (!std::strcmp(argv[i], "--append")) append = true;
+		}
+		return generate(argv[2], options, append);
+	}
+	if (command == "stats" && argc >= 3)
+		return stats(argv[2]);
+	if (command == "show" && argc >= 3)
+		return show(argv[2], argc > 3 ? std::atoll(argv[3]) : 0, argc > 4 ? std::atoll(argv[4]) : 10);
+	std::cout << "Usage: chess-selfplay generate <out.bin> [--games N] [--threads N] [--nodes N] [--hash MB] [--random-plies N]\n"
+		"                      [--margin cp] [--seed N] [--append] [--eval <path>]\n"
+		"       chess-selfplay stats <file.bin>\n"
+		"       chess-selfplay show <file.bin> [first] [count]\n";
+	return 1;
+}
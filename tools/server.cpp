@@ -0,0 +1,40 @@
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "server/game_server.h"
+#include "util/logger.h"
+
+GameServer* server = nullptr;
+
+void stopServer(int) {
+	if (server) server->running = false;
+}
+
+// Usage: chess-server [--port N] [--unix <path>] [--threads N] [--hash MB] [--log <path>]
+// --port 0 or --unix "" turn a listener off. The protocol is described in server/protocol.h
+int main(int argc, char** argv) {
+
+	ServerOptions options;
+	for (int i = 1; i + 1 < argc; i++) {
+		if (!std::strcmp(argv[i], "--port")) options.port = std::atoi(argv[++i]);
+		else if (!std::strcmp(argv[i], "--unix")) options.unixPath = argv[++i];
+		else if (!std::strcmp(argv[i], "--threads")) options.engineThreads = std::atoi(argv[++i]);
+		else if (!std::strcmp(argv[i], "--hash")) options.hashMB = std::max(1, std::atoi(argv[++i]));
+		else if (!std::strcmp(argv[i], "--log")) Logger::get().setOutputFile(argv[++i]);
+	}
+
+	GameServer gameServer(options);
+	if (!gameServer.start())
+		return 1;
+	server = &gameServer;
+	std::signal(SIGINT, stopServer);
+	std::signal(SIGTERM, stopServer);
+	std::signal(SIGPIPE, SIG_IGN);
+
+	gameServer.run();
+	LOG_INFO("Stopped after %lld moves, %d games still open", gameServer.movesPlayed, gameServer.getGameCount());
+	LOG_INFO("Broadcast %lld frames to spectators, %lld dropped as too slow", gameServer.broadcastFrames, gameServer.spectatorsDropped);
+	return 0;
+}
@@ -0,0 +1,386 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <unordered_map>
+#include <string>
+#include <vector>
+
+#include <sys/epoll.h>
+
+#include "index_model/board.h"
+#include "index_model/game_tree.h"
+#include "index_model/move.h"
+#include "index_model/notation.h"
+#include "server/broadcast.h"
+#include "server/protocol.h"
+#include "server/socket.h"
+
+const int DEFAULT_LOAD_GAMES = 10000;
+const int DEFAULT_LOAD_CONNECTIONS = 100;
+const double DEFAULT_LOAD_SECONDS = 10.0;
+const int MAX_LOAD_GAME_PLIES = 200; // Random games are left after this many moves so the mix stays varied
+const uint32_t SPECTATOR_EVENT = 0x80000000; // Marks spectator indices in epoll data
+
+using Clock = std::chrono::steady_clock;
+
+// One concurrent game. The generator chooses random legal moves for its side, the position is kept as
+// a snapshot like the server does
+struct LoadGame {
+	int connection;
+	uint32_t id = 0;
+	PositionSnapshot position;
+	int plies = 0;
+	Clock::time_point sentAt;
+	std::string pendingMove;
+};
+
+struct LoadConnection : LineConnection {
+	std::vector<int> waitingForId; // Games whose new was sent, answered in order
+};
+
+// Connection that sent "watch all" and counts the frames of the broadcast
+struct LoadSpectator {
+	int fd = -1;
+	std::string input;
+	long long frames = 0;
+	long long bytes = 0;
+};
+
+// Follows every game from the broadcast of one spectator and checks that the moves are legal and that the
+// keyframes agree with the replayed positions
+class BroadcastChecker {
+
+	struct WatchedGame {
+		PositionSnapshot position;
+		uint32_t ply = 0;
+	};
+	std::unordered_map<uint32_t, WatchedGame> games;
+	ChessBoardIndex board;
+
+public:
+	long long errors = 0;
+
+	void check(const BroadcastFrame& frame) {
+		auto found = games.find(frame.game);
+		if (frame.type == BROADCAST_KEYFRAME) {
+			if (found != games.end() && (found->second.ply != frame.ply ||
+				std::memcmp(found->second.position.pieces, frame.position.pieces, 64) || found->second.position.hashKey != frame.position.hashKey))
+				errors++;
+			games[frame.game] = { frame.position, frame.ply };
+		}
+		else if (frame.type == BROADCAST_MOVE) {
+			if (found == games.end()) {
+				errors++;
+				return;
+			}
+			board.restoreSnapshot(found->second.position);
+			Move move = frame.move;
+			if (board.getMove(move.getFrom(), move.getTo(), move.getFlags() & 0x3) != move) {
+				errors++;
+				games.erase(found);
+				return;
+			}
+			board.makeMove(move, false, false, false);
+			found->second.position = board.getSnapshot();
+			found->second.ply++;
+		}
+		else if (frame.type == BROADCAST_END)
+			games.erase(frame.game);
+	}
+};
+
+class LoadGenerator {
+
+	std::vector<LoadConnection> connections;
+	std::vector<LoadSpectator> spectators;
+	BroadcastChecker checker;
+	std::vector<LoadGame> games;
+	std::vector<int> gameByServerId; // Index into games, by server game id
+	ChessBoardIndex board;
+	PositionSnapshot startPosition;
+	std::string mode;
+	int depth;
+	std::mt19937 random{ 12345 };
+	int epollFd = -1;
+	Clock::duration moveInterval;
+	std::deque<std::pair<Clock::time_point, int>> scheduledMoves; // Due in order, the interval is fixed
+
+	void scheduleMove(int gameIndex) {
+		if (moveInterval == Clock::duration::zero()) sendRandomMove(gameIndex);
+		else scheduledMoves.push_back({ Clock::now() + moveInterval, gameIndex });
+	}
+
+	void sendScheduledMoves() {
+		Clock::time_point now = Clock::now();
+		while (!scheduledMoves.empty() && scheduledMoves.front().first <= now) {
+			sendRandomMove(scheduledMoves.front().second);
+			scheduledMoves.pop_front();
+		}
+	}
+
+	bool receiveBroadcast(LoadSpectator& spectator, bool checked) {
+		size_t size = spectator.input.size();
+		bool open = true;
+		while (true) {
+			spectator.input.resize(size + READ_CHUNK_SIZE);
+			ssize_t received = recv(spectator.fd, &spectator.input[size], READ_CHUNK_SIZE, 0);
+			if (received > 0) {
+				size += received;
+				spectator.bytes += received;
+				continue;
+			}
+			open = received == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+			break;
+		}
+		spectator.input.resize(size);
+		BroadcastReader reader(spectator.input.data(), spectator.input.size());
+		BroadcastFrame frame;
+		while (reader.next(frame)) {
+			spectator.frames++;
+			if (checked) checker.check(frame);
+		}
+		if (reader.malformed) errors++;
+		spectator.input.erase(0, reader.getOffset());
+		return open;
+	}
+
+	void sendNew(int gameIndex) {
+		LoadGame& game = games[gameIndex];
+		LoadConnection& connection = connections[game.connection];
+		game.position = startPosition;
+		game.plies = 0;
+		connection.waitingForId.push_back(gameIndex);
+		connection.send("new " + mode + " " + std::to_string(depth));
+		gamesStarted++;
+	}
+
+	void sendRandomMove(int gameIndex) {
+		LoadGame& game = games[gameIndex];
+		if (game.plies >= MAX_LOAD_GAME_PLIES) {
+			connections[game.connection].send("leave " + std::to_string(game.id));
+			return;
+		}
+		board.restoreSnapshot(game.position);
+		ChessMoves& moves = board.getAvailableMoves();
+		Move move = moves[random() % moves.nMoves];
+		game.pendingMove = getMoveUCI(move);
+		game.sentAt = Clock::now();
+		connections[game.connection].send("move " + std::to_string(game.id) + " " + game.pendingMove);
+	}
+
+	// Returns whether the move ended the game, the server follows up with end then
+	bool applyMove(LoadGame& game, const std::string& uci) {
+		board.restoreSnapshot(game.position);
+		board.makeMove(parseMoveUCI(board, uci), false, false, false);
+		game.position = board.getSnapshot();
+		game.plies++;
+		return board.checkGameEnded() != 0;
+	}
+
+	LoadGame* findGame(const char* idText) {
+		uint32_t id = (uint32_t)std::strtoul(idText, nullptr, 10);
+		if (id >= gameByServerId.size() || gameByServerId[id] == -1) return nullptr;
+		return &games[gameByServerId[id]];
+	}
+
+	void handleLine(LoadConnection& connection, const std::string& line) {
+		char command[16] = {}, idText[16] = {}, argument[16] = {};
+		std::sscanf(line.c_str(), "%15s %15s %15s", command, idText, argument);
+
+		if (!std::strcmp(command, "error") || !std::strcmp(command, "illegal")) {
+			std::fprintf(stderr, "Unexpected reply: %s\n", line.c_str());
+			errors++;
+			return;
+		}
+		if (!std::strcmp(command, "game")) {
+			int gameIndex = connection.waitingForId.front();
+			connection.waitingForId.erase(connection.waitingForId.begin());
+			LoadGame& game = games[gameIndex];
+			game.id = (uint32_t)std::strtoul(idText, nullptr, 10);
+			if (game.id >= gameByServerId.size()) gameByServerId.resize(game.id * 2 + 1, -1);
+			gameByServerId[game.id] = gameIndex;
+			if (!std::strcmp(argument, "white") || !std::strcmp(argument, "both")) scheduleMove(gameIndex);
+			return;
+		}
+		LoadGame* game = findGame(idText);
+		if (!game) return;
+		int gameIndex = (int)(game - games.data());
+
+		if (!std::strcmp(command, "ok")) {
+			latencies.push_back(std::chrono::duration<float, std::micro>(Clock::now() - game->sentAt).count());
+			bool ended = applyMove(*game, argument);
+			movesConfirmed++;
+			if (mode == "both" && !ended) scheduleMove(gameIndex);
+		}
+		else if (!std::strcmp(command, "move")) { // Engine reply
+			if (!applyMove(*game, argument)) scheduleMove(gameIndex);
+		}
+		else if (!std::strcmp(command, "end")) {
+			gameByServerId[game->id] = -1;
+			gamesEnded++;
+			sendNew(gameIndex);
+		}
+	}
+
+public:
+	std::vector<float> latencies; // Microseconds from sending a move to its ok
+	long long movesConfirmed = 0;
+	long long gamesStarted = 0;
+	long long gamesEnded = 0;
+	long long errors = 0;
+	long long spectatorsClosed = 0;
+
+	long long getBroadcastFrames() {
+		long long frames = 0;
+		for (LoadSpectator& spectator : spectators) frames += spectator.frames;
+		return frames;
+	}
+
+	long long getBroadcastBytes() {
+		long long bytes = 0;
+		for (LoadSpectator& spectator : spectators) bytes += spectator.bytes;
+		return bytes;
+	}
+
+	long long getCheckErrors() { return checker.errors; }
+
+	LoadGenerator(const std::string& mode, int depth, double intervalMs) : mode(mode), depth(depth),
+		moveInterval(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(intervalMs))) {
+		board.changeBoardState(SERVER_START_POSITION);
+		startPosition = board.getSnapshot();
+		latencies.reserve(1 << 22);
+	}
+
+	bool connect(int nConnections, int nGames, int nSpectators, const std::string& unixPath, const std::string& host, int port) {
+		raiseFileLimit();
+		epollFd = epoll_create1(EPOLL_CLOEXEC);
+		spectators.resize(nSpectators);
+		for (int i = 0; i < nSpectators; i++) {
+			int fd = unixPath.empty() ? connectTCP(host, port) : connectUnix(unixPath);
+			if (fd == -1 || !setNonBlocking(fd)) {
+				std::fprintf(stderr, "Failed to connect spectator %d: %s\n", i, std::strerror(errno));
+				return false;
+			}
+			spectators[i].fd = fd;
+			const char watchAll[] = "watch all\n";
+			if (::send(fd, watchAll, sizeof(watchAll) - 1, MSG_NOSIGNAL) != sizeof(watchAll) - 1)
+				return false;
+			epoll_event event = {};
+			event.events = EPOLLIN;
+			event.data.u32 = SPECTATOR_EVENT | i;
+			epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+		}
+		connections.resize(nConnections);
+		for (int i = 0; i < nConnections; i++) {
+			int fd = unixPath.empty() ? connectTCP(host, port) : connectUnix(unixPath);
+			if (fd == -1 || !setNonBlocking(fd)) {
+				std::fprintf(stderr, "Failed to connect: %s\n", std::strerror(errno));
+				return false;
+			}
+			connections[i].fd = fd;
+			epoll_event event = {};
+			event.events = EPOLLIN;
+			event.data.u32 = i;
+			epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+		}
+		games.resize(nGames);
+		for (int i = 0; i < nGames; i++) {
+			games[i].connection = i % nConnections;
+			sendNew(i);
+		}
+		return true;
+	}
+
+	void run(double seconds) {
+		epoll_event events[256];
+		std::string line;
+		auto end = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+		while (Clock::now() < end) {
+			sendScheduledMoves();
+			for (LoadConnection& connection : connections)
+				if (connection.hasPendingOutput() && !connection.flush()) {
+					std::fprintf(stderr, "Connection failed\n");
+					return;
+				}
+			int timeoutMs = 100;
+			if (!scheduledMoves.empty())
+				timeoutMs = (int)std::max<long long>(0, std::chrono::duration_cast<std::chrono::milliseconds>(scheduledMoves.front().first - Clock::now()).count());
+			int nEvents = epoll_wait(epollFd, events, 256, timeoutMs);
+			for (int i = 0; i < nEvents; i++) {
+				if (events[i].data.u32 & SPECTATOR_EVENT) {
+					uint32_t index = events[i].data.u32 & ~SPECTATOR_EVENT;
+					if (spectators[index].fd != -1 && !receiveBroadcast(spectators[index], index == 0)) {
+						epoll_ctl(epollFd, EPOLL_CTL_DEL, spectators[index].fd, nullptr);
+						close(spectators[index].fd);
+						spectators[index].fd = -1;
+						spectatorsClosed++;
+					}
+					continue;
+				}
+				LoadConnection& connection = connections[events[i].data.u32];
+				if (!connection.receive()) {
+					std::fprintf(stderr, "Server closed the connection\n");
+					return;
+				}
+				while (connection.nextLine(line))
+					handleLine(connection, line);
+			}
+		}
+	}
+};
+
+// Usage: chess-server-load [--games N] [--connections N] [--seconds S] [--mode both|white] [--depth N]
+//                          [--interval ms] [--spectators N] [--unix <path> | --host <name> --port N]
+// Plays random moves in many concurrent games against a running chess-server and reports moves per
+// second and the latency of move confirmations. Mode both plays both sides and measures the server's
+// move handling, mode white plays against the engine. --interval waits between the moves of a game.
+// --spectators opens connections that watch all games and reports the broadcast frames they received,
+// the first of them checks every frame against its own replay of the games
+int main(int argc, char** argv) {
+
+	int nGames = DEFAULT_LOAD_GAMES, nConnections = DEFAULT_LOAD_CONNECTIONS, depth = 1, nSpectators = 0;
+	double seconds = DEFAULT_LOAD_SECONDS, intervalMs = 0.0;
+	std::string mode = "both", unixPath = DEFAULT_SERVER_SOCKET, host = "127.0.0.1";
+	int port = DEFAULT_SERVER_PORT;
+	for (int i = 1; i + 1 < argc; i++) {
+		if (!std::strcmp(argv[i], "--games")) nGames = std::max(1, std::atoi(argv[++i]));
+		else if (!std::strcmp(argv[i], "--connections")) nConnections = std::max(1, std::atoi(argv[++i]));
+		else if (!std::strcmp(argv[i], "--seconds")) seconds = std::atof(argv[++i]);
+		else if (!std::strcmp(argv[i], "--mode")) mode = argv[++i];
+		else if (!std::strcmp(argv[i], "--depth")) depth = std::atoi(argv[++i]);
+		else if (!std::strcmp(argv[i], "--interval")) intervalMs = std::max(0.0, std::atof(argv[++i]));
+		else if (!std::strcmp(argv[i], "--spectators")) nSpectators = std::max(0, std::atoi(argv[++i]));
+		else if (!std::strcmp(argv[i], "--unix")) unixPath = argv[++i];
+		else if (!std::strcmp(argv[i], "--host")) { host = argv[++i]; unixPath.clear(); }
+		else if (!std::strcmp(argv[i], "--port")) { port = std::atoi(argv[++i]); unixPath.clear(); }
+	}
+	nConnections = std::min(nConnections, nGames);
+
+	LoadGenerator generator(mode, depth, intervalMs);
+	if (!generator.connect(nConnections, nGames, nSpectators, unixPath, host, port))
+		return 1;
+	auto start = Clock::now();
+	generator.run(seconds);
+	double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+	std::vector<float>& latencies = generator.latencies;
+	std::sort(latencies.begin(), latencies.end());
+	auto percentile = [&](double p) { return latencies.empty() ? 0.0f : latencies[std::min(latencies.size() - 1, (size_t)(latencies.size() * p))]; };
+	std::printf("Games           : %d concurrent over %d connections (%s)\n", nGames, nConnections, unixPath.empty() ? "tcp" : "unix");
+	std::printf("Games finished  : %lld\n", generator.gamesEnded);
+	std::printf("Moves           : %lld in %.2f s\n", generator.movesConfirmed, elapsed);
+	std::printf("Moves/second    : %.0f\n", generator.movesConfirmed / elapsed);
+	std::printf("Latency (us)    : p50 %.0f  p99 %.0f  max %.0f\n", percentile(0.5), percentile(0.99), latencies.empty() ? 0.0f : latencies.back());
+	if (nSpectators > 0) {
+		long long frames = generator.getBroadcastFrames();
+		std::printf("Spectators      : %d, %lld disconnected\n", nSpectators, generator.spectatorsClosed);
+		std::printf("Frames received : %lld (%.1f bytes each)\n", frames, frames ? (double)generator.getBroadcastBytes() / frames : 0.0);
+		std::printf("Frames/second   : %.0f, %.1f MB/s\n", frames / elapsed, generator.getBroadcastBytes() / elapsed / 1e6);
+		std::printf("Checked frames  : %lld errors\n", generator.getCheckErrors());
+	}
+	return generator.errors == 0 && generator.getCheckErrors() == 0 ? 0 : 1;
+}
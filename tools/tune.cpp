@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "index_model/evaluation.h"
+#include "index_model/tuner.h"
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Usage: chess-tune <data.bin> [options]  fits the evaluation weights to the results of a training file
+//        written by chess-selfplay and writes them as a parameter file
+// Options: --out <path> (eval.txt), --eval <path> to start from a parameter file instead of the built in
+// weights, --epochs N Adam steps over all positions, --rate R the step size of Adam in centipawns,
+// --local N passes of Texel's local search after Adam, --limit N positions to load, --k K instead of
+// fitting it, --threads N
+int main(int argc, char** argv) {
+
+	std::string dataPath, outPath = "eval.txt", startPath;
+	int epochs = 300, localPasses = 0, nThreads = 0;
+	double rate = 1.0, scale = 0.0;
+	uint64_t limit = 0;
+	for (int i = 1; i < argc; i++) {
+		bool hasValue = i + 1 < argc;
+		if (!std::strcmp(argv[i], "--out") && hasValue) outPath = argv[++i];
+		else if (!std::strcmp(argv[i], "--eval") && hasValue) startPath = argv[++i];
+		else if (!std::strcmp(argv[i], "--epochs") && hasValue) epochs = std::max(0, std::atoi(argv[++i]));
+		else if (!std::strcmp(argv[i], "--rate") && hasValue) rate = std::atof(argv[++i]);
+		else if (!std::strcmp(argv[i], "--local") && hasValue) localPasses = std::max(0, std::atoi(argv[++i]));
+		else if (!std::strcmp(argv[i], "--limit") && hasValue) limit = std::strtoull(argv[++i], nullptr, 10);
+		else if (!std::strcmp(argv[i], "--k") && hasValue) scale = std::atof(argv[++i]);
+		else if (!std::strcmp(argv[i], "--threads") && hasValue) nThreads = std::atoi(argv[++i]);
+		else dataPath = argv[i];
+	}
+	if (dataPath.empty()) {
+		std::cout << "Usage: chess-tune <data.bin> [--out <path>] [--eval <path>] [--epochs N] [--rate R] [--local N] [--limit N] "
+			"[--k K] [--threads N]\n";
+		return 1;
+	}
+	if (!startPath.empty() && !getEvalParameters().load(startPath)) {
+		std::cout << "Failed to read " << startPath << "\n";
+		return 1;
+	}
+
+	TexelTuner tuner(nThreads);
+	Clock::time_point start = Clock::now();
+	if (!tuner.load(dataPath, limit) || tuner.getPositionCount() == 0) {
+		std::cout << "No positions in " << dataPath << "\n";
+		return 1;
+	}
+	std::printf("Loaded %zu positions in %.1f s, %.1f features each, %.1f MB\n", tuner.getPositionCount(), secondsSince(start),
+		(double)tuner.getFeatureCount() / tuner.getPositionCount(), tuner.getMemoryBytes() / (1024.0 * 1024.0));
+	if (tuner.mismatches > 0) {
+		std::printf("%lld positions are traced differently than evaluate scores them, traceEvaluation needs updating\n", tuner.mismatches);
+		return 1;
+	}
+
+	std::vector<float> weights = TexelTuner::getWeights(getEvalParameters());
+	if (scale > 0.0) tuner.setScale(scale);
+	else tuner.fitScale(weights);
+	double loss = tuner.getLoss(weights);
+	std::printf("K %.4f, loss %.6f\n", tuner.getScale(), loss);
+
+	TexelTuner::Adam adam;
+	adam.rate = rate;
+	start = Clock::now();
+	for (int epoch = 1; epoch <= epochs; epoch++) {
+		loss = tuner.stepAdam(adam, weights);
+		if (epoch % 25 == 0 || epoch == epochs)
+			std::printf("Epoch %4d  loss %.6f  %.0f positions/s\n", epoch, loss, epoch * tuner.getPositionCount() / secondsSince(start));
+	}
+
+	EvalParameters tuned = TexelTuner::getParameters(weights);
+	weights = TexelTuner::getWeights(tuned);
+	loss = tuner.getLoss(weights);
+	for (int pass = 1; pass <= localPasses; pass++) {
+		int changed = tuner.stepLocalSearch(weights, loss);
+		std::printf("Local search pass %d  loss %.6f  %d weights changed\n", pass, loss, changed);
+		if (changed == 0) break;
+	}
+	tuned = TexelTuner::getParameters(weights);
+	std::printf("Final loss %.6f\n", tuner.getLoss(TexelTuner::getWeights(tuned)));
+
+	if (!tuned.save(outPath)) {
+		std::cout << "Failed to write " << outPath << "\n";
+		return 1;
+	}
+	std::cout << "Wrote " << outPath << "\n";
+	return 0;
+}
@@ -0,0 +1,213 @@
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "index_model/analysis_cache.h"
+#include "index_model/bench.h"
+#include "index_model/board.h"
+#include "index_model/notation.h"
+#include "index_model/search.h"
+#include "index_model/search_stats.h"
+#include "index_model/transposition.h"
+
+const std::string START_POSITION = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+const int DEFAULT_UCI_DEPTH = 6;
+const int MAX_UCI_HASH_MB = 1024;
+const int MAX_UCI_CACHE_MB = 4096;
+
+// Minimal Universal Chess Interface front-end for the searcher. Searches run to a fixed depth, go depth N
+// sets it, go nodes N and go movetime MS stop it earlier. Clock based time controls are ignored
+class UCIEngine {
+
+	TranspositionTable transpositionTable;
+	AnalysisCache analysisCache;
+	int analysisCacheMB = DEFAULT_ANALYSIS_CACHE_MB;
+	std::unique_ptr<Searcher> searcher;
+	std::string state = START_POSITION;
+	std::vector<Move> moves;
+	std::string statisticsLogPath;
+	SearchOptions searchOptions;
+
+	void position(std::istringstream& args) {
+		std::string token;
+		args >> token;
+		if (token == "startpos") {
+			state = START_POSITION;
+			args >> token;
+		}
+		else if (token == "fen") {
+			state.clear();
+			while (args >> token && token != "moves")
+				state += (state.empty() ? "" : " ") + token;
+		}
+
+		moves.clear();
+		if (token != "moves")
+			return;
+		ChessBoardIndex board;
+		board.changeBoardState(state);
+		while (args >> token) {
+			Move move = parseMoveUCI(board, token);
+			if (move == Move()) {
+				std::cout << "info string illegal move " << token << std::endl;
+				break;
+			}
+			board.makeMove(move, false, false, false);
+			moves.push_back(move);
+		}
+	}
+
+	void go(std::istringstream& args) {
+		SearchLimits limits;
+		limits.depth = DEFAULT_UCI_DEPTH;
+		std::string token;
+		while (args >> token) {
+			if (token == "depth") args >> limits.depth;
+			else if (token == "nodes") args >> limits.nodes;
+			else if (token == "movetime") args >> limits.milliseconds;
+		}
+		if ((limits.nodes > 0 || limits.milliseconds > 0.0) && args.str().find("depth") == std::string::npos)
+			limits.depth = MAX_SEARCH_PLY - 1;
+
+		searcher->setPosition(state, moves, (int)moves.size());
+		SearchResult result = searcher->search(limits);
+		if (!statisticsLogPath.empty())
+			appendStatisticsLog(statisticsLogPath, formatStatisticsJSON(searcher->getStatistics(), state));
+		std::cout << "bestmove " << (result.bestMove == Move() ? "0000" : getMoveUCI(result.bestMove)) << std::endl;
+	}
+
+	// A whole number and nothing else, an info string tells the GUI when the value is not one
+	static bool parseOptionNumber(const std::string& name, const std::string& value, int& number) {
+		char* end = nullptr;
+		long parsed = std::strtol(value.c_str(), &end, 10);
+		if (value.empty() || *end != '\0' || parsed < INT32_MIN || parsed > INT32_MAX) {
+			std::cout << "info string Invalid value " << value << " for " << name << std::endl;
+			return false;
+		}
+		number = (int)parsed;
+		return true;
+	}
+
+	void setOption(std::istringstream& args) {
+		std::string token, name, value;
+		args >> token >> name;
+		args >> token;
+		std::getline(args >> std::ws, value);
+		int number = 0;
+		if (name == "Hash") {
+			if (parseOptionNumber(name, value, number)) transpositionTable.resize(std::max(1, std::min(number, MAX_UCI_HASH_MB)));
+		}
+		else if (name == "StatsLog") statisticsLogPath = value == "<empty>" ? "" : value;
+		else if (name == "CacheSize") {
+			if (parseOptionNumber(name, value, number)) analysisCacheMB = std::max(1, std::min(number, MAX_UCI_CACHE_MB));
+		}
+		else if (name == "CacheFile") {
+			if (value == "<empty>") analysisCache.close();
+			else analysisCache.open(value, analysisCacheMB);
+			searcher->setAnalysisCache(analysisCache.isOpen() ? &analysisCache : nullptr);
+		}
+		else if (bool* option = getSearchOption(searchOptions, name)) {
+			*option = value == "true";
+			searcher->setOptions(searchOptions);
+		}
+		else if (name == "EvalFile") {
+			if (value == "<empty>") getEvalParameters() = EvalParameters();
+			else if (!getEvalParameters().load(value)) std::cout << "info string Failed to load " << value << std::endl;
+			searcher->getEvaluator().setParameters(getEvalParameters());
+			transpositionTable.clear(); // Scores of the old weights
+			analysisCache.setEvalHash(getEvalParameters().getHash());
+		}
+	}
+
+	static void printInfo(const SearchResult& result, const SearchStatistics& statistics) {
+		std::cout << "info depth " << result.depth << " seldepth " << statistics.selDepth << " score ";
+		if (isMateScore(result.score))
+			std::cout << "mate " << (result.score > 0 ? (MATE_SCORE - result.score + 1) / 2 : -(MATE_SCORE + result.score) / 2);
+		else
+			std::cout << "cp " << result.score;
+		std::cout << " nodes " << statistics.nodes << " nps " << statistics.getNPS() << " time " << (long long)statistics.milliseconds
+			<< " pv";
+		for (Move move : result.principalVariation)
+			std::cout << " " << getMoveUCI(move);
+		std::cout << "\n";
+		std::cout << formatStatisticsUCI(statistics) << std::endl;
+	}
+
+public:
+
+	UCIEngine() : searcher(new Searcher(transpositionTable)) {
+		searcher->setIterationCallback(printInfo);
+	}
+
+	void run() {
+		std::string line;
+		while (std::getline(std::cin, line)) {
+			std::istringstream args(line);
+			std::string command;
+			args >> command;
+
+			if (command == "uci") {
+				std::cout << "id name Chess-3D\n";
+				std::cout << "id author Chess-3D\n";
+				std::cout << "option name Hash type spin default 16 min 1 max " << MAX_UCI_HASH_MB << "\n";
+				std::cout << "option name StatsLog type string default <empty>\n";
+				std::cout << "option name CacheSize type spin default " << DEFAULT_ANALYSIS_CACHE_MB << " min 1 max " << MAX_UCI_CACHE_MB << "\n";
+				std::cout << "option name CacheFile type string default <empty>\n";
+				std::cout << "option name EvalFile type string default <empty>\n";
+				for (const char* option : SEARCH_OPTION_NAMES)
+					std::cout << "option name " << option << " type check default true\n";
+				std::cout << "uciok" << std::endl;
+			}
+			else if (command == "isready") std::cout << "readyok" << std::endl;
+			else if (command == "ucinewgame") transpositionTable.clear();
+			else if (command == "setoption") setOption(args);
+			else if (command == "position") position(args);
+			else if (command == "go") go(args);
+			else if (command == "bench") {
+				int depth = BENCH_DEPTH;
+				args >> depth;
+				runBench(depth, &std::cout, searchOptions);
+			}
+			else if (command == "quit") break;
+		}
+	}
+};
+
+// Usage: chess-uci, then UCI commands on standard input. setoption name StatsLog value <path> appends
+// the counters of every search to a file as JSON lines. setoption name CacheFile value <path> keeps deep
+// results in a persistent analysis cache of CacheSize MB, set CacheSize first. setoption name EvalFile
+// value <path> loads evaluation weights written by chess-tune. The check options PVS, AspirationWindows, NullMove,
+// LateMoveReductions, ReverseFutility, Futility, Razoring and LateMovePruning switch off search techniques, for
+// bench too.
+// chess-uci bench [depth] [--off <option>]... runs the bench and exits, chess-uci bench [depth] --report compares
+// the node counts of the options with plain alpha-beta
+int main(int argc, char** argv) {
+	if (argc > 1 && std::string(argv[1]) == "bench") {
+		int depth = BENCH_DEPTH;
+		SearchOptions options;
+		for (int i = 2; i < argc; i++) {
+			if (std::string(argv[i]) == "--report") {
+				runBenchReport(depth, std::cout);
+				return 0;
+			}
+			if (std::string(argv[i]) == "--off" && i + 1 < argc) {
+				bool* option = getSearchOption(options, argv[++i]);
+				if (!option) {
+					std::cout << "Unknown option " << argv[i] << "\n";
+					return 1;
+				}
+				*option = false;
+			}
+			else depth = std::atoi(argv[i]);
+		}
+		runBench(depth, &std::cout, options);
+		return 0;
+	}
+	UCIEngine engine;
+	engine.run();
+	return 0;
+}